@@ -21,6 +21,12 @@ MODULE_DESCRIPTION("SHA-224/SHA-256 secure hash using ARMv8 Crypto Extensions");
 MODULE_AUTHOR("Ard Biesheuvel <ard.biesheuvel@linaro.org>");
 MODULE_LICENSE("GPL v2");
 
+/*
+ * Messages hashed per crypto_shash_finup_mb() call. They share a single
+ * kernel mode NEON section and a single copy of the starting state.
+ */
+#define SHA256_CE_MAX_MSGS	8
+
 struct sha256_ce_state {
 	struct sha256_state	sst;
 	u32			finalize;
@@ -70,6 +76,33 @@ static int sha256_ce_finup(struct shash_desc *desc, const u8 *data,
 	return sha256_base_finish(desc, out);
 }
 
+static int sha256_ce_finup_mb(struct shash_desc *desc,
+			      const u8 * const data[], unsigned int len,
+			      u8 * const outs[], unsigned int num_msgs)
+{
+	struct sha256_ce_state *sctx = shash_desc_ctx(desc);
+	struct sha256_ce_state orig = *sctx;
+	bool finalize = !orig.sst.count && !(len % SHA256_BLOCK_SIZE) && len;
+	unsigned int i;
+
+	kernel_neon_begin_partial(28);
+	for (i = 0; i < num_msgs; i++) {
+		*sctx = orig;
+		sctx->finalize = finalize;
+
+		sha256_base_do_update(desc, data[i], len,
+				      (sha256_block_fn *)sha2_ce_transform);
+		if (!finalize)
+			sha256_base_do_finalize(desc,
+					(sha256_block_fn *)sha2_ce_transform);
+		sha256_base_finish(desc, outs[i]);
+	}
+	kernel_neon_end();
+
+	memzero_explicit(&orig, sizeof(orig));
+	return 0;
+}
+
 static int sha256_ce_final(struct shash_desc *desc, u8 *out)
 {
 	struct sha256_ce_state *sctx = shash_desc_ctx(desc);
@@ -101,7 +134,9 @@ static struct shash_alg algs[] = { {
 	.update			= sha256_ce_update,
 	.final			= sha256_ce_final,
 	.finup			= sha256_ce_finup,
+	.finup_mb		= sha256_ce_finup_mb,
 	.descsize		= sizeof(struct sha256_ce_state),
+	.mb_max_msgs		= SHA256_CE_MAX_MSGS,
 	.digestsize		= SHA256_DIGEST_SIZE,
 	.base			= {
 		.cra_name		= "sha256",
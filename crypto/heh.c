@@ -35,6 +35,13 @@
  */
 #define HEH_BLOCK_SIZE		16
 
+/*
+ * Requests up to this length (which covers all encrypted filenames) are
+ * processed in a single pass over a stack copy of the message, using the bare
+ * block cipher rather than the ECB skcipher.
+ */
+#define HEH_FAST_MAX_LEN	256
+
 struct heh_instance_ctx {
 	struct crypto_shash_spawn cmac;
 	struct crypto_shash_spawn poly_hash;
@@ -45,6 +52,7 @@ struct heh_tfm_ctx {
 	struct crypto_shash *cmac;
 	struct crypto_shash *poly_hash; /* keyed with tau_key */
 	struct crypto_ablkcipher *ecb;
+	struct crypto_cipher *cipher; /* for the fast path; may be NULL */
 };
 
 struct heh_cmac_data {
@@ -619,8 +627,121 @@ static int heh_ecb(struct ablkcipher_request *req, bool decrypt)
 	return heh_ecb_step_2(req, req->base.flags);
 }
 
+/*
+ * poly_hash() of a message held in a linear buffer.  The partial block, if any,
+ * must already be zero-padded to a full block.
+ */
+static int heh_poly_hash_buf(struct ablkcipher_request *req, const be128 *buf,
+			     be128 *hash)
+{
+	struct heh_req_ctx *rctx = heh_req_ctx(req);
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct heh_tfm_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+	struct shash_desc *desc = &rctx->u.poly_hash.desc;
+	unsigned int tail_offset = get_tail_offset(req->nbytes);
+	const be128 *tail = &buf[tail_offset / HEH_BLOCK_SIZE];
+	int err;
+
+	desc->tfm = ctx->poly_hash;
+	desc->flags = req->base.flags;
+
+	if (req->nbytes % HEH_BLOCK_SIZE) {
+		err = crypto_shash_init(desc) ?:
+		      crypto_shash_update(desc, (const u8 *)buf, tail_offset) ?:
+		      crypto_shash_finup(desc, (const u8 *)&tail[1],
+					 HEH_BLOCK_SIZE, (u8 *)hash);
+	} else {
+		err = crypto_shash_digest(desc, (const u8 *)buf, tail_offset,
+					  (u8 *)hash);
+	}
+	if (err)
+		return err;
+	be128_xor(hash, hash, tail);
+	return 0;
+}
+
+/* Linear-buffer version of heh_tfm_blocks() */
+static void heh_tfm_blocks_buf(be128 *buf, unsigned int len,
+			       const be128 *hash, const be128 *beta_key)
+{
+	be128 e = *beta_key;
+
+	for (; len; len -= HEH_BLOCK_SIZE, buf++) {
+		gf128mul_x_ble(&e, &e);
+		be128_xor(buf, buf, hash);
+		be128_xor(buf, buf, &e);
+	}
+}
+
+/*
+ * Synchronous single-pass HEH for short messages.  The message is copied out of
+ * the scatterlist once, all three layers run on the linear copy, and the result
+ * is copied to the destination once.  This computes exactly the same thing as
+ * heh_hash(), heh_ecb() and heh_hash_inv(), without their repeated scatterlist
+ * walks and without the per-request overhead of the ECB skcipher.
+ */
+static int heh_crypt_fast(struct ablkcipher_request *req, bool decrypt)
+{
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct heh_tfm_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+	struct heh_req_ctx *rctx = heh_req_ctx(req);
+	unsigned int tail_offset = get_tail_offset(req->nbytes);
+	unsigned int partial_len = req->nbytes % HEH_BLOCK_SIZE;
+	be128 buf[HEH_FAST_MAX_LEN / HEH_BLOCK_SIZE + 1];
+	be128 *tail = &buf[tail_offset / HEH_BLOCK_SIZE];
+	u8 keystream[HEH_BLOCK_SIZE] __aligned(__alignof__(be128));
+	be128 hash, tmp;
+	unsigned int i;
+	int err;
+
+	scatterwalk_map_and_copy(buf, req->src, 0, req->nbytes, 0);
+	memset((u8 *)buf + req->nbytes, 0, sizeof(buf) - req->nbytes);
+
+	/* Hash phase */
+	err = heh_poly_hash_buf(req, buf, &hash);
+	if (err)
+		goto out;
+	heh_tfm_blocks_buf(buf, tail_offset, &hash, &rctx->beta1_key);
+	be128_xor(tail, &hash, &rctx->beta1_key);
+
+	/* Encrypt phase; see heh_ecb() for the partial block handling */
+	memcpy(keystream, tail, HEH_BLOCK_SIZE);
+	for (i = 0; i <= tail_offset / HEH_BLOCK_SIZE; i++) {
+		if (decrypt)
+			crypto_cipher_decrypt_one(ctx->cipher, (u8 *)&buf[i],
+						  (u8 *)&buf[i]);
+		else
+			crypto_cipher_encrypt_one(ctx->cipher, (u8 *)&buf[i],
+						  (u8 *)&buf[i]);
+	}
+	if (partial_len) {
+		crypto_xor(keystream, (u8 *)tail, HEH_BLOCK_SIZE);
+		crypto_cipher_encrypt_one(ctx->cipher, keystream, keystream);
+		crypto_xor((u8 *)&tail[1], keystream, partial_len);
+	}
+
+	/* Inverse hash phase; see heh_hash_inv() */
+	be128_xor(&hash, tail, &rctx->beta2_key);
+	heh_tfm_blocks_buf(buf, tail_offset, &hash, &rctx->beta2_key);
+	memset(tail, 0, HEH_BLOCK_SIZE);
+	err = heh_poly_hash_buf(req, buf, &tmp);
+	if (err)
+		goto out;
+	be128_xor(tail, &tmp, &hash);
+
+	scatterwalk_map_and_copy(buf, req->dst, 0, req->nbytes, 1);
+out:
+	memzero_explicit(buf, sizeof(buf));
+	memzero_explicit(keystream, sizeof(keystream));
+	memzero_explicit(&hash, sizeof(hash));
+	memzero_explicit(&tmp, sizeof(tmp));
+	return err;
+}
+
 static int heh_crypt(struct ablkcipher_request *req, bool decrypt)
 {
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct heh_tfm_ctx *ctx = crypto_ablkcipher_ctx(tfm);
 	struct heh_req_ctx *rctx = heh_req_ctx(req);
 	int err;
 
@@ -635,6 +756,9 @@ static int heh_crypt(struct ablkcipher_request *req, bool decrypt)
 	if (decrypt)
 		swap(rctx->beta1_key, rctx->beta2_key);
 
+	if (ctx->cipher && req->nbytes <= HEH_FAST_MAX_LEN)
+		return heh_crypt_fast(req, decrypt);
+
 	err = heh_hash(req, &rctx->beta1_key);
 	if (err)
 		return err;
@@ -707,11 +831,51 @@ static int heh_setkey(struct crypto_ablkcipher *parent, const u8 *key,
 				       keylen);
 	crypto_ablkcipher_set_flags(parent, crypto_ablkcipher_get_flags(ecb) &
 					    CRYPTO_TFM_RES_MASK);
+	if (err || !ctx->cipher)
+		goto out;
+
+	crypto_cipher_clear_flags(ctx->cipher, CRYPTO_TFM_REQ_MASK);
+	crypto_cipher_set_flags(ctx->cipher,
+				crypto_ablkcipher_get_flags(parent) &
+				CRYPTO_TFM_REQ_MASK);
+	err = crypto_cipher_setkey(ctx->cipher, derived_keys + HEH_BLOCK_SIZE,
+				   keylen);
+	crypto_ablkcipher_set_flags(parent,
+				    crypto_cipher_get_flags(ctx->cipher) &
+				    CRYPTO_TFM_RES_MASK);
 out:
 	kzfree(derived_keys);
 	return err;
 }
 
+/*
+ * Allocate the bare block cipher underlying "ecb(<cipher>)", for use by the
+ * fast path.  The fast path is simply disabled if this isn't possible.
+ */
+static struct crypto_cipher *heh_alloc_cipher(struct crypto_ablkcipher *ecb)
+{
+	const char *ecb_name = crypto_tfm_alg_name(crypto_ablkcipher_tfm(ecb));
+	char cipher_name[CRYPTO_MAX_ALG_NAME];
+	struct crypto_cipher *cipher;
+	size_t len = strlen(ecb_name);
+
+	if (len <= 5 || strncmp(ecb_name, "ecb(", 4) ||
+	    ecb_name[len - 1] != ')')
+		return NULL;
+	memcpy(cipher_name, ecb_name + 4, len - 5);
+	cipher_name[len - 5] = '\0';
+
+	cipher = crypto_alloc_cipher(cipher_name, 0, 0);
+	if (IS_ERR(cipher))
+		return NULL;
+
+	if (crypto_cipher_blocksize(cipher) != HEH_BLOCK_SIZE) {
+		crypto_free_cipher(cipher);
+		return NULL;
+	}
+	return cipher;
+}
+
 static int heh_init_tfm(struct crypto_tfm *tfm)
 {
 	struct crypto_instance *inst = crypto_tfm_alg_instance(tfm);
@@ -740,6 +904,7 @@ static int heh_init_tfm(struct crypto_tfm *tfm)
 	ctx->cmac = cmac;
 	ctx->poly_hash = poly_hash;
 	ctx->ecb = ecb;
+	ctx->cipher = heh_alloc_cipher(ecb);
 
 	reqsize = crypto_tfm_alg_alignmask(tfm) &
 		  ~(crypto_tfm_ctx_alignment() - 1);
@@ -770,6 +935,8 @@ static void heh_exit_tfm(struct crypto_tfm *tfm)
 	crypto_free_shash(ctx->cmac);
 	crypto_free_shash(ctx->poly_hash);
 	crypto_free_ablkcipher(ctx->ecb);
+	if (ctx->cipher)
+		crypto_free_cipher(ctx->cipher);
 }
 
 static void heh_free_instance(struct crypto_instance *inst)
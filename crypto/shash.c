@@ -166,6 +166,22 @@ int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 }
 EXPORT_SYMBOL_GPL(crypto_shash_finup);
 
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs)
+{
+	struct shash_alg *shash = crypto_shash_alg(desc->tfm);
+
+	if (num_msgs == 1)
+		return crypto_shash_finup(desc, data[0], len, outs[0]);
+
+	if (WARN_ON_ONCE(!num_msgs || num_msgs > shash->mb_max_msgs))
+		return -EINVAL;
+
+	return shash->finup_mb(desc, data, len, outs, num_msgs);
+}
+EXPORT_SYMBOL_GPL(crypto_shash_finup_mb);
+
 static int shash_digest_unaligned(struct shash_desc *desc, const u8 *data,
 				  unsigned int len, u8 *out)
 {
@@ -607,6 +623,11 @@ static int shash_prepare_alg(struct shash_alg *alg)
 	}
 	if (!alg->setkey)
 		alg->setkey = shash_no_setkey;
+	if (alg->finup_mb) {
+		if (alg->mb_max_msgs < 2 || base->cra_alignmask)
+			return -EINVAL;
+	} else
+		alg->mb_max_msgs = 1;
 
 	return 0;
 }
@@ -14181,8 +14181,8 @@ static struct cipher_testvec cast6_xts_dec_tv_template[] = {
 #define AES_DEC_TEST_VECTORS 4
 #define AES_CBC_ENC_TEST_VECTORS 5
 #define AES_CBC_DEC_TEST_VECTORS 5
-#define AES_HEH_ENC_TEST_VECTORS 4
-#define AES_HEH_DEC_TEST_VECTORS 4
+#define AES_HEH_ENC_TEST_VECTORS 5
+#define AES_HEH_DEC_TEST_VECTORS 5
 #define HMAC_MD5_ECB_CIPHER_NULL_ENC_TEST_VECTORS 2
 #define HMAC_MD5_ECB_CIPHER_NULL_DEC_TEST_VECTORS 2
 #define HMAC_SHA1_ECB_CIPHER_NULL_ENC_TEST_VEC 2
@@ -14648,6 +14648,93 @@ static struct cipher_testvec aes_heh_enc_tv_template[] = {
 		.also_non_np = 1,
 		.np	= 8,
 		.tap	= { 20, 20, 10, 8, 2, 1, 1, 1 },
+	}, {
+		.key    = "\xa8\xda\x24\x9b\x5e\xfa\x13\xc2"
+			  "\xc1\x94\xbf\x32\xba\x38\xa3\x77",
+		.klen   = 16,
+		.iv	= "\x4d\x47\x61\x37\x2b\x47\x86\xf0"
+			  "\xd6\x47\xb5\xc2\xe8\xcf\x85\x27",
+		.input	= "\x5b\x78\x95\xb2\xcf\xec\x09\x26"
+			  "\x43\x60\x7d\x9a\xb7\xd4\xf1\x0e"
+			  "\x2b\x48\x65\x82\x9f\xbc\xd9\xf6"
+			  "\x13\x30\x4d\x6a\x87\xa4\xc1\xde"
+			  "\xfb\x18\x35\x52\x6f\x8c\xa9\xc6"
+			  "\xe3\x00\x1d\x3a\x57\x74\x91\xae"
+			  "\xcb\xe8\x05\x22\x3f\x5c\x79\x96"
+			  "\xb3\xd0\xed\x0a\x27\x44\x61\x7e"
+			  "\x9b\xb8\xd5\xf2\x0f\x2c\x49\x66"
+			  "\x83\xa0\xbd\xda\xf7\x14\x31\x4e"
+			  "\x6b\x88\xa5\xc2\xdf\xfc\x19\x36"
+			  "\x53\x70\x8d\xaa\xc7\xe4\x01\x1e"
+			  "\x3b\x58\x75\x92\xaf\xcc\xe9\x06"
+			  "\x23\x40\x5d\x7a\x97\xb4\xd1\xee"
+			  "\x0b\x28\x45\x62\x7f\x9c\xb9\xd6"
+			  "\xf3\x10\x2d\x4a\x67\x84\xa1\xbe"
+			  "\xdb\xf8\x15\x32\x4f\x6c\x89\xa6"
+			  "\xc3\xe0\xfd\x1a\x37\x54\x71\x8e"
+			  "\xab\xc8\xe5\x02\x1f\x3c\x59\x76"
+			  "\x93\xb0\xcd\xea\x07\x24\x41\x5e"
+			  "\x7b\x98\xb5\xd2\xef\x0c\x29\x46"
+			  "\x63\x80\x9d\xba\xd7\xf4\x11\x2e"
+			  "\x4b\x68\x85\xa2\xbf\xdc\xf9\x16"
+			  "\x33\x50\x6d\x8a\xa7\xc4\xe1\xfe"
+			  "\x1b\x38\x55\x72\x8f\xac\xc9\xe6"
+			  "\x03\x20\x3d\x5a\x77\x94\xb1\xce"
+			  "\xeb\x08\x25\x42\x5f\x7c\x99\xb6"
+			  "\xd3\xf0\x0d\x2a\x47\x64\x81\x9e"
+			  "\xbb\xd8\xf5\x12\x2f\x4c\x69\x86"
+			  "\xa3\xc0\xdd\xfa\x17\x34\x51\x6e"
+			  "\x8b\xa8\xc5\xe2\xff\x1c\x39\x56"
+			  "\x73\x90\xad\xca\xe7\x04\x21\x3e"
+			  "\x5b\x78\x95\xb2\xcf\xec\x09\x26"
+			  "\x43\x60\x7d\x9a\xb7\xd4\xf1\x0e"
+			  "\x2b\x48\x65\x82\x9f\xbc\xd9\xf6"
+			  "\x13\x30\x4d\x6a\x87\xa4\xc1\xde"
+			  "\xfb\x18\x35\x52\x6f\x8c\xa9\xc6"
+			  "\xe3\x00\x1d\x3a",
+		.ilen   = 300,
+		.result = "\x9f\xf3\x35\x56\xd0\xad\x8d\x7e"
+			  "\x17\xcf\xff\x7d\x6d\x15\x63\x61"
+			  "\x18\xf5\x83\x68\x2c\x02\x90\x27"
+			  "\xe7\xfa\x6e\xe1\x31\x65\x63\xe9"
+			  "\x90\xe7\x1d\xf7\xa1\x6f\xc3\x28"
+			  "\x68\x79\xe0\xf3\xac\xd2\xb2\x54"
+			  "\x48\x45\xfb\x3c\x33\x27\xe3\xad"
+			  "\xb3\x19\xf9\xa3\x64\xc1\x56\x22"
+			  "\xc5\xe1\x21\x8d\xc7\x53\x01\xbd"
+			  "\x1b\x0f\x74\xde\xe3\xf4\xb5\x3c"
+			  "\xfe\xd6\xb9\xc8\xd1\xb8\x9f\x70"
+			  "\xa0\x2d\xfb\xf7\x50\xc7\xc0\x22"
+			  "\x03\xdc\x3c\x8f\xdb\x20\x27\x7b"
+			  "\x2d\xef\xec\xd0\xaa\x83\x92\xb5"
+			  "\x06\xe4\x55\x52\xb2\x28\x5d\x19"
+			  "\x06\xc3\x33\xf8\x57\x97\xa0\xef"
+			  "\xa5\xb3\xe6\x29\x48\x43\x40\x7d"
+			  "\xee\xea\x86\x71\xe9\x1e\xbb\x45"
+			  "\xe7\x1d\x77\x45\x8c\xa1\x78\xe8"
+			  "\xa2\xc6\xc6\x57\xda\x8a\x73\xa5"
+			  "\x6b\x7e\x38\x66\x8c\xce\x11\x4d"
+			  "\x35\x71\xcb\xfc\x40\xe8\xdb\xae"
+			  "\x8c\x6f\x23\x1c\x98\xf1\x65\x05"
+			  "\xb4\x47\xfe\xa4\xb2\x12\x2f\x3b"
+			  "\xbc\x03\x04\x69\x4b\xe6\x59\x85"
+			  "\xd9\xb9\x61\x3f\x13\xbe\x32\x08"
+			  "\x83\x04\x3e\x9d\x6c\x8c\xde\x95"
+			  "\xf6\x55\x41\x06\xf5\x0c\xef\x74"
+			  "\x98\xc7\xf2\x89\x7f\xb0\xdd\x2a"
+			  "\xa3\xca\x13\x80\xa6\x8c\x23\x6f"
+			  "\xbe\x30\xc5\x1e\x9c\x02\xdf\xec"
+			  "\xa7\x12\x2d\x32\x98\xc2\xb8\xc1"
+			  "\xb9\x9a\xea\xf6\xb9\x58\x51\xc2"
+			  "\xd1\x0f\x91\xdb\x57\x49\x3f\x7d"
+			  "\x7d\xc5\x81\x27\x9a\x03\x9f\x14"
+			  "\xef\x6e\x1e\xbd\x78\xd7\xff\x01"
+			  "\x51\xc0\x43\xfb\x80\xec\x93\xd1"
+			  "\xe3\x4b\xa6\x07",
+		.rlen   = 300,
+		.also_non_np = 1,
+		.np	= 3,
+		.tap	= { 256, 30, 14 },
 	}
 };
 
@@ -14744,6 +14831,93 @@ static struct cipher_testvec aes_heh_dec_tv_template[] = {
 		.also_non_np = 1,
 		.np	= 8,
 		.tap	= { 20, 20, 10, 8, 2, 1, 1, 1 },
+	}, {
+		.key    = "\xa8\xda\x24\x9b\x5e\xfa\x13\xc2"
+			  "\xc1\x94\xbf\x32\xba\x38\xa3\x77",
+		.klen   = 16,
+		.iv	= "\x4d\x47\x61\x37\x2b\x47\x86\xf0"
+			  "\xd6\x47\xb5\xc2\xe8\xcf\x85\x27",
+		.input = "\x9f\xf3\x35\x56\xd0\xad\x8d\x7e"
+			  "\x17\xcf\xff\x7d\x6d\x15\x63\x61"
+			  "\x18\xf5\x83\x68\x2c\x02\x90\x27"
+			  "\xe7\xfa\x6e\xe1\x31\x65\x63\xe9"
+			  "\x90\xe7\x1d\xf7\xa1\x6f\xc3\x28"
+			  "\x68\x79\xe0\xf3\xac\xd2\xb2\x54"
+			  "\x48\x45\xfb\x3c\x33\x27\xe3\xad"
+			  "\xb3\x19\xf9\xa3\x64\xc1\x56\x22"
+			  "\xc5\xe1\x21\x8d\xc7\x53\x01\xbd"
+			  "\x1b\x0f\x74\xde\xe3\xf4\xb5\x3c"
+			  "\xfe\xd6\xb9\xc8\xd1\xb8\x9f\x70"
+			  "\xa0\x2d\xfb\xf7\x50\xc7\xc0\x22"
+			  "\x03\xdc\x3c\x8f\xdb\x20\x27\x7b"
+			  "\x2d\xef\xec\xd0\xaa\x83\x92\xb5"
+			  "\x06\xe4\x55\x52\xb2\x28\x5d\x19"
+			  "\x06\xc3\x33\xf8\x57\x97\xa0\xef"
+			  "\xa5\xb3\xe6\x29\x48\x43\x40\x7d"
+			  "\xee\xea\x86\x71\xe9\x1e\xbb\x45"
+			  "\xe7\x1d\x77\x45\x8c\xa1\x78\xe8"
+			  "\xa2\xc6\xc6\x57\xda\x8a\x73\xa5"
+			  "\x6b\x7e\x38\x66\x8c\xce\x11\x4d"
+			  "\x35\x71\xcb\xfc\x40\xe8\xdb\xae"
+			  "\x8c\x6f\x23\x1c\x98\xf1\x65\x05"
+			  "\xb4\x47\xfe\xa4\xb2\x12\x2f\x3b"
+			  "\xbc\x03\x04\x69\x4b\xe6\x59\x85"
+			  "\xd9\xb9\x61\x3f\x13\xbe\x32\x08"
+			  "\x83\x04\x3e\x9d\x6c\x8c\xde\x95"
+			  "\xf6\x55\x41\x06\xf5\x0c\xef\x74"
+			  "\x98\xc7\xf2\x89\x7f\xb0\xdd\x2a"
+			  "\xa3\xca\x13\x80\xa6\x8c\x23\x6f"
+			  "\xbe\x30\xc5\x1e\x9c\x02\xdf\xec"
+			  "\xa7\x12\x2d\x32\x98\xc2\xb8\xc1"
+			  "\xb9\x9a\xea\xf6\xb9\x58\x51\xc2"
+			  "\xd1\x0f\x91\xdb\x57\x49\x3f\x7d"
+			  "\x7d\xc5\x81\x27\x9a\x03\x9f\x14"
+			  "\xef\x6e\x1e\xbd\x78\xd7\xff\x01"
+			  "\x51\xc0\x43\xfb\x80\xec\x93\xd1"
+			  "\xe3\x4b\xa6\x07",
+		.ilen   = 300,
+		.result	= "\x5b\x78\x95\xb2\xcf\xec\x09\x26"
+			  "\x43\x60\x7d\x9a\xb7\xd4\xf1\x0e"
+			  "\x2b\x48\x65\x82\x9f\xbc\xd9\xf6"
+			  "\x13\x30\x4d\x6a\x87\xa4\xc1\xde"
+			  "\xfb\x18\x35\x52\x6f\x8c\xa9\xc6"
+			  "\xe3\x00\x1d\x3a\x57\x74\x91\xae"
+			  "\xcb\xe8\x05\x22\x3f\x5c\x79\x96"
+			  "\xb3\xd0\xed\x0a\x27\x44\x61\x7e"
+			  "\x9b\xb8\xd5\xf2\x0f\x2c\x49\x66"
+			  "\x83\xa0\xbd\xda\xf7\x14\x31\x4e"
+			  "\x6b\x88\xa5\xc2\xdf\xfc\x19\x36"
+			  "\x53\x70\x8d\xaa\xc7\xe4\x01\x1e"
+			  "\x3b\x58\x75\x92\xaf\xcc\xe9\x06"
+			  "\x23\x40\x5d\x7a\x97\xb4\xd1\xee"
+			  "\x0b\x28\x45\x62\x7f\x9c\xb9\xd6"
+			  "\xf3\x10\x2d\x4a\x67\x84\xa1\xbe"
+			  "\xdb\xf8\x15\x32\x4f\x6c\x89\xa6"
+			  "\xc3\xe0\xfd\x1a\x37\x54\x71\x8e"
+			  "\xab\xc8\xe5\x02\x1f\x3c\x59\x76"
+			  "\x93\xb0\xcd\xea\x07\x24\x41\x5e"
+			  "\x7b\x98\xb5\xd2\xef\x0c\x29\x46"
+			  "\x63\x80\x9d\xba\xd7\xf4\x11\x2e"
+			  "\x4b\x68\x85\xa2\xbf\xdc\xf9\x16"
+			  "\x33\x50\x6d\x8a\xa7\xc4\xe1\xfe"
+			  "\x1b\x38\x55\x72\x8f\xac\xc9\xe6"
+			  "\x03\x20\x3d\x5a\x77\x94\xb1\xce"
+			  "\xeb\x08\x25\x42\x5f\x7c\x99\xb6"
+			  "\xd3\xf0\x0d\x2a\x47\x64\x81\x9e"
+			  "\xbb\xd8\xf5\x12\x2f\x4c\x69\x86"
+			  "\xa3\xc0\xdd\xfa\x17\x34\x51\x6e"
+			  "\x8b\xa8\xc5\xe2\xff\x1c\x39\x56"
+			  "\x73\x90\xad\xca\xe7\x04\x21\x3e"
+			  "\x5b\x78\x95\xb2\xcf\xec\x09\x26"
+			  "\x43\x60\x7d\x9a\xb7\xd4\xf1\x0e"
+			  "\x2b\x48\x65\x82\x9f\xbc\xd9\xf6"
+			  "\x13\x30\x4d\x6a\x87\xa4\xc1\xde"
+			  "\xfb\x18\x35\x52\x6f\x8c\xa9\xc6"
+			  "\xe3\x00\x1d\x3a",
+		.rlen   = 300,
+		.also_non_np = 1,
+		.np	= 3,
+		.tap	= { 256, 30, 14 },
 	}
 };
 
@@ -56,6 +56,7 @@
 #include <linux/file.h>
 #include <linux/freezer.h>
 #include <linux/fs.h>
+#include <linux/highmem.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
@@ -69,6 +70,7 @@
 #include <linux/uaccess.h>
 #include <linux/pid_namespace.h>
 #include <linux/security.h>
+#include <linux/sizes.h>
 #include <linux/spinlock.h>
 
 #include <uapi/linux/android/binder.h>
@@ -143,6 +145,13 @@ module_param_named(debug_mask, binder_debug_mask, uint, 0644);
 static char *binder_devices_param = CONFIG_ANDROID_BINDER_DEVICES;
 module_param_named(devices, binder_devices_param, charp, S_IRUGO);
 
+/* Smallest TF_LARGE_DATA payload that is copied from pinned pages */
+static unsigned int binder_pin_copy_min = SZ_64K;
+module_param_named(pin_copy_min, binder_pin_copy_min, uint, 0644);
+
+static atomic64_t binder_bytes_pinned;
+static atomic64_t binder_bytes_copied;
+
 static DECLARE_WAIT_QUEUE_HEAD(binder_user_error_wait);
 static int binder_stop_on_user_error;
 
@@ -214,6 +223,43 @@ static inline void binder_stats_created(enum binder_stat_types type)
 	atomic_inc(&binder_stats.obj_created[type]);
 }
 
+/*
+ * Transaction latency histograms. Bucket 0 counts latencies below 1us,
+ * bucket n latencies in [2^(n-1), 2^n) us; the last bucket collects
+ * everything from 16ms, i.e. a missed frame, upwards.
+ */
+#define BINDER_LAT_BUCKETS 16
+
+enum binder_lat_types {
+	BINDER_LAT_QUEUE,	/* enqueue to pickup by a thread */
+	BINDER_LAT_SERVICE,	/* pickup to reply */
+	BINDER_LAT_COUNT
+};
+
+static const char * const binder_lat_strings[] = {
+	"queue",
+	"service",
+};
+
+struct binder_lat_hist {
+	u32 count[BINDER_LAT_COUNT][BINDER_LAT_BUCKETS];
+	u64 total_ns[BINDER_LAT_COUNT];
+};
+
+static inline void binder_lat_record(struct binder_lat_hist __percpu *hist,
+				     enum binder_lat_types type, u64 delta_ns)
+{
+	int bucket;
+
+	if (!hist)
+		return;
+	bucket = fls64(div_u64(delta_ns, NSEC_PER_USEC));
+	if (bucket >= BINDER_LAT_BUCKETS)
+		bucket = BINDER_LAT_BUCKETS - 1;
+	this_cpu_inc(hist->count[type][bucket]);
+	this_cpu_add(hist->total_ns[type], delta_ns);
+}
+
 struct binder_transaction_log_entry {
 	int debug_id;
 	int debug_id_done;
@@ -361,6 +407,9 @@ struct binder_error {
  *                        (invariant after initialized)
  * @async_todo:           list of async work items
  *                        (protected by @proc->inner_lock)
+ * @lat_hist:             per-CPU latency of transactions to this node,
+ *                        allocated on its first transaction
+ *                        (lockless, may be NULL)
  *
  * Bookkeeping structure for binder nodes.
  */
@@ -402,6 +451,7 @@ struct binder_node {
 	};
 	bool has_async_transaction;
 	struct list_head async_todo;
+	struct binder_lat_hist __percpu *lat_hist;
 };
 
 struct binder_ref_death {
@@ -539,6 +589,8 @@ struct binder_priority {
  * @inner_lock:           can nest under outer_lock and/or node lock
  * @outer_lock:           no nesting under innor or node lock
  *                        Lock order: 1) outer, 2) node, 3) inner
+ * @lat_hist:             per-CPU latency of transactions to this proc
+ *                        (lockless, may be NULL)
  *
  * Bookkeeping structure for binder processes
  */
@@ -570,6 +622,7 @@ struct binder_proc {
 	struct binder_context *context;
 	spinlock_t inner_lock;
 	spinlock_t outer_lock;
+	struct binder_lat_hist __percpu *lat_hist;
 };
 
 enum {
@@ -656,6 +709,15 @@ struct binder_transaction {
 	bool    set_priority_called;
 	kuid_t	sender_euid;
 	binder_uintptr_t security_ctx;
+	/*
+	 * @enqueue_ns is set when the transaction is queued, @pickup_ns
+	 * when a thread of a sync call's target reads it. @service_node
+	 * holds a tmpref on the target node until the transaction is freed
+	 * so the service time can be charged to it on reply.
+	 */
+	u64 enqueue_ns;
+	u64 pickup_ns;
+	struct binder_node *service_node;
 	/**
 	 * @lock:  protects @from, @to_proc, and @to_thread
 	 *
@@ -1376,8 +1438,29 @@ static struct binder_node *binder_new_node(struct binder_proc *proc,
 	return node;
 }
 
+/*
+ * Most nodes never see a transaction, so a node's histogram is only
+ * allocated when it is first needed. Returns NULL if that fails.
+ */
+static struct binder_lat_hist __percpu *
+binder_node_lat_hist(struct binder_node *node)
+{
+	struct binder_lat_hist __percpu *hist = READ_ONCE(node->lat_hist);
+
+	if (hist)
+		return hist;
+	hist = alloc_percpu_gfp(struct binder_lat_hist,
+				GFP_KERNEL | __GFP_NOWARN);
+	if (hist && cmpxchg(&node->lat_hist, NULL, hist)) {
+		free_percpu(hist);
+		hist = READ_ONCE(node->lat_hist);
+	}
+	return hist;
+}
+
 static void binder_free_node(struct binder_node *node)
 {
+	free_percpu(node->lat_hist);
 	kfree(node);
 	binder_stats_deleted(BINDER_STAT_NODE);
 }
@@ -2099,6 +2182,8 @@ static void binder_free_transaction(struct binder_transaction *t)
 {
 	if (t->buffer)
 		t->buffer->transaction = NULL;
+	if (t->service_node)
+		binder_dec_node_tmpref(t->service_node);
 	kfree(t);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION);
 }
@@ -2860,6 +2945,82 @@ static struct binder_node *binder_get_node_refs_for_txn(
 	return target_node;
 }
 
+#define BINDER_PIN_BATCH 16
+
+/*
+ * Copy @size bytes at sender address @uptr into @dst straight from the
+ * sender's pages, pinning BINDER_PIN_BATCH of them at a time. This saves
+ * the per-access fault handling of copy_from_user() on large payloads.
+ * Returns the number of bytes copied, which falls short of @size if a
+ * page could not be pinned.
+ */
+static size_t binder_copy_pinned(void *dst, uintptr_t uptr, size_t size)
+{
+	struct page *pages[BINDER_PIN_BATCH];
+	size_t done = 0;
+
+	while (done < size) {
+		size_t offset = (uptr + done) & ~PAGE_MASK;
+		int nr, pinned, i;
+
+		nr = min_t(size_t, BINDER_PIN_BATCH,
+			   DIV_ROUND_UP(offset + size - done, PAGE_SIZE));
+		pinned = get_user_pages_fast((uptr + done) & PAGE_MASK, nr, 0,
+					     pages);
+		if (pinned <= 0)
+			break;
+
+		for (i = 0; i < pinned; i++) {
+			size_t len = min_t(size_t, PAGE_SIZE - offset,
+					   size - done);
+			void *src = kmap_atomic(pages[i]);
+
+			memcpy(dst + done, src + offset, len);
+			kunmap_atomic(src);
+			put_page(pages[i]);
+			done += len;
+			offset = 0;
+		}
+		if (pinned < nr)
+			break;
+	}
+	return done;
+}
+
+/**
+ * binder_copy_user_data() - copy transaction payload from the sender
+ * @t:		transaction being built
+ * @dst:	kernel address in the target buffer
+ * @uptr:	sender user address
+ * @size:	number of bytes to copy
+ * @pinned:	incremented by the bytes copied from pinned pages
+ * @copied:	incremented by the bytes copied with copy_from_user()
+ *
+ * Payloads of at least pin_copy_min bytes in a TF_LARGE_DATA transaction
+ * are copied from pinned sender pages. Anything that could not be pinned,
+ * and every other payload, falls back to copy_from_user().
+ *
+ * Return: 0 on success, -EFAULT if @uptr is not readable
+ */
+static int binder_copy_user_data(struct binder_transaction *t, void *dst,
+				 binder_uintptr_t uptr, size_t size,
+				 size_t *pinned, size_t *copied)
+{
+	size_t done = 0;
+
+	if ((t->flags & TF_LARGE_DATA) && size >= binder_pin_copy_min)
+		done = binder_copy_pinned(dst, (uintptr_t)uptr, size);
+
+	if (copy_from_user(dst + done,
+			   (const void __user *)(uintptr_t)(uptr + done),
+			   size - done))
+		return -EFAULT;
+
+	*pinned += done;
+	*copied += size - done;
+	return 0;
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
 			       struct binder_transaction_data *tr, int reply,
@@ -2871,6 +3032,7 @@ static void binder_transaction(struct binder_proc *proc,
 	binder_size_t *offp, *off_end, *off_start;
 	binder_size_t off_min;
 	u8 *sg_bufp, *sg_buf_end;
+	size_t bytes_pinned = 0, bytes_copied = 0;
 	struct binder_proc *target_proc = NULL;
 	struct binder_thread *target_thread = NULL;
 	struct binder_node *target_node = NULL;
@@ -3174,8 +3336,9 @@ static void binder_transaction(struct binder_proc *proc,
 				      ALIGN(tr->data_size, sizeof(void *)));
 	offp = off_start;
 
-	if (copy_from_user(t->buffer->data, (const void __user *)(uintptr_t)
-			   tr->data.ptr.buffer, tr->data_size)) {
+	if (binder_copy_user_data(t, t->buffer->data, tr->data.ptr.buffer,
+				  tr->data_size, &bytes_pinned,
+				  &bytes_copied)) {
 		binder_user_error("%d:%d got transaction with invalid data ptr\n",
 				proc->pid, thread->pid);
 		return_error = BR_FAILED_REPLY;
@@ -3324,9 +3487,9 @@ static void binder_transaction(struct binder_proc *proc,
 				return_error_line = __LINE__;
 				goto err_bad_offset;
 			}
-			if (copy_from_user(sg_bufp,
-					   (const void __user *)(uintptr_t)
-					   bp->buffer, bp->length)) {
+			if (binder_copy_user_data(t, sg_bufp, bp->buffer,
+						  bp->length, &bytes_pinned,
+						  &bytes_copied)) {
 				binder_user_error("%d:%d got transaction with invalid offsets ptr\n",
 						  proc->pid, thread->pid);
 				return_error_param = -EFAULT;
@@ -3362,8 +3525,12 @@ static void binder_transaction(struct binder_proc *proc,
 			goto err_bad_object_type;
 		}
 	}
+	trace_binder_transaction_copy(t, bytes_pinned, bytes_copied,
+		atomic64_add_return(bytes_pinned, &binder_bytes_pinned),
+		atomic64_add_return(bytes_copied, &binder_bytes_copied));
 	tcomplete->type = BINDER_WORK_TRANSACTION_COMPLETE;
 	t->work.type = BINDER_WORK_TRANSACTION;
+	t->enqueue_ns = ktime_get_ns();
 
 	if (reply) {
 		binder_enqueue_thread_work(thread, tcomplete);
@@ -3378,6 +3545,14 @@ static void binder_transaction(struct binder_proc *proc,
 		wake_up_interruptible(&target_thread->wait);
 		binder_inner_proc_unlock(target_proc);
 		binder_restore_priority(current, in_reply_to->saved_priority);
+		if (in_reply_to->service_node) {
+			u64 delta = t->enqueue_ns - in_reply_to->pickup_ns;
+
+			binder_lat_record(proc->lat_hist, BINDER_LAT_SERVICE,
+					  delta);
+			binder_lat_record(in_reply_to->service_node->lat_hist,
+					  BINDER_LAT_SERVICE, delta);
+		}
 		binder_free_transaction(in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
@@ -4360,6 +4535,26 @@ retry:
 
 		trace_binder_transaction_received(t);
 		binder_stat_br(proc, thread, cmd);
+		if (cmd != BR_REPLY) {
+			struct binder_node *node = t->buffer->target_node;
+			u64 delta;
+
+			t->pickup_ns = ktime_get_ns();
+			delta = t->pickup_ns - t->enqueue_ns;
+			binder_lat_record(proc->lat_hist, BINDER_LAT_QUEUE,
+					  delta);
+			binder_lat_record(binder_node_lat_hist(node),
+					  BINDER_LAT_QUEUE, delta);
+			/*
+			 * Pin the node for the service time while the buffer,
+			 * which can be freed once allow_user_free is set,
+			 * still holds it.
+			 */
+			if (!(t->flags & TF_ONE_WAY)) {
+				t->service_node = node;
+				binder_inc_node_tmpref(node);
+			}
+		}
 		binder_debug(BINDER_DEBUG_TRANSACTION,
 			     "%d:%d %s %d %d:%d, cmd %d size %zd-%zd ptr %016llx-%016llx\n",
 			     proc->pid, thread->pid,
@@ -4537,6 +4732,7 @@ static void binder_free_proc(struct binder_proc *proc)
 	binder_alloc_deferred_release(&proc->alloc);
 	put_task_struct(proc->tsk);
 	binder_stats_deleted(BINDER_STAT_PROC);
+	free_percpu(proc->lat_hist);
 	kfree(proc);
 }
 
@@ -5057,6 +5253,7 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	proc = kzalloc(sizeof(*proc), GFP_KERNEL);
 	if (proc == NULL)
 		return -ENOMEM;
+	proc->lat_hist = alloc_percpu(struct binder_lat_hist);
 	spin_lock_init(&proc->inner_lock);
 	spin_lock_init(&proc->outer_lock);
 	get_task_struct(current->group_leader);
@@ -5794,6 +5991,9 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	seq_puts(m, "binder stats:\n");
 
 	print_binder_stats(m, "", &binder_stats);
+	seq_printf(m, "bytes pinned: %lld\nbytes copied: %lld\n",
+		   (long long)atomic64_read(&binder_bytes_pinned),
+		   (long long)atomic64_read(&binder_bytes_copied));
 
 	mutex_lock(&binder_procs_lock);
 	hlist_for_each_entry(proc, &binder_procs, proc_node)
@@ -5803,6 +6003,78 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static void print_binder_lat_hist(struct seq_file *m, const char *prefix,
+				  struct binder_lat_hist __percpu *hist)
+{
+	u64 sum[BINDER_LAT_COUNT][BINDER_LAT_BUCKETS] = {};
+	u64 total_ns[BINDER_LAT_COUNT] = {};
+	bool used = false;
+	int cpu, type, i;
+
+	if (!hist)
+		return;
+	for_each_possible_cpu(cpu) {
+		struct binder_lat_hist *h = per_cpu_ptr(hist, cpu);
+
+		for (type = 0; type < BINDER_LAT_COUNT; type++) {
+			for (i = 0; i < BINDER_LAT_BUCKETS; i++) {
+				sum[type][i] += h->count[type][i];
+				used |= !!h->count[type][i];
+			}
+			total_ns[type] += h->total_ns[type];
+		}
+	}
+	if (!used)
+		return;
+
+	seq_printf(m, "%s\n", prefix);
+	BUILD_BUG_ON(ARRAY_SIZE(binder_lat_strings) != BINDER_LAT_COUNT);
+	for (type = 0; type < BINDER_LAT_COUNT; type++) {
+		seq_printf(m, "    %s:", binder_lat_strings[type]);
+		for (i = 0; i < BINDER_LAT_BUCKETS; i++)
+			seq_printf(m, " %llu", sum[type][i]);
+		seq_printf(m, " total %llu\n",
+			   div_u64(total_ns[type], NSEC_PER_USEC));
+	}
+}
+
+static void print_binder_proc_latency(struct seq_file *m,
+				      struct binder_proc *proc)
+{
+	struct binder_node *node;
+	struct rb_node *n;
+	char prefix[32];
+
+	snprintf(prefix, sizeof(prefix), "proc %d", proc->pid);
+	print_binder_lat_hist(m, prefix, proc->lat_hist);
+
+	binder_inner_proc_lock(proc);
+	for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n)) {
+		node = rb_entry(n, struct binder_node, rb_node);
+		snprintf(prefix, sizeof(prefix), "  node %d", node->debug_id);
+		print_binder_lat_hist(m, prefix, READ_ONCE(node->lat_hist));
+	}
+	binder_inner_proc_unlock(proc);
+}
+
+static int binder_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_proc *proc;
+	int i;
+
+	seq_puts(m, "binder latency (usecs):");
+	for (i = 0; i < BINDER_LAT_BUCKETS; i++)
+		seq_printf(m, " %s%u", i ? "" : "<", i ? 1U << (i - 1) : 1);
+	seq_puts(m, "+\n");
+
+	mutex_lock(&binder_procs_lock);
+	hlist_for_each_entry(proc, &binder_procs, proc_node)
+		print_binder_proc_latency(m, proc);
+	mutex_unlock(&binder_procs_lock);
+
+	return 0;
+}
+
 static int binder_transactions_show(struct seq_file *m, void *unused)
 {
 	struct binder_proc *proc;
@@ -5893,6 +6165,7 @@ static const struct file_operations binder_fops = {
 
 BINDER_DEBUG_ENTRY(state);
 BINDER_DEBUG_ENTRY(stats);
+BINDER_DEBUG_ENTRY(latency);
 BINDER_DEBUG_ENTRY(transactions);
 BINDER_DEBUG_ENTRY(transaction_log);
 
@@ -5957,6 +6230,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    NULL,
 				    &binder_stats_fops);
+		debugfs_create_file("latency",
+				    0444,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
 		debugfs_create_file("transactions",
 				    0444,
 				    binder_debugfs_dir_entry_root,
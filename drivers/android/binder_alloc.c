@@ -45,6 +45,12 @@ static uint32_t binder_alloc_debug_mask;
 module_param_named(debug_mask, binder_alloc_debug_mask,
 		   uint, S_IWUSR | S_IRUGO);
 
+/* Max buffers cached per size class and proc, 0 disables caching */
+static unsigned int binder_alloc_class_depth = 8;
+
+module_param_named(class_depth, binder_alloc_class_depth,
+		   uint, S_IWUSR | S_IRUGO);
+
 #define binder_alloc_debug(mask, x...) \
 	do { \
 		if (binder_alloc_debug_mask & mask) \
@@ -70,6 +76,28 @@ static size_t binder_alloc_buffer_size(struct binder_alloc *alloc,
 	return (u8 *)binder_buffer_next(buffer)->data - (u8 *)buffer->data;
 }
 
+/* Smallest size class whose buffers can all hold @size bytes */
+static int binder_alloc_size_class(size_t size)
+{
+	int order = order_base_2(size);
+
+	if (order < BINDER_ALLOC_CLASS_MIN_SHIFT)
+		order = BINDER_ALLOC_CLASS_MIN_SHIFT;
+	order -= BINDER_ALLOC_CLASS_MIN_SHIFT;
+	return order < BINDER_ALLOC_NR_CLASSES ? order : -1;
+}
+
+/* Size class a free buffer of @buffer_size bytes can serve */
+static int binder_alloc_buffer_class(size_t buffer_size)
+{
+	int order = ilog2(buffer_size);
+
+	if (order < BINDER_ALLOC_CLASS_MIN_SHIFT)
+		return -1;
+	order -= BINDER_ALLOC_CLASS_MIN_SHIFT;
+	return order < BINDER_ALLOC_NR_CLASSES ? order : -1;
+}
+
 static void binder_insert_free_buffer(struct binder_alloc *alloc,
 				      struct binder_buffer *new_buffer)
 {
@@ -331,6 +359,8 @@ err_no_vma:
 	return vma ? -ENOMEM : -ESRCH;
 }
 
+static bool binder_alloc_drain_classes_locked(struct binder_alloc *alloc);
+
 static struct binder_buffer *binder_alloc_new_buf_locked(
 				struct binder_alloc *alloc,
 				size_t data_size,
@@ -338,14 +368,14 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 				size_t extra_buffers_size,
 				int is_async)
 {
-	struct rb_node *n = alloc->free_buffers.rb_node;
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	size_t buffer_size;
 	struct rb_node *best_fit = NULL;
 	void *has_page_addr;
 	void *end_page_addr;
 	size_t size, data_offsets_size;
-	int ret;
+	int class, ret;
 
 	if (alloc->vma == NULL) {
 		pr_err("%d: binder_alloc_buf, no vma\n",
@@ -380,6 +410,24 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 	/* Pad 0-size buffers so they get assigned unique addresses */
 	size = max(size, sizeof(void *));
 
+	/*
+	 * A cached buffer of the right class is still mapped and needs
+	 * neither a tree search nor a trip to binder_update_page_range().
+	 */
+	class = binder_alloc_size_class(size);
+	if (class >= 0 && !list_empty(&alloc->free_classes[class])) {
+		buffer = list_first_entry(&alloc->free_classes[class],
+					  struct binder_buffer, class_entry);
+		list_del(&buffer->class_entry);
+		alloc->free_class_count[class]--;
+		binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
+			     "%d: binder_alloc_buf size %zd got cached buffer %pK class %d\n",
+			      alloc->pid, size, buffer, class);
+		goto out_buffer;
+	}
+
+retry:
+	n = alloc->free_buffers.rb_node;
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(!buffer->free);
@@ -395,6 +443,8 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 			break;
 		}
 	}
+	if (best_fit == NULL && binder_alloc_drain_classes_locked(alloc))
+		goto retry;
 	if (best_fit == NULL) {
 		size_t allocated_buffers = 0;
 		size_t largest_alloc_size = 0;
@@ -466,6 +516,7 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 
 	rb_erase(best_fit, &alloc->free_buffers);
 	buffer->free = 0;
+out_buffer:
 	buffer->allow_user_free = 0;
 	binder_insert_allocated_buffer_locked(alloc, buffer);
 	binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
@@ -576,6 +627,94 @@ static void binder_delete_free_buffer(struct binder_alloc *alloc,
 	kfree(buffer);
 }
 
+/*
+ * Return @buffer, which is in neither rb tree, to free_buffers: release
+ * the pages it alone covers and merge it with free neighbours.
+ */
+static void binder_release_buf_locked(struct binder_alloc *alloc,
+				      struct binder_buffer *buffer,
+				      size_t buffer_size)
+{
+	binder_update_page_range(alloc, 0,
+		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
+		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK));
+
+	buffer->free = 1;
+	if (!list_is_last(&buffer->entry, &alloc->buffers)) {
+		struct binder_buffer *next = binder_buffer_next(buffer);
+
+		if (next->free) {
+			rb_erase(&next->rb_node, &alloc->free_buffers);
+			binder_delete_free_buffer(alloc, next);
+		}
+	}
+	if (alloc->buffers.next != &buffer->entry) {
+		struct binder_buffer *prev = binder_buffer_prev(buffer);
+
+		if (prev->free) {
+			binder_delete_free_buffer(alloc, buffer);
+			rb_erase(&prev->rb_node, &alloc->free_buffers);
+			buffer = prev;
+		}
+	}
+	binder_insert_free_buffer(alloc, buffer);
+}
+
+/*
+ * Park a small freed buffer on its size class list. It keeps its pages
+ * and its place in alloc->buffers, so to its neighbours it still looks
+ * allocated and is never merged until the classes are drained.
+ */
+static bool binder_cache_buf_locked(struct binder_alloc *alloc,
+				    struct binder_buffer *buffer,
+				    size_t buffer_size)
+{
+	int class = binder_alloc_buffer_class(buffer_size);
+
+	if (class < 0 ||
+	    alloc->free_class_count[class] >= binder_alloc_class_depth)
+		return false;
+
+	list_add(&buffer->class_entry, &alloc->free_classes[class]);
+	alloc->free_class_count[class]++;
+	return true;
+}
+
+static bool binder_alloc_drain_classes_locked(struct binder_alloc *alloc)
+{
+	struct binder_buffer *buffer;
+	bool drained = false;
+	int i;
+
+	for (i = 0; i < BINDER_ALLOC_NR_CLASSES; i++) {
+		while (!list_empty(&alloc->free_classes[i])) {
+			buffer = list_first_entry(&alloc->free_classes[i],
+						  struct binder_buffer,
+						  class_entry);
+			list_del(&buffer->class_entry);
+			binder_release_buf_locked(alloc, buffer,
+					binder_alloc_buffer_size(alloc, buffer));
+			drained = true;
+		}
+		alloc->free_class_count[i] = 0;
+	}
+	return drained;
+}
+
+/**
+ * binder_alloc_drain_classes() - release all cached small buffers
+ * @alloc:	binder_alloc for this proc
+ *
+ * Move every buffer held on the size class lists back to the free tree
+ * and hand the pages only they were using to the shrinker.
+ */
+void binder_alloc_drain_classes(struct binder_alloc *alloc)
+{
+	mutex_lock(&alloc->mutex);
+	binder_alloc_drain_classes_locked(alloc);
+	mutex_unlock(&alloc->mutex);
+}
+
 static void binder_free_buf_locked(struct binder_alloc *alloc,
 				   struct binder_buffer *buffer)
 {
@@ -605,30 +744,10 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 			      alloc->pid, size, alloc->free_async_space);
 	}
 
-	binder_update_page_range(alloc, 0,
-		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
-		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK));
-
 	rb_erase(&buffer->rb_node, &alloc->allocated_buffers);
-	buffer->free = 1;
-	if (!list_is_last(&buffer->entry, &alloc->buffers)) {
-		struct binder_buffer *next = binder_buffer_next(buffer);
-
-		if (next->free) {
-			rb_erase(&next->rb_node, &alloc->free_buffers);
-			binder_delete_free_buffer(alloc, next);
-		}
-	}
-	if (alloc->buffers.next != &buffer->entry) {
-		struct binder_buffer *prev = binder_buffer_prev(buffer);
-
-		if (prev->free) {
-			binder_delete_free_buffer(alloc, buffer);
-			rb_erase(&prev->rb_node, &alloc->free_buffers);
-			buffer = prev;
-		}
-	}
-	binder_insert_free_buffer(alloc, buffer);
+	if (alloc->vma && binder_cache_buf_locked(alloc, buffer, buffer_size))
+		return;
+	binder_release_buf_locked(alloc, buffer, buffer_size);
 }
 
 /**
@@ -761,6 +880,7 @@ void binder_alloc_deferred_release(struct binder_alloc *alloc)
 		binder_free_buf_locked(alloc, buffer);
 		buffers++;
 	}
+	binder_alloc_drain_classes_locked(alloc);
 
 	while (!list_empty(&alloc->buffers)) {
 		buffer = list_first_entry(&alloc->buffers,
@@ -863,6 +983,10 @@ void binder_alloc_print_pages(struct seq_file *m,
 	mutex_unlock(&alloc->mutex);
 	seq_printf(m, "  pages: %d:%d:%d\n", active, lru, free);
 	seq_printf(m, "  pages high watermark: %zu\n", alloc->pages_high);
+	seq_puts(m, "  cached buffers:");
+	for (i = 0; i < BINDER_ALLOC_NR_CLASSES; i++)
+		seq_printf(m, " %u", alloc->free_class_count[i]);
+	seq_puts(m, "\n");
 }
 
 /**
@@ -1006,9 +1130,13 @@ static struct shrinker binder_shrinker = {
  */
 void binder_alloc_init(struct binder_alloc *alloc)
 {
+	int i;
+
 	alloc->pid = current->group_leader->pid;
 	mutex_init(&alloc->mutex);
 	INIT_LIST_HEAD(&alloc->buffers);
+	for (i = 0; i < BINDER_ALLOC_NR_CLASSES; i++)
+		INIT_LIST_HEAD(&alloc->free_classes[i]);
 }
 
 int binder_alloc_shrinker_init(void)
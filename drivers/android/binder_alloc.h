@@ -30,6 +30,7 @@ struct binder_transaction;
  * struct binder_buffer - buffer used for binder transactions
  * @entry:              entry alloc->buffers
  * @rb_node:            node for allocated_buffers/free_buffers rb trees
+ * @class_entry:        entry in alloc->free_classes while cached
  * @free:               true if buffer is free
  * @allow_user_free:    describe the second member of struct blah,
  * @async_transaction:  describe the second member of struct blah,
@@ -45,8 +46,11 @@ struct binder_transaction;
  */
 struct binder_buffer {
 	struct list_head entry; /* free and allocated entries by address */
-	struct rb_node rb_node; /* free entry by size or allocated entry */
-				/* by address */
+	union {
+		struct rb_node rb_node; /* free entry by size or allocated */
+					/* entry by address */
+		struct list_head class_entry; /* cached in a size class */
+	};
 	unsigned free:1;
 	unsigned allow_user_free:1;
 	unsigned async_transaction:1;
@@ -61,6 +65,14 @@ struct binder_buffer {
 	void *data;
 };
 
+/*
+ * Small buffers are kept on per-size-class lists when freed instead of being
+ * merged back into free_buffers. Class n holds buffers of at least
+ * 1 << (BINDER_ALLOC_CLASS_MIN_SHIFT + n) bytes.
+ */
+#define BINDER_ALLOC_CLASS_MIN_SHIFT	7
+#define BINDER_ALLOC_NR_CLASSES		5
+
 /**
  * struct binder_lru_page - page object used for binder shrinker
  * @page_ptr: pointer to physical page in mmap'd space
@@ -92,6 +104,9 @@ struct binder_lru_page {
  * @buffer_size:        size of address space specified via mmap
  * @pid:                pid for associated binder_proc (invariant after init)
  * @pages_high:         high watermark of offset in @pages
+ * @free_classes:       freed small buffers by size class; they keep their
+ *                      pages mapped and stay out of @free_buffers
+ * @free_class_count:   number of buffers on each @free_classes list
  *
  * Bookkeeping structure for per-proc address space management for binder
  * buffers. It is normally initialized during binder_init() and binder_mmap()
@@ -113,6 +128,8 @@ struct binder_alloc {
 	uint32_t buffer_free;
 	int pid;
 	size_t pages_high;
+	struct list_head free_classes[BINDER_ALLOC_NR_CLASSES];
+	unsigned int free_class_count[BINDER_ALLOC_NR_CLASSES];
 };
 
 #ifdef CONFIG_ANDROID_BINDER_IPC_SELFTEST
@@ -139,6 +156,7 @@ extern void binder_alloc_free_buf(struct binder_alloc *alloc,
 extern int binder_alloc_mmap_handler(struct binder_alloc *alloc,
 				     struct vm_area_struct *vma);
 extern void binder_alloc_deferred_release(struct binder_alloc *alloc);
+extern void binder_alloc_drain_classes(struct binder_alloc *alloc);
 extern int binder_alloc_get_allocated_count(struct binder_alloc *alloc);
 extern void binder_alloc_print_allocated(struct seq_file *m,
 					 struct binder_alloc *alloc);
@@ -19,6 +19,8 @@
 
 #include <linux/mm_types.h>
 #include <linux/err.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
 #include "binder_alloc.h"
 
 #define BUFFER_NUM 5
@@ -28,6 +30,12 @@ static bool binder_selftest_run = true;
 static int binder_selftest_failures;
 static DEFINE_MUTEX(binder_selftest_lock);
 
+/* Alloc/free rounds per size for the throughput benchmark, 0 skips it */
+static unsigned int binder_selftest_bench_rounds;
+
+module_param_named(bench_rounds, binder_selftest_bench_rounds,
+		   uint, S_IRUGO);
+
 /**
  * enum buf_end_align_type - Page alignment of a buffer
  * end with regard to the end of the previous buffer.
@@ -145,6 +153,7 @@ static void binder_selftest_free_buf(struct binder_alloc *alloc,
 
 	for (i = 0; i < BUFFER_NUM; i++)
 		binder_alloc_free_buf(alloc, buffers[seq[i]]);
+	binder_alloc_drain_classes(alloc);
 
 	for (i = 0; i < end / PAGE_SIZE; i++) {
 		/**
@@ -279,6 +288,50 @@ static void binder_selftest_alloc_offset(struct binder_alloc *alloc,
 	}
 }
 
+/**
+ * binder_selftest_bench() - Measure buffer alloc/free throughput.
+ * @alloc: Pointer to alloc struct.
+ *
+ * Allocate and free BUFFER_NUM buffers of each size bench_rounds times,
+ * the pattern of a service answering small transactions, and report
+ * the number of alloc/free pairs per second.
+ */
+static void binder_selftest_bench(struct binder_alloc *alloc)
+{
+	static const size_t sizes[] = { 64, 256, 1024, 2048, PAGE_SIZE * 2 };
+	struct binder_buffer *buffers[BUFFER_NUM];
+	unsigned int round;
+	u64 start, elapsed;
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		start = ktime_get_ns();
+		for (round = 0; round < binder_selftest_bench_rounds; round++) {
+			for (j = 0; j < BUFFER_NUM; j++) {
+				buffers[j] = binder_alloc_new_buf(alloc,
+								  sizes[i],
+								  0, 0, 0);
+				if (IS_ERR(buffers[j])) {
+					pr_err("bench: alloc of %zu failed\n",
+					       sizes[i]);
+					binder_selftest_failures++;
+					goto free;
+				}
+			}
+free:
+			while (j--)
+				binder_alloc_free_buf(alloc, buffers[j]);
+			if (binder_selftest_failures)
+				break;
+		}
+		elapsed = max_t(u64, ktime_get_ns() - start, 1);
+		pr_info("bench: size %zu: %llu ops/s\n", sizes[i],
+			div64_u64((u64)round * BUFFER_NUM * NSEC_PER_SEC,
+				  elapsed));
+	}
+	binder_alloc_drain_classes(alloc);
+}
+
 /**
  * binder_selftest_alloc() - Test alloc and free of buffer pages.
  * @alloc: Pointer to alloc struct.
@@ -299,6 +352,8 @@ void binder_selftest_alloc(struct binder_alloc *alloc)
 		goto done;
 	pr_info("STARTED\n");
 	binder_selftest_alloc_offset(alloc, end_offset, 0);
+	if (binder_selftest_bench_rounds && !binder_selftest_failures)
+		binder_selftest_bench(alloc);
 	binder_selftest_run = false;
 	if (binder_selftest_failures > 0)
 		pr_info("%d tests FAILED\n", binder_selftest_failures);
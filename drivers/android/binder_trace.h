@@ -156,6 +156,30 @@ TRACE_EVENT(binder_transaction,
 		  __entry->reply, __entry->flags, __entry->code)
 );
 
+TRACE_EVENT(binder_transaction_copy,
+	TP_PROTO(struct binder_transaction *t, size_t pinned, size_t copied,
+		 u64 total_pinned, u64 total_copied),
+	TP_ARGS(t, pinned, copied, total_pinned, total_copied),
+
+	TP_STRUCT__entry(
+		__field(int, debug_id)
+		__field(size_t, pinned)
+		__field(size_t, copied)
+		__field(u64, total_pinned)
+		__field(u64, total_copied)
+	),
+	TP_fast_assign(
+		__entry->debug_id = t->debug_id;
+		__entry->pinned = pinned;
+		__entry->copied = copied;
+		__entry->total_pinned = total_pinned;
+		__entry->total_copied = total_copied;
+	),
+	TP_printk("transaction=%d pinned=%zd copied=%zd total_pinned=%llu total_copied=%llu",
+		  __entry->debug_id, __entry->pinned, __entry->copied,
+		  __entry->total_pinned, __entry->total_copied)
+);
+
 TRACE_EVENT(binder_transaction_received,
 	TP_PROTO(struct binder_transaction *t),
 	TP_ARGS(t),
@@ -0,0 +1,259 @@
+/*
+ * Content-based deduplication of zram slots
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/highmem.h>
+#include <linux/xxhash.h>
+
+#include "zram_drv.h"
+
+/* One bucket per 2^ZRAM_HASH_SHIFT pages of disksize */
+#define ZRAM_HASH_SHIFT		10
+#define ZRAM_HASH_SIZE_MIN	(1 << 10)
+#define ZRAM_HASH_SIZE_MAX	(1U << 31)
+
+static u32 zram_dedup_checksum(unsigned char *mem)
+{
+	return xxh32(mem, PAGE_SIZE, 0);
+}
+
+static struct zram_hash *zram_dedup_hash(struct zram *zram, u32 checksum)
+{
+	return &zram->hash[checksum % zram->hash_size];
+}
+
+static void zram_dedup_insert(struct zram *zram, struct zram_entry *new)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram, new->checksum);
+	struct rb_node **rb_node, *parent = NULL;
+	struct zram_entry *entry;
+
+	spin_lock(&hash->lock);
+	rb_node = &hash->rb_root.rb_node;
+	while (*rb_node) {
+		parent = *rb_node;
+		entry = rb_entry(parent, struct zram_entry, rb_node);
+		if (new->checksum < entry->checksum)
+			rb_node = &parent->rb_left;
+		else
+			rb_node = &parent->rb_right;
+	}
+
+	rb_link_node(&new->rb_node, parent, rb_node);
+	rb_insert_color(&new->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+}
+
+/*
+ * Checksums may collide, so the stored object is decompressed and
+ * compared byte by byte before it is shared.
+ */
+static bool zram_dedup_match(struct zram *zram, struct zram_entry *entry,
+				unsigned char *mem)
+{
+	bool match = false;
+	unsigned char *cmem;
+	struct zcomp_strm *zstrm;
+
+	cmem = zs_map_object(zram->mem_pool, entry->handle, ZS_MM_RO);
+	if (entry->len == PAGE_SIZE) {
+		match = !memcmp(mem, cmem, PAGE_SIZE);
+	} else {
+		zstrm = zcomp_stream_get(zram->comp);
+		if (!zcomp_decompress(zstrm, cmem, entry->len, zstrm->buffer))
+			match = !memcmp(mem, zstrm->buffer, PAGE_SIZE);
+		zcomp_stream_put(zram->comp);
+	}
+	zs_unmap_object(zram->mem_pool, entry->handle);
+
+	return match;
+}
+
+/*
+ * Drop a reference to @entry. The compressed object is released along
+ * with the last reference; returns true in that case.
+ */
+bool zram_dedup_put(struct zram *zram, struct zram_entry *entry)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram, entry->checksum);
+
+	spin_lock(&hash->lock);
+	entry->refcount--;
+	if (entry->refcount) {
+		spin_unlock(&hash->lock);
+		return false;
+	}
+
+	rb_erase(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	zs_free(zram->mem_pool, entry->handle);
+	kfree(entry);
+	atomic64_sub(sizeof(*entry), &zram->stats.meta_data_size);
+
+	return true;
+}
+
+/*
+ * Walk every entry sharing @entry's checksum. Called with hash->lock
+ * held; the lock is released on return. Each candidate is pinned with a
+ * reference while it is compared so it can't be freed under us.
+ */
+static struct zram_entry *__zram_dedup_get(struct zram *zram,
+				struct zram_hash *hash, unsigned char *mem,
+				struct zram_entry *entry)
+{
+	struct zram_entry *tmp, *prev = NULL;
+	struct rb_node *rb_node;
+
+	/* find left-most entry with same checksum */
+	while ((rb_node = rb_prev(&entry->rb_node))) {
+		tmp = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (tmp->checksum != entry->checksum)
+			break;
+		entry = tmp;
+	}
+
+again:
+	entry->refcount++;
+	spin_unlock(&hash->lock);
+
+	if (prev)
+		zram_dedup_put(zram, prev);
+
+	if (zram_dedup_match(zram, entry, mem))
+		return entry;
+
+	spin_lock(&hash->lock);
+	tmp = NULL;
+	rb_node = rb_next(&entry->rb_node);
+	if (rb_node)
+		tmp = rb_entry(rb_node, struct zram_entry, rb_node);
+
+	if (tmp && tmp->checksum == entry->checksum) {
+		prev = entry;
+		entry = tmp;
+		goto again;
+	}
+
+	spin_unlock(&hash->lock);
+	zram_dedup_put(zram, entry);
+
+	return NULL;
+}
+
+static struct zram_entry *zram_dedup_get(struct zram *zram,
+				unsigned char *mem, u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram, checksum);
+	struct zram_entry *entry;
+	struct rb_node *rb_node;
+
+	spin_lock(&hash->lock);
+	rb_node = hash->rb_root.rb_node;
+	while (rb_node) {
+		entry = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (checksum == entry->checksum)
+			return __zram_dedup_get(zram, hash, mem, entry);
+
+		if (checksum < entry->checksum)
+			rb_node = rb_node->rb_left;
+		else
+			rb_node = rb_node->rb_right;
+	}
+	spin_unlock(&hash->lock);
+
+	return NULL;
+}
+
+/*
+ * Look up an already stored object with the same content as @page.
+ * On a hit a reference is taken on the returned entry. The page
+ * checksum is returned through @checksum so that a miss can be
+ * inserted by zram_dedup_add() without hashing the page again.
+ */
+struct zram_entry *zram_dedup_find(struct zram *zram, struct page *page,
+				u32 *checksum)
+{
+	void *mem;
+	struct zram_entry *entry;
+
+	mem = kmap_atomic(page);
+	*checksum = zram_dedup_checksum(mem);
+	entry = zram_dedup_get(zram, mem, *checksum);
+	kunmap_atomic(mem);
+
+	if (entry)
+		atomic64_inc(&zram->stats.dedup_hits);
+	else
+		atomic64_inc(&zram->stats.dedup_misses);
+
+	return entry;
+}
+
+/*
+ * Wrap a freshly stored zsmalloc object in an entry and publish it in
+ * the index. Returns NULL if the entry could not be allocated, in which
+ * case the caller still owns @handle.
+ */
+struct zram_entry *zram_dedup_add(struct zram *zram, unsigned long handle,
+				unsigned int len, u32 checksum)
+{
+	struct zram_entry *entry;
+
+	entry = kzalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	entry->handle = handle;
+	entry->len = len;
+	entry->checksum = checksum;
+	entry->refcount = 1;
+	RB_CLEAR_NODE(&entry->rb_node);
+	atomic64_add(sizeof(*entry), &zram->stats.meta_data_size);
+
+	zram_dedup_insert(zram, entry);
+
+	return entry;
+}
+
+int zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	int i;
+
+	if (!zram->use_dedup)
+		return 0;
+
+	zram->hash_size = num_pages >> ZRAM_HASH_SHIFT;
+	zram->hash_size = min_t(size_t, ZRAM_HASH_SIZE_MAX, zram->hash_size);
+	zram->hash_size = max_t(size_t, ZRAM_HASH_SIZE_MIN, zram->hash_size);
+	zram->hash = vzalloc(zram->hash_size * sizeof(struct zram_hash));
+	if (!zram->hash) {
+		pr_err("Error allocating zram entry hash\n");
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < zram->hash_size; i++) {
+		spin_lock_init(&zram->hash[i].lock);
+		zram->hash[i].rb_root = RB_ROOT;
+	}
+
+	return 0;
+}
+
+void zram_dedup_fini(struct zram *zram)
+{
+	vfree(zram->hash);
+	zram->hash = NULL;
+	zram->hash_size = 0;
+}
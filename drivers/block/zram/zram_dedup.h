@@ -0,0 +1,68 @@
+/*
+ * Content-based deduplication of zram slots
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+struct zram;
+
+/*
+ * A compressed object shared by every slot storing identical content.
+ * With dedup enabled, table[index].handle points to one of these
+ * rather than directly to the zsmalloc object.
+ */
+struct zram_entry {
+	struct rb_node rb_node;
+	u32 len;
+	u32 checksum;
+	unsigned long refcount;
+	unsigned long handle;
+};
+
+/* Checksum-keyed bucket of zram_entry objects */
+struct zram_hash {
+	spinlock_t lock;
+	struct rb_root rb_root;
+};
+
+#ifdef CONFIG_ZRAM_DEDUP
+struct zram_entry *zram_dedup_find(struct zram *zram, struct page *page,
+				u32 *checksum);
+struct zram_entry *zram_dedup_add(struct zram *zram, unsigned long handle,
+				unsigned int len, u32 checksum);
+bool zram_dedup_put(struct zram *zram, struct zram_entry *entry);
+
+int zram_dedup_init(struct zram *zram, size_t num_pages);
+void zram_dedup_fini(struct zram *zram);
+#else
+static inline struct zram_entry *zram_dedup_find(struct zram *zram,
+				struct page *page, u32 *checksum)
+{
+	return NULL;
+}
+static inline struct zram_entry *zram_dedup_add(struct zram *zram,
+				unsigned long handle, unsigned int len,
+				u32 checksum)
+{
+	return NULL;
+}
+static inline bool zram_dedup_put(struct zram *zram,
+				struct zram_entry *entry)
+{
+	return false;
+}
+
+static inline int zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	return 0;
+}
+static inline void zram_dedup_fini(struct zram *zram) { }
+#endif
+
+#endif /* _ZRAM_DEDUP_H_ */
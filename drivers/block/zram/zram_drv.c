@@ -32,6 +32,8 @@
 #include <linux/idr.h>
 #include <linux/sysfs.h>
 #include <linux/debugfs.h>
+#include <linux/workqueue.h>
+#include <linux/cpumask.h>
 
 #include "zram_drv.h"
 
@@ -49,8 +51,23 @@ static unsigned int num_devices = 1;
  * uncompressed in memory.
  */
 static size_t huge_class_size;
+/*
+ * Write bios of at least this many pages are split into chunks that
+ * are compressed in parallel on several CPUs. 0 disables splitting.
+ *
+ * Only bios take this path: swap-out goes through zram_rw_page() one
+ * page at a time and is not affected. Multi-page write bios come from
+ * a filesystem or direct I/O on the device.
+ */
+static unsigned int parallel_write_pages = 32;
+/* Smallest chunk of a split bio handed to a single CPU */
+#define ZRAM_PARALLEL_CHUNK_PAGES	8
+
+static struct workqueue_struct *zram_wq;
 
 static void zram_free_page(struct zram *zram, size_t index);
+static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
+				u32 index, int offset, struct bio *bio);
 
 static void zram_slot_lock(struct zram *zram, u32 index)
 {
@@ -89,6 +106,18 @@ static void zram_set_handle(struct zram *zram, u32 index, unsigned long handle)
 	zram->table[index].handle = handle;
 }
 
+/*
+ * With dedup enabled the slot handle refers to a shared zram_entry
+ * rather than to the zsmalloc object itself.
+ */
+static unsigned long zram_zs_handle(struct zram *zram, unsigned long handle)
+{
+	if (zram_dedup_enabled(zram))
+		return ((struct zram_entry *)handle)->handle;
+
+	return handle;
+}
+
 /* flag operations require table entry bit_spin_lock() being held */
 static bool zram_test_flag(struct zram *zram, u32 index,
 			enum zram_pageflags flag)
@@ -284,6 +313,55 @@ static ssize_t mem_used_max_store(struct device *dev,
 	return len;
 }
 
+/* Caller must hold init_lock and the device must be initialized */
+static void zram_mark_idle(struct zram *zram)
+{
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index;
+
+	for (index = 0; index < nr_pages; index++) {
+		/*
+		 * Do not mark ZRAM_UNDER_WB slot as ZRAM_IDLE to close race.
+		 * See the comment in writeback_store.
+		 */
+		zram_slot_lock(zram, index);
+		if (zram_allocated(zram, index) &&
+				!zram_test_flag(zram, index, ZRAM_UNDER_WB))
+			zram_set_flag(zram, index, ZRAM_IDLE);
+		zram_slot_unlock(zram, index);
+	}
+}
+
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char mode_buf[8];
+	ssize_t sz;
+
+	sz = strscpy(mode_buf, buf, sizeof(mode_buf));
+	if (sz <= 0)
+		return -EINVAL;
+
+	/* ignore trailing new line */
+	if (mode_buf[sz - 1] == '\n')
+		mode_buf[sz - 1] = 0x00;
+
+	if (strcmp(mode_buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	zram_mark_idle(zram);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
 #ifdef CONFIG_ZRAM_WRITEBACK
 static bool zram_wb_enabled(struct zram *zram)
 {
@@ -458,6 +536,7 @@ static unsigned long get_entry_bdev(struct zram *zram)
 
 	set_bit(entry, zram->bitmap);
 	spin_unlock(&zram->bitmap_lock);
+	atomic64_inc(&zram->stats.bd_count);
 
 	return entry;
 }
@@ -470,6 +549,7 @@ static void put_entry_bdev(struct zram *zram, unsigned long entry)
 	was_set = test_and_clear_bit(entry, zram->bitmap);
 	spin_unlock(&zram->bitmap_lock);
 	WARN_ON_ONCE(!was_set);
+	atomic64_dec(&zram->stats.bd_count);
 }
 
 static void zram_page_end_io(struct bio *bio)
@@ -563,50 +643,166 @@ static int read_from_bdev_sync(struct zram *zram, struct bio_vec *bvec,
 static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
 			unsigned long entry, struct bio *parent, bool sync)
 {
+	atomic64_inc(&zram->stats.bd_reads);
 	if (sync)
 		return read_from_bdev_sync(zram, bvec, entry, parent);
 	else
 		return read_from_bdev_async(zram, bvec, entry, parent);
 }
 
-static int write_to_bdev(struct zram *zram, struct bio_vec *bvec,
-					u32 index, struct bio *parent,
-					unsigned long *pentry)
+#define HUGE_WRITEBACK 0x1
+#define IDLE_WRITEBACK 0x2
+
+/*
+ * Write idle and/or incompressible slots out to the backing device in one
+ * sweep over the table so the zsmalloc memory they pin can be released.
+ * Slots are written synchronously one page at a time and are only moved
+ * to ZRAM_WB once the write has completed and the slot is still intact.
+ */
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
 {
-	struct bio *bio;
-	unsigned long entry;
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index;
+	struct bio bio;
+	struct bio_vec bio_vec;
+	struct page *page;
+	ssize_t ret, sz;
+	char mode_buf[8];
+	unsigned long mode = -1UL;
+	unsigned long entry = 0;
 
-	bio = bio_alloc(GFP_ATOMIC, 1);
-	if (!bio)
-		return -ENOMEM;
+	sz = strscpy(mode_buf, buf, sizeof(mode_buf));
+	if (sz <= 0)
+		return -EINVAL;
 
-	entry = get_entry_bdev(zram);
-	if (!entry) {
-		bio_put(bio);
-		return -ENOSPC;
+	/* ignore trailing newline */
+	if (mode_buf[sz - 1] == '\n')
+		mode_buf[sz - 1] = 0x00;
+
+	if (!strcmp(mode_buf, "idle"))
+		mode = IDLE_WRITEBACK;
+	else if (!strcmp(mode_buf, "huge"))
+		mode = HUGE_WRITEBACK;
+
+	if (mode == -1UL)
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto release_init_lock;
 	}
 
-	bio->bi_iter.bi_sector = entry * (PAGE_SIZE >> 9);
-	bio->bi_bdev = zram->bdev;
-	if (!bio_add_page(bio, bvec->bv_page, bvec->bv_len,
-					bvec->bv_offset)) {
-		bio_put(bio);
-		put_entry_bdev(zram, entry);
-		return -EIO;
+	if (!zram_wb_enabled(zram)) {
+		ret = -ENODEV;
+		goto release_init_lock;
 	}
 
-	if (!parent) {
-		bio->bi_rw = REQ_WRITE | REQ_SYNC;
-		bio->bi_end_io = zram_page_end_io;
-	} else {
-		bio->bi_rw = parent->bi_rw;
-		bio_chain(bio, parent);
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto release_init_lock;
 	}
 
-	submit_bio(WRITE, bio);
-	*pentry = entry;
+	ret = len;
+	for (index = 0; index < nr_pages; index++) {
+		struct bio_vec bvec;
 
-	return 0;
+		bvec.bv_page = page;
+		bvec.bv_len = PAGE_SIZE;
+		bvec.bv_offset = 0;
+
+		if (!entry) {
+			entry = get_entry_bdev(zram);
+			if (!entry) {
+				ret = -ENOSPC;
+				break;
+			}
+		}
+
+		zram_slot_lock(zram, index);
+		if (!zram_allocated(zram, index))
+			goto next;
+
+		if (zram_test_flag(zram, index, ZRAM_WB) ||
+				zram_test_flag(zram, index, ZRAM_SAME) ||
+				zram_test_flag(zram, index, ZRAM_UNDER_WB))
+			goto next;
+
+		if ((mode & IDLE_WRITEBACK &&
+			  !zram_test_flag(zram, index, ZRAM_IDLE)) ||
+		    (mode & HUGE_WRITEBACK &&
+			  !zram_test_flag(zram, index, ZRAM_HUGE)))
+			goto next;
+		/*
+		 * Clearing ZRAM_UNDER_WB is duty of caller.
+		 * IOW, zram_free_page never clear it.
+		 */
+		zram_set_flag(zram, index, ZRAM_UNDER_WB);
+		/* Need for hugepage writeback racing */
+		zram_set_flag(zram, index, ZRAM_IDLE);
+		zram_slot_unlock(zram, index);
+		if (zram_bvec_read(zram, &bvec, index, 0, NULL)) {
+			zram_slot_lock(zram, index);
+			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+			zram_clear_flag(zram, index, ZRAM_IDLE);
+			zram_slot_unlock(zram, index);
+			continue;
+		}
+
+		bio_init(&bio);
+		bio.bi_io_vec = &bio_vec;
+		bio.bi_max_vecs = 1;
+		bio.bi_bdev = zram->bdev;
+		bio.bi_iter.bi_sector = entry * (PAGE_SIZE >> 9);
+		bio_add_page(&bio, bvec.bv_page, bvec.bv_len,
+				bvec.bv_offset);
+
+		if (submit_bio_wait(WRITE | REQ_SYNC, &bio)) {
+			zram_slot_lock(zram, index);
+			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+			zram_clear_flag(zram, index, ZRAM_IDLE);
+			zram_slot_unlock(zram, index);
+			continue;
+		}
+
+		atomic64_inc(&zram->stats.bd_writes);
+		/*
+		 * We released zram_slot_lock so need to check if the slot was
+		 * changed. If there is freeing for the slot, we can catch it
+		 * easily by zram_allocated.
+		 * A subtle case is the slot is freed/reallocated/marked as
+		 * ZRAM_IDLE again. To close the race, idle_store doesn't
+		 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
+		 * Thus, we could close the race by checking ZRAM_IDLE bit.
+		 */
+		zram_slot_lock(zram, index);
+		if (!zram_allocated(zram, index) ||
+			  !zram_test_flag(zram, index, ZRAM_IDLE)) {
+			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+			zram_clear_flag(zram, index, ZRAM_IDLE);
+			goto next;
+		}
+
+		zram_free_page(zram, index);
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_set_flag(zram, index, ZRAM_WB);
+		zram_set_element(zram, index, entry);
+		entry = 0;
+		atomic64_inc(&zram->stats.pages_stored);
+next:
+		zram_slot_unlock(zram, index);
+	}
+
+	if (entry)
+		put_entry_bdev(zram, entry);
+	__free_page(page);
+release_init_lock:
+	up_read(&zram->init_lock);
+
+	return ret;
 }
 
 static void zram_wb_clear(struct zram *zram, u32 index)
@@ -622,14 +818,6 @@ static void zram_wb_clear(struct zram *zram, u32 index)
 #else
 static bool zram_wb_enabled(struct zram *zram) { return false; }
 static inline void reset_bdev(struct zram *zram) {};
-static int write_to_bdev(struct zram *zram, struct bio_vec *bvec,
-					u32 index, struct bio *parent,
-					unsigned long *pentry)
-
-{
-	return -EIO;
-}
-
 static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
 			unsigned long entry, struct bio *parent, bool sync)
 {
@@ -654,6 +842,9 @@ static void zram_debugfs_destroy(void)
 
 static void zram_accessed(struct zram *zram, u32 index)
 {
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	if (zram->recomp_idle)
+		clear_bit(index, zram->recomp_idle);
 	zram->table[index].ac_time = ktime_get_boottime();
 }
 
@@ -699,12 +890,13 @@ static ssize_t read_block_state(struct file *file, char __user *buf,
 
 		ts = ktime_to_timespec64(zram->table[index].ac_time);
 		copied = snprintf(kbuf + written, count,
-			"%12zd %12lld.%06lu %c%c%c\n",
+			"%12zd %12lld.%06lu %c%c%c%c\n",
 			index, (s64)ts.tv_sec,
 			ts.tv_nsec / NSEC_PER_USEC,
 			zram_test_flag(zram, index, ZRAM_SAME) ? 's' : '.',
 			zram_test_flag(zram, index, ZRAM_WB) ? 'w' : '.',
-			zram_test_flag(zram, index, ZRAM_HUGE) ? 'h' : '.');
+			zram_test_flag(zram, index, ZRAM_HUGE) ? 'h' : '.',
+			zram_test_flag(zram, index, ZRAM_IDLE) ? 'i' : '.');
 
 		if (count < copied) {
 			zram_slot_unlock(zram, index);
@@ -749,7 +941,12 @@ static void zram_debugfs_unregister(struct zram *zram)
 #else
 static void zram_debugfs_create(void) {};
 static void zram_debugfs_destroy(void) {};
-static void zram_accessed(struct zram *zram, u32 index) {};
+static void zram_accessed(struct zram *zram, u32 index)
+{
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	if (zram->recomp_idle)
+		clear_bit(index, zram->recomp_idle);
+};
 static void zram_reset_access(struct zram *zram, u32 index) {};
 static void zram_debugfs_register(struct zram *zram) {};
 static void zram_debugfs_unregister(struct zram *zram) {};
@@ -817,6 +1014,94 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->recompressor, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[ARRAY_SIZE(zram->recompressor)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
+
+	if (!zcomp_available_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+
+	/* recompression replaces objects in place, dedup shares them */
+	if (zram_dedup_enabled(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Recompression is not supported with dedup\n");
+		return -EINVAL;
+	}
+
+	strcpy(zram->recompressor, compressor);
+	up_write(&zram->init_lock);
+	return len;
+}
+
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (kstrtoint(buf, 10, &val) || (val != 0 && val != 1))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	if (val && zram->recompressor[0]) {
+		up_write(&zram->init_lock);
+		pr_info("Dedup is not supported with recompression\n");
+		return -EINVAL;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+	return len;
+}
+#endif
+
 static ssize_t compact_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
@@ -873,7 +1158,7 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu %8llu %8llu %8llu %8llu\n",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
@@ -881,7 +1166,12 @@ static ssize_t mm_stat_show(struct device *dev,
 			max_used << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.same_pages),
 			pool_stats.pages_compacted,
-			(u64)atomic64_read(&zram->stats.huge_pages));
+			(u64)atomic64_read(&zram->stats.huge_pages),
+			(u64)atomic64_read(&zram->stats.dup_data_size),
+			(u64)atomic64_read(&zram->stats.meta_data_size),
+			(u64)atomic64_read(&zram->stats.dedup_hits),
+			(u64)atomic64_read(&zram->stats.dedup_misses),
+			(u64)atomic64_read(&zram->stats.recomp_pages));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -904,8 +1194,31 @@ static ssize_t debug_stat_show(struct device *dev,
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+#define FOUR_K(x) ((x) * (1 << (PAGE_SHIFT - 12)))
+static ssize_t bd_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+		"%8llu %8llu %8llu\n",
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_count)),
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_reads)),
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_writes)));
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#endif
+
 static DEVICE_ATTR_RO(io_stat);
 static DEVICE_ATTR_RO(mm_stat);
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR_RO(bd_stat);
+#endif
 static DEVICE_ATTR_RO(debug_stat);
 
 static void zram_meta_free(struct zram *zram, u64 disksize)
@@ -917,6 +1230,7 @@ static void zram_meta_free(struct zram *zram, u64 disksize)
 	for (index = 0; index < num_pages; index++)
 		zram_free_page(zram, index);
 
+	zram_dedup_fini(zram);
 	zs_destroy_pool(zram->mem_pool);
 	vfree(zram->table);
 }
@@ -936,6 +1250,12 @@ static bool zram_meta_alloc(struct zram *zram, u64 disksize)
 		return false;
 	}
 
+	if (zram_dedup_init(zram, num_pages)) {
+		zs_destroy_pool(zram->mem_pool);
+		vfree(zram->table);
+		return false;
+	}
+
 	if (!huge_class_size)
 		huge_class_size = zs_huge_class_size(zram->mem_pool);
 	return true;
@@ -952,6 +1272,17 @@ static void zram_free_page(struct zram *zram, size_t index)
 
 	zram_reset_access(zram, index);
 
+	if (zram_test_flag(zram, index, ZRAM_IDLE))
+		zram_clear_flag(zram, index, ZRAM_IDLE);
+	if (zram->recomp_idle)
+		clear_bit(index, zram->recomp_idle);
+
+	zram_clear_flag(zram, index, ZRAM_INCOMPRESSIBLE);
+	if (zram_test_flag(zram, index, ZRAM_RECOMP)) {
+		zram_clear_flag(zram, index, ZRAM_RECOMP);
+		atomic64_dec(&zram->stats.recomp_pages);
+	}
+
 	if (zram_test_flag(zram, index, ZRAM_HUGE)) {
 		zram_clear_flag(zram, index, ZRAM_HUGE);
 		atomic64_dec(&zram->stats.huge_pages);
@@ -979,10 +1310,22 @@ static void zram_free_page(struct zram *zram, size_t index)
 	if (!handle)
 		return;
 
-	zs_free(zram->mem_pool, handle);
-
-	atomic64_sub(zram_get_obj_size(zram, index),
-			&zram->stats.compr_data_size);
+	/*
+	 * A deduplicated object is charged to compr_data_size once and to
+	 * dup_data_size for every other slot sharing it.
+	 */
+	if (zram_dedup_enabled(zram)) {
+		if (zram_dedup_put(zram, (struct zram_entry *)handle))
+			atomic64_sub(zram_get_obj_size(zram, index),
+					&zram->stats.compr_data_size);
+		else
+			atomic64_sub(zram_get_obj_size(zram, index),
+					&zram->stats.dup_data_size);
+	} else {
+		zs_free(zram->mem_pool, handle);
+		atomic64_sub(zram_get_obj_size(zram, index),
+				&zram->stats.compr_data_size);
+	}
 	atomic64_dec(&zram->stats.pages_stored);
 
 	zram_set_handle(zram, index, 0);
@@ -1001,14 +1344,14 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		zram_slot_lock(zram, index);
 		if (zram_test_flag(zram, index, ZRAM_WB)) {
 			struct bio_vec bvec;
+			unsigned long entry = zram_get_element(zram, index);
 
 			zram_slot_unlock(zram, index);
 
 			bvec.bv_page = page;
 			bvec.bv_len = PAGE_SIZE;
 			bvec.bv_offset = 0;
-			return read_from_bdev(zram, &bvec,
-					zram_get_element(zram, index),
+			return read_from_bdev(zram, &bvec, entry,
 					bio, partial_io);
 		}
 		zram_slot_unlock(zram, index);
@@ -1029,6 +1372,7 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 	}
 
 	size = zram_get_obj_size(zram, index);
+	handle = zram_zs_handle(zram, handle);
 
 	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
 	if (size == PAGE_SIZE) {
@@ -1037,12 +1381,17 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		kunmap_atomic(dst);
 		ret = 0;
 	} else {
-		struct zcomp_strm *zstrm = zcomp_stream_get(zram->comp);
+		struct zcomp *comp = zram->comp;
+		struct zcomp_strm *zstrm;
+
+		if (zram_test_flag(zram, index, ZRAM_RECOMP))
+			comp = zram->recomp;
 
+		zstrm = zcomp_stream_get(comp);
 		dst = kmap_atomic(page);
 		ret = zcomp_decompress(zstrm, src, size, dst);
 		kunmap_atomic(dst);
-		zcomp_stream_put(zram->comp);
+		zcomp_stream_put(comp);
 	}
 	zs_unmap_object(zram->mem_pool, handle);
 	zram_slot_unlock(zram, index);
@@ -1099,7 +1448,8 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 	struct page *page = bvec->bv_page;
 	unsigned long element = 0;
 	enum zram_pageflags flags = 0;
-	bool allow_wb = true;
+	struct zram_entry *entry;
+	u32 checksum = 0;
 
 	mem = kmap_atomic(page);
 	if (page_same_filled(mem, &element)) {
@@ -1111,6 +1461,16 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 	}
 	kunmap_atomic(mem);
 
+	if (zram_dedup_enabled(zram)) {
+		entry = zram_dedup_find(zram, page, &checksum);
+		if (entry) {
+			comp_len = entry->len;
+			handle = (unsigned long)entry;
+			atomic64_add(comp_len, &zram->stats.dup_data_size);
+			goto out;
+		}
+	}
+
 compress_again:
 	zstrm = zcomp_stream_get(zram->comp);
 	src = kmap_atomic(page);
@@ -1124,20 +1484,8 @@ compress_again:
 		return ret;
 	}
 
-	if (unlikely(comp_len >= huge_class_size)) {
+	if (unlikely(comp_len >= huge_class_size))
 		comp_len = PAGE_SIZE;
-		if (zram_wb_enabled(zram) && allow_wb) {
-			zcomp_stream_put(zram->comp);
-			ret = write_to_bdev(zram, bvec, index, bio, &element);
-			if (!ret) {
-				flags = ZRAM_WB;
-				ret = 1;
-				goto out;
-			}
-			allow_wb = false;
-			goto compress_again;
-		}
-	}
 
 	/*
 	 * handle allocation has 2 paths:
@@ -1189,6 +1537,15 @@ compress_again:
 
 	zcomp_stream_put(zram->comp);
 	zs_unmap_object(zram->mem_pool, handle);
+
+	if (zram_dedup_enabled(zram)) {
+		entry = zram_dedup_add(zram, handle, comp_len, checksum);
+		if (!entry) {
+			zs_free(zram->mem_pool, handle);
+			return -ENOMEM;
+		}
+		handle = (unsigned long)entry;
+	}
 	atomic64_add(comp_len, &zram->stats.compr_data_size);
 out:
 	/*
@@ -1258,6 +1615,243 @@ out:
 	return ret;
 }
 
+#define RECOMP_IDLE	0x1
+#define RECOMP_HUGE	0x2
+#define RECOMP_AGED	0x4	/* untouched for a whole recomp_interval */
+
+/*
+ * Recompress one slot with the secondary algorithm. Called with the slot
+ * lock held, which is why only non-blocking allocations are used.
+ * @page is scratch space for the decompressed data.
+ */
+static int zram_recompress(struct zram *zram, u32 index, struct page *page)
+{
+	unsigned long handle, new_handle;
+	unsigned int size, comp_len;
+	struct zcomp_strm *zstrm;
+	void *src, *dst;
+	int ret;
+
+	handle = zram_get_handle(zram, index);
+	size = zram_get_obj_size(zram, index);
+
+	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
+	dst = kmap_atomic(page);
+	if (size == PAGE_SIZE) {
+		memcpy(dst, src, PAGE_SIZE);
+		ret = 0;
+	} else {
+		zstrm = zcomp_stream_get(zram->comp);
+		ret = zcomp_decompress(zstrm, src, size, dst);
+		zcomp_stream_put(zram->comp);
+	}
+	kunmap_atomic(dst);
+	zs_unmap_object(zram->mem_pool, handle);
+	if (ret)
+		return ret;
+
+	zstrm = zcomp_stream_get(zram->recomp);
+	src = kmap_atomic(page);
+	ret = zcomp_compress(zstrm, src, &comp_len);
+	kunmap_atomic(src);
+
+	/* Not worth it, don't try this slot again until it's rewritten */
+	if (ret || comp_len >= size || comp_len >= huge_class_size) {
+		zcomp_stream_put(zram->recomp);
+		zram_set_flag(zram, index, ZRAM_INCOMPRESSIBLE);
+		return ret;
+	}
+
+	new_handle = zs_malloc(zram->mem_pool, comp_len,
+				__GFP_KSWAPD_RECLAIM |
+				__GFP_NOWARN |
+				__GFP_HIGHMEM |
+				__GFP_MOVABLE);
+	if (!new_handle) {
+		zcomp_stream_put(zram->recomp);
+		return -ENOMEM;
+	}
+
+	dst = zs_map_object(zram->mem_pool, new_handle, ZS_MM_WO);
+	memcpy(dst, zstrm->buffer, comp_len);
+	zcomp_stream_put(zram->recomp);
+	zs_unmap_object(zram->mem_pool, new_handle);
+
+	zs_free(zram->mem_pool, handle);
+	atomic64_sub(size - comp_len, &zram->stats.compr_data_size);
+
+	if (zram_test_flag(zram, index, ZRAM_HUGE)) {
+		zram_clear_flag(zram, index, ZRAM_HUGE);
+		atomic64_dec(&zram->stats.huge_pages);
+	}
+
+	zram_set_handle(zram, index, new_handle);
+	zram_set_obj_size(zram, index, comp_len);
+	zram_set_flag(zram, index, ZRAM_RECOMP);
+	atomic64_inc(&zram->stats.recomp_pages);
+
+	return 0;
+}
+
+/*
+ * Recompress every slot matching any of @mode or whose object is at
+ * least @threshold bytes (0 means no size criterion). Caller must hold
+ * init_lock and have checked that a secondary algorithm is set up.
+ */
+static int zram_recompress_slots(struct zram *zram, unsigned long mode,
+				unsigned int threshold)
+{
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index;
+	struct page *page;
+	int ret = 0;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+
+	for (index = 0; index < nr_pages; index++) {
+		zram_slot_lock(zram, index);
+		if (!zram_get_handle(zram, index))
+			goto next;
+
+		if (zram_test_flag(zram, index, ZRAM_WB) ||
+				zram_test_flag(zram, index, ZRAM_SAME) ||
+				zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
+				zram_test_flag(zram, index, ZRAM_RECOMP) ||
+				zram_test_flag(zram, index, ZRAM_INCOMPRESSIBLE))
+			goto next;
+
+		if (!(mode & RECOMP_IDLE &&
+				zram_test_flag(zram, index, ZRAM_IDLE)) &&
+		    !(mode & RECOMP_AGED &&
+				test_bit(index, zram->recomp_idle)) &&
+		    !(mode & RECOMP_HUGE &&
+				zram_test_flag(zram, index, ZRAM_HUGE)) &&
+		    !(threshold &&
+				zram_get_obj_size(zram, index) >= threshold))
+			goto next;
+
+		ret = zram_recompress(zram, index, page);
+next:
+		zram_slot_unlock(zram, index);
+		if (ret == -ENOMEM)
+			break;
+		ret = 0;
+		cond_resched();
+	}
+
+	__free_page(page);
+
+	return ret;
+}
+
+static ssize_t recompress_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int threshold = 0;
+	unsigned long mode = 0;
+	char mode_buf[32];
+	ssize_t sz;
+	int ret;
+
+	sz = strscpy(mode_buf, buf, sizeof(mode_buf));
+	if (sz <= 0)
+		return -EINVAL;
+
+	/* ignore trailing newline */
+	if (mode_buf[sz - 1] == '\n')
+		mode_buf[sz - 1] = 0x00;
+
+	if (!strcmp(mode_buf, "idle"))
+		mode = RECOMP_IDLE;
+	else if (!strcmp(mode_buf, "huge"))
+		mode = RECOMP_HUGE;
+	else if (!strncmp(mode_buf, "threshold=", 10)) {
+		if (kstrtouint(mode_buf + 10, 10, &threshold) || !threshold ||
+				threshold > PAGE_SIZE)
+			return -EINVAL;
+	} else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram->recomp) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	ret = zram_recompress_slots(zram, mode, threshold);
+	up_read(&zram->init_lock);
+
+	return ret ? ret : len;
+}
+
+/* Caller must hold init_lock and have set up recompression */
+static void zram_mark_recomp_idle(struct zram *zram)
+{
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index;
+
+	for (index = 0; index < nr_pages; index++) {
+		zram_slot_lock(zram, index);
+		if (zram_allocated(zram, index))
+			set_bit(index, zram->recomp_idle);
+		zram_slot_unlock(zram, index);
+	}
+}
+
+/*
+ * Periodic pass: recompress what stayed untouched for a whole interval
+ * along with incompressible slots, then start the next interval. The
+ * ZRAM_IDLE marks set through idle_store are left alone.
+ */
+static void zram_recomp_work(struct work_struct *work)
+{
+	struct zram *zram = container_of(to_delayed_work(work),
+					struct zram, recomp_work);
+	unsigned int interval;
+
+	down_read(&zram->init_lock);
+	if (init_done(zram) && zram->recomp) {
+		zram_recompress_slots(zram, RECOMP_AGED | RECOMP_HUGE, 0);
+		zram_mark_recomp_idle(zram);
+	}
+	interval = zram->recomp_interval;
+	up_read(&zram->init_lock);
+
+	if (interval)
+		queue_delayed_work(system_unbound_wq, &zram->recomp_work,
+				interval * HZ);
+}
+
+static ssize_t recomp_interval_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", zram->recomp_interval);
+}
+
+static ssize_t recomp_interval_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int interval;
+
+	if (kstrtouint(buf, 10, &interval))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	zram->recomp_interval = interval;
+	if (init_done(zram) && zram->recomp && interval)
+		mod_delayed_work(system_unbound_wq, &zram->recomp_work,
+				interval * HZ);
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
 /*
  * zram_bio_discard - handler on discard request
  * @index: physical block index in PAGE_SIZE units
@@ -1335,6 +1929,125 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 	return ret;
 }
 
+struct zram_bio_chunk {
+	struct work_struct work;
+	struct zram *zram;
+	struct bio *bio;
+	/* covers just the pages of this chunk */
+	struct bvec_iter iter;
+	u32 index;
+	int ret;
+};
+
+static void zram_write_chunk(struct zram_bio_chunk *chunk)
+{
+	struct bio_vec bvec;
+	struct bvec_iter iter;
+	u32 index = chunk->index;
+
+	__bio_for_each_segment(bvec, chunk->bio, iter, chunk->iter) {
+		if (zram_bvec_rw(chunk->zram, &bvec, index, 0,
+					WRITE, chunk->bio) < 0) {
+			chunk->ret = -EIO;
+			return;
+		}
+		index++;
+	}
+}
+
+static void zram_write_work(struct work_struct *work)
+{
+	struct zram_bio_chunk *chunk = container_of(work,
+					struct zram_bio_chunk, work);
+
+	zram_write_chunk(chunk);
+}
+
+static bool zram_can_write_parallel(struct bio *bio, int offset)
+{
+	struct bio_vec bvec;
+	struct bvec_iter iter;
+
+	if (!parallel_write_pages || offset || num_online_cpus() < 2)
+		return false;
+
+	if (bio->bi_iter.bi_size < (parallel_write_pages << PAGE_SHIFT))
+		return false;
+
+	bio_for_each_segment(bvec, bio, iter) {
+		if (bvec.bv_offset || bvec.bv_len != PAGE_SIZE)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Spread a large, page aligned write bio over the online CPUs so that
+ * several per-cpu zcomp streams compress it at the same time. The
+ * submitting CPU handles the first chunk itself and then waits for the
+ * rest. Returns false, leaving the bio untouched, if the bio isn't worth
+ * splitting or the chunk array can't be allocated.
+ */
+static bool zram_write_parallel(struct zram *zram, struct bio *bio, u32 index)
+{
+	unsigned int nr_pages = bio->bi_iter.bi_size >> PAGE_SHIFT;
+	unsigned int nr_chunks, chunk_pages, i;
+	struct zram_bio_chunk *chunks;
+	struct bvec_iter iter = bio->bi_iter;
+	int cpu, ret = 0;
+
+	nr_chunks = min_t(unsigned int, num_online_cpus(),
+			nr_pages / ZRAM_PARALLEL_CHUNK_PAGES);
+	if (nr_chunks < 2)
+		return false;
+
+	chunk_pages = DIV_ROUND_UP(nr_pages, nr_chunks);
+	nr_chunks = DIV_ROUND_UP(nr_pages, chunk_pages);
+
+	chunks = kcalloc(nr_chunks, sizeof(*chunks), GFP_NOIO | __GFP_NOWARN);
+	if (!chunks)
+		return false;
+
+	cpu = raw_smp_processor_id();
+	for (i = 0; i < nr_chunks; i++) {
+		struct zram_bio_chunk *chunk = &chunks[i];
+		unsigned int pages = min(chunk_pages, nr_pages - i * chunk_pages);
+
+		chunk->zram = zram;
+		chunk->bio = bio;
+		chunk->index = index + i * chunk_pages;
+		chunk->iter = iter;
+		chunk->iter.bi_size = pages << PAGE_SHIFT;
+		bio_advance_iter(bio, &iter, pages << PAGE_SHIFT);
+
+		if (!i)
+			continue;
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+		INIT_WORK(&chunk->work, zram_write_work);
+		queue_work_on(cpu, zram_wq, &chunk->work);
+	}
+
+	zram_write_chunk(&chunks[0]);
+	ret = chunks[0].ret;
+	for (i = 1; i < nr_chunks; i++) {
+		flush_work(&chunks[i].work);
+		if (chunks[i].ret)
+			ret = chunks[i].ret;
+	}
+	kfree(chunks);
+
+	if (ret)
+		bio_io_error(bio);
+	else
+		bio_endio(bio);
+
+	return true;
+}
+
 static void __zram_make_request(struct zram *zram, struct bio *bio)
 {
 	int offset, rw;
@@ -1353,6 +2066,10 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 	}
 
 	rw = bio_data_dir(bio);
+	if (rw == WRITE && zram_can_write_parallel(bio, offset) &&
+			zram_write_parallel(zram, bio, index))
+		return;
+
 	bio_for_each_segment(bvec, bio, iter) {
 		struct bio_vec bv = bvec;
 		unsigned int unwritten = bvec.bv_len;
@@ -1462,9 +2179,10 @@ out:
 
 static void zram_reset_device(struct zram *zram)
 {
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp;
 	u64 disksize;
 
+	cancel_delayed_work_sync(&zram->recomp_work);
 	down_write(&zram->init_lock);
 
 	zram->limit_pages = 0;
@@ -1475,6 +2193,10 @@ static void zram_reset_device(struct zram *zram)
 	}
 
 	comp = zram->comp;
+	recomp = zram->recomp;
+	zram->recomp = NULL;
+	vfree(zram->recomp_idle);
+	zram->recomp_idle = NULL;
 	disksize = zram->disksize;
 	zram->disksize = 0;
 
@@ -1486,6 +2208,8 @@ static void zram_reset_device(struct zram *zram)
 	zram_meta_free(zram, disksize);
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	zcomp_destroy(comp);
+	if (recomp)
+		zcomp_destroy(recomp);
 	reset_bdev(zram);
 }
 
@@ -1493,7 +2217,7 @@ static ssize_t disksize_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	u64 disksize;
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp;
 	struct zram *zram = dev_to_zram(dev);
 	int err;
 
@@ -1522,9 +2246,32 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+	if (zram->recompressor[0]) {
+		recomp = zcomp_create(zram->recompressor);
+		if (IS_ERR(recomp)) {
+			pr_err("Cannot initialise %s recompressing backend\n",
+					zram->recompressor);
+			err = PTR_ERR(recomp);
+			zcomp_destroy(comp);
+			goto out_free_meta;
+		}
+		zram->recomp_idle = vzalloc(BITS_TO_LONGS(disksize >>
+					PAGE_SHIFT) * sizeof(long));
+		if (!zram->recomp_idle) {
+			err = -ENOMEM;
+			zcomp_destroy(recomp);
+			zcomp_destroy(comp);
+			goto out_free_meta;
+		}
+		zram->recomp = recomp;
+	}
+
 	zram->comp = comp;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
+	if (zram->recomp && zram->recomp_interval)
+		queue_delayed_work(system_unbound_wq, &zram->recomp_work,
+				zram->recomp_interval * HZ);
 
 	revalidate_disk(zram->disk);
 	up_write(&zram->init_lock);
@@ -1611,10 +2358,18 @@ static DEVICE_ATTR_RO(initstate);
 static DEVICE_ATTR_WO(reset);
 static DEVICE_ATTR_WO(mem_limit);
 static DEVICE_ATTR_WO(mem_used_max);
+static DEVICE_ATTR_WO(idle);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_WO(recompress);
+static DEVICE_ATTR_RW(recomp_interval);
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR_RW(use_dedup);
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RW(backing_dev);
+static DEVICE_ATTR_WO(writeback);
 #endif
 
 static struct attribute *zram_disk_attrs[] = {
@@ -1624,13 +2379,24 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_compact.attr,
 	&dev_attr_mem_limit.attr,
 	&dev_attr_mem_used_max.attr,
+	&dev_attr_idle.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_recompress.attr,
+	&dev_attr_recomp_interval.attr,
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 	&dev_attr_backing_dev.attr,
+	&dev_attr_writeback.attr,
 #endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_bd_stat.attr,
+#endif
 	&dev_attr_debug_stat.attr,
 	NULL,
 };
@@ -1664,6 +2430,7 @@ static int zram_add(void)
 	device_id = ret;
 
 	init_rwsem(&zram->init_lock);
+	INIT_DELAYED_WORK(&zram->recomp_work, zram_recomp_work);
 
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
@@ -1774,6 +2541,7 @@ static int zram_remove(struct zram *zram)
 	del_gendisk(zram->disk);
 	blk_cleanup_queue(zram->disk->queue);
 	put_disk(zram->disk);
+	cancel_delayed_work_sync(&zram->recomp_work);
 	kfree(zram);
 	return 0;
 }
@@ -1852,6 +2620,7 @@ static void destroy_devices(void)
 {
 	class_unregister(&zram_control_class);
 	idr_for_each(&zram_index_idr, &zram_remove_cb, NULL);
+	destroy_workqueue(zram_wq);
 	zram_debugfs_destroy();
 	idr_destroy(&zram_index_idr);
 	unregister_blkdev(zram_major, "zram");
@@ -1867,10 +2636,20 @@ static int __init zram_init(void)
 		return ret;
 	}
 
+	zram_wq = alloc_workqueue("zram_wq", WQ_HIGHPRI | WQ_MEM_RECLAIM |
+					WQ_CPU_INTENSIVE, 0);
+	if (!zram_wq) {
+		pr_err("Unable to allocate workqueue\n");
+		class_unregister(&zram_control_class);
+		return -ENOMEM;
+	}
+
 	zram_debugfs_create();
 	zram_major = register_blkdev(0, "zram");
 	if (zram_major <= 0) {
 		pr_err("Unable to get major number\n");
+		zram_debugfs_destroy();
+		destroy_workqueue(zram_wq);
 		class_unregister(&zram_control_class);
 		return -EBUSY;
 	}
@@ -1901,6 +2680,9 @@ module_exit(zram_exit);
 
 module_param(num_devices, uint, 0);
 MODULE_PARM_DESC(num_devices, "Number of pre-created zram devices");
+module_param(parallel_write_pages, uint, 0644);
+MODULE_PARM_DESC(parallel_write_pages,
+	"Minimum write size in pages compressed on several CPUs (0=off)");
 
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_AUTHOR("Nitin Gupta <ngupta@vflare.org>");
@@ -16,10 +16,12 @@
 #define _ZRAM_DRV_H_
 
 #include <linux/rwsem.h>
+#include <linux/rbtree.h>
 #include <linux/zsmalloc.h>
 #include <linux/crypto.h>
 
 #include "zcomp.h"
+#include "zram_dedup.h"
 
 #define SECTOR_SHIFT		9
 #define SECTORS_PER_PAGE_SHIFT	(PAGE_SHIFT - SECTOR_SHIFT)
@@ -48,7 +50,11 @@ enum zram_pageflags {
 	ZRAM_LOCK = ZRAM_FLAG_SHIFT,
 	ZRAM_SAME,	/* Page consists the same element */
 	ZRAM_WB,	/* page is stored on backing_device */
+	ZRAM_UNDER_WB,	/* page is under writeback */
 	ZRAM_HUGE,	/* Incompressible page */
+	ZRAM_IDLE,	/* not accessed page since last idle marking */
+	ZRAM_RECOMP,	/* compressed with the secondary algorithm */
+	ZRAM_INCOMPRESSIBLE, /* secondary algorithm did not help */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -80,12 +86,27 @@ struct zram_stats {
 	atomic64_t pages_stored;	/* no. of pages currently stored */
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
 	atomic64_t writestall;		/* no. of write slow paths */
+	atomic64_t dup_data_size;	/*
+					 * compressed size of pages
+					 * duplicated
+					 */
+	atomic64_t meta_data_size;	/* size of zram_entries */
+	atomic64_t dedup_hits;		/* no. of writes found in dedup index */
+	atomic64_t dedup_misses;	/* no. of writes not found in index */
+	atomic64_t recomp_pages;	/* no. of pages recompressed */
+#ifdef	CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;		/* no. of pages in backing device */
+	atomic64_t bd_reads;		/* no. of reads from backing device */
+	atomic64_t bd_writes;		/* no. of writes from backing device */
+#endif
 };
 
 struct zram {
 	struct zram_table_entry *table;
 	struct zs_pool *mem_pool;
 	struct zcomp *comp;
+	/* optional secondary algorithm for cold or poorly compressed slots */
+	struct zcomp *recomp;
 	struct gendisk *disk;
 	/* Prevent concurrent execution of device init */
 	struct rw_semaphore init_lock;
@@ -101,10 +122,23 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	char compressor[CRYPTO_MAX_ALG_NAME];
+	char recompressor[CRYPTO_MAX_ALG_NAME];
+	struct delayed_work recomp_work;
+	unsigned int recomp_interval;	/* seconds, 0 = no periodic pass */
+	/*
+	 * Slots untouched since the last periodic recompression pass. Kept
+	 * apart from ZRAM_IDLE, which belongs to userspace via idle_store.
+	 */
+	unsigned long *recomp_idle;
 	/*
 	 * zram is claimed so open request will be failed
 	 */
 	bool claim; /* Protected by bdev->bd_mutex */
+	bool use_dedup;
+#ifdef CONFIG_ZRAM_DEDUP
+	struct zram_hash *hash;
+	size_t hash_size;
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 	struct file *backing_dev;
 	struct block_device *bdev;
@@ -117,4 +151,13 @@ struct zram {
 	struct dentry *debugfs_dir;
 #endif
 };
+
+static inline bool zram_dedup_enabled(struct zram *zram)
+{
+#ifdef CONFIG_ZRAM_DEDUP
+	return zram->use_dedup;
+#else
+	return false;
+#endif
+}
 #endif
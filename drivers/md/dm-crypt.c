@@ -18,6 +18,7 @@
 #include <linux/slab.h>
 #include <linux/crypto.h>
 #include <linux/workqueue.h>
+#include <linux/interrupt.h>
 #include <linux/kthread.h>
 #include <linux/backing-dev.h>
 #include <linux/atomic.h>
@@ -54,6 +55,7 @@ struct dm_crypt_io {
 	struct crypt_config *cc;
 	struct bio *base_bio;
 	struct work_struct work;
+	struct tasklet_struct tasklet;
 
 	struct convert_context ctx;
 
@@ -112,7 +114,8 @@ struct iv_tcw_private {
  * and encrypts / decrypts at the same time.
  */
 enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID,
-	     DM_CRYPT_SAME_CPU, DM_CRYPT_NO_OFFLOAD };
+	     DM_CRYPT_SAME_CPU, DM_CRYPT_NO_OFFLOAD,
+	     DM_CRYPT_NO_READ_WORKQUEUE, DM_CRYPT_NO_WRITE_WORKQUEUE };
 
 /*
  * The fields in here must be read only after initialization.
@@ -183,6 +186,7 @@ struct crypt_config {
 
 static void clone_init(struct dm_crypt_io *, struct bio *);
 static void kcryptd_queue_crypt(struct dm_crypt_io *io);
+static void kcryptd_crypt_tasklet(unsigned long work);
 static u8 *iv_of_dmreq(struct crypt_config *cc, struct dm_crypt_request *dmreq);
 
 /*
@@ -882,13 +886,17 @@ static int crypt_convert_block(struct crypt_config *cc,
 static void kcryptd_async_done(struct crypto_async_request *async_req,
 			       int error);
 
-static void crypt_alloc_req(struct crypt_config *cc,
-			    struct convert_context *ctx)
+static int crypt_alloc_req(struct crypt_config *cc,
+			   struct convert_context *ctx, bool atomic)
 {
 	unsigned key_index = ctx->cc_sector & (cc->tfms_count - 1);
 
-	if (!ctx->req)
-		ctx->req = mempool_alloc(cc->req_pool, GFP_NOIO);
+	if (!ctx->req) {
+		ctx->req = mempool_alloc(cc->req_pool,
+					 atomic ? GFP_ATOMIC : GFP_NOIO);
+		if (!ctx->req)
+			return -ENOMEM;
+	}
 
 	ablkcipher_request_set_tfm(ctx->req, cc->tfms[key_index]);
 
@@ -897,8 +905,11 @@ static void crypt_alloc_req(struct crypt_config *cc,
 	 * requests if driver request queue is full.
 	 */
 	ablkcipher_request_set_callback(ctx->req,
-	    CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+	    CRYPTO_TFM_REQ_MAY_BACKLOG |
+	    (atomic ? 0 : CRYPTO_TFM_REQ_MAY_SLEEP),
 	    kcryptd_async_done, dmreq_of_req(cc, ctx->req));
+
+	return 0;
 }
 
 static void crypt_free_req(struct crypt_config *cc,
@@ -912,17 +923,27 @@ static void crypt_free_req(struct crypt_config *cc,
 
 /*
  * Encrypt / decrypt data from one bio to another one (can be the same one)
+ *
+ * With "atomic" set the conversion must not sleep. If it would have to
+ * (no request memory, or a full crypto driver queue) it stops and returns
+ * -EAGAIN, and the caller finishes it from process context. In that case
+ * ctx->restart is or will be completed once the conversion can go on.
  */
 static int crypt_convert(struct crypt_config *cc,
-			 struct convert_context *ctx)
+			 struct convert_context *ctx, bool atomic,
+			 bool reset_pending)
 {
 	int r;
 
-	atomic_set(&ctx->cc_pending, 1);
+	if (reset_pending)
+		atomic_set(&ctx->cc_pending, 1);
 
 	while (ctx->iter_in.bi_size && ctx->iter_out.bi_size) {
 
-		crypt_alloc_req(cc, ctx);
+		if (unlikely(crypt_alloc_req(cc, ctx, atomic))) {
+			complete(&ctx->restart);
+			return -EAGAIN;
+		}
 
 		atomic_inc(&ctx->cc_pending);
 
@@ -934,7 +955,13 @@ static int crypt_convert(struct crypt_config *cc,
 		 * but the driver request queue is full, let's wait.
 		 */
 		case -EBUSY:
-			wait_for_completion(&ctx->restart);
+			if (atomic && !try_wait_for_completion(&ctx->restart)) {
+				ctx->req = NULL;
+				ctx->cc_sector++;
+				return -EAGAIN;
+			}
+			if (!atomic)
+				wait_for_completion(&ctx->restart);
 			reinit_completion(&ctx->restart);
 			/* fall through */
 		/*
@@ -951,7 +978,8 @@ static int crypt_convert(struct crypt_config *cc,
 		case 0:
 			atomic_dec(&ctx->cc_pending);
 			ctx->cc_sector++;
-			cond_resched();
+			if (!atomic)
+				cond_resched();
 			continue;
 
 		/* There was an error while processing the request. */
@@ -1054,6 +1082,8 @@ static void crypt_io_init(struct dm_crypt_io *io, struct crypt_config *cc,
 	io->error = 0;
 	io->ctx.req = NULL;
 	atomic_set(&io->io_pending, 0);
+	tasklet_init(&io->tasklet, kcryptd_crypt_tasklet,
+		     (unsigned long)&io->work);
 }
 
 static void crypt_inc_pending(struct dm_crypt_io *io)
@@ -1061,6 +1091,13 @@ static void crypt_inc_pending(struct dm_crypt_io *io)
 	atomic_inc(&io->io_pending);
 }
 
+static void kcryptd_io_bio_endio(struct work_struct *work)
+{
+	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
+
+	bio_endio(io->base_bio);
+}
+
 /*
  * One of the bios was finished. Check for completion of
  * the whole request and correctly clean up the buffer.
@@ -1078,7 +1115,19 @@ static void crypt_dec_pending(struct dm_crypt_io *io)
 		crypt_free_req(cc, io->ctx.req, base_bio);
 
 	base_bio->bi_error = error;
-	bio_endio(base_bio);
+
+	/*
+	 * Ending base_bio frees io, which holds the tasklet we may be
+	 * running from. Leave that to kcryptd_io then.
+	 */
+	if (tasklet_trylock(&io->tasklet)) {
+		tasklet_unlock(&io->tasklet);
+		bio_endio(base_bio);
+		return;
+	}
+
+	INIT_WORK(&io->work, kcryptd_io_bio_endio);
+	queue_work(cc->io_queue, &io->work);
 }
 
 /*
@@ -1263,7 +1312,8 @@ static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io, int async)
 
 	clone->bi_iter.bi_sector = cc->start + io->sector;
 
-	if (likely(!async) && test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags)) {
+	if (likely(!async) && (test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags) ||
+			       test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))) {
 		generic_make_request(clone);
 		return;
 	}
@@ -1312,7 +1362,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	sector += bio_sectors(clone);
 
 	crypt_inc_pending(io);
-	r = crypt_convert(cc, &io->ctx);
+	r = crypt_convert(cc, &io->ctx, false, true);
 	if (r)
 		io->error = -EIO;
 	crypt_finished = atomic_dec_and_test(&io->ctx.cc_pending);
@@ -1332,9 +1382,32 @@ static void kcryptd_crypt_read_done(struct dm_crypt_io *io)
 	crypt_dec_pending(io);
 }
 
+/*
+ * Finish a read conversion that had to stop in atomic context.
+ */
+static void kcryptd_crypt_read_continue(struct work_struct *work)
+{
+	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
+	struct crypt_config *cc = io->cc;
+	int r;
+
+	wait_for_completion(&io->ctx.restart);
+	reinit_completion(&io->ctx.restart);
+
+	r = crypt_convert(cc, &io->ctx, false, false);
+	if (r < 0)
+		io->error = -EIO;
+
+	if (atomic_dec_and_test(&io->ctx.cc_pending))
+		kcryptd_crypt_read_done(io);
+
+	crypt_dec_pending(io);
+}
+
 static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->cc;
+	bool atomic = test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
 	int r = 0;
 
 	crypt_inc_pending(io);
@@ -1342,7 +1415,12 @@ static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 	crypt_convert_init(cc, &io->ctx, io->base_bio, io->base_bio,
 			   io->sector);
 
-	r = crypt_convert(cc, &io->ctx);
+	r = crypt_convert(cc, &io->ctx, atomic, true);
+	if (r == -EAGAIN) {
+		INIT_WORK(&io->work, kcryptd_crypt_read_continue);
+		queue_work(cc->crypt_queue, &io->work);
+		return;
+	}
 	if (r < 0)
 		io->error = -EIO;
 
@@ -1397,10 +1475,32 @@ static void kcryptd_crypt(struct work_struct *work)
 		kcryptd_crypt_write_convert(io);
 }
 
+static void kcryptd_crypt_tasklet(unsigned long work)
+{
+	kcryptd_crypt((struct work_struct *)work);
+}
+
 static void kcryptd_queue_crypt(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->cc;
 
+	if (bio_data_dir(io->base_bio) == READ &&
+	    test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags)) {
+		/*
+		 * Decrypt right in the completion context. The crypto API
+		 * can't be used in hard irq context or with irqs disabled
+		 * (some drivers complete I/O from the idle loop that way),
+		 * so move to a tasklet on this CPU then.
+		 */
+		if (in_irq() || irqs_disabled()) {
+			tasklet_schedule(&io->tasklet);
+			return;
+		}
+
+		kcryptd_crypt(&io->work);
+		return;
+	}
+
 	INIT_WORK(&io->work, kcryptd_crypt);
 	queue_work(cc->crypt_queue, &io->work);
 }
@@ -1740,7 +1840,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	char dummy;
 
 	static struct dm_arg _args[] = {
-		{0, 3, "Invalid number of feature args"},
+		{0, 5, "Invalid number of feature args"},
 	};
 
 	if (argc < 5) {
@@ -1855,6 +1955,12 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 			else if (!strcasecmp(opt_string, "submit_from_crypt_cpus"))
 				set_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
 
+			else if (!strcasecmp(opt_string, "no_read_workqueue"))
+				set_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
+
+			else if (!strcasecmp(opt_string, "no_write_workqueue"))
+				set_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
+
 			else {
 				ti->error = "Invalid feature arguments";
 				goto bad;
@@ -1941,7 +2047,9 @@ static int crypt_map(struct dm_target *ti, struct bio *bio)
 	if (bio_data_dir(io->base_bio) == READ) {
 		if (kcryptd_io_read(io, GFP_NOWAIT))
 			kcryptd_queue_read(io);
-	} else
+	} else if (test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))
+		kcryptd_crypt_write_convert(io);
+	else
 		kcryptd_queue_crypt(io);
 
 	return DM_MAPIO_SUBMITTED;
@@ -1974,6 +2082,8 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 		num_feature_args += !!ti->num_discard_bios;
 		num_feature_args += test_bit(DM_CRYPT_SAME_CPU, &cc->flags);
 		num_feature_args += test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
 		if (num_feature_args) {
 			DMEMIT(" %d", num_feature_args);
 			if (ti->num_discard_bios)
@@ -1982,6 +2092,10 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 				DMEMIT(" same_cpu_crypt");
 			if (test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags))
 				DMEMIT(" submit_from_crypt_cpus");
+			if (test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags))
+				DMEMIT(" no_read_workqueue");
+			if (test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))
+				DMEMIT(" no_write_workqueue");
 		}
 
 		break;
@@ -2075,7 +2189,7 @@ static void crypt_io_hints(struct dm_target *ti, struct queue_limits *limits)
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 14, 1},
+	.version = {1, 15, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -12,11 +12,19 @@
  * hash device. Setting this greatly improves performance when data and hash
  * are on the same disk on different partitions on devices with poor random
  * access behavior.
+ *
+ * "/sys/module/dm_verity/parameters/hash_cache_blocks" is the number of hash
+ * blocks each target may cache, however the global dm-bufio cache is split
+ * between its clients. Hash blocks of the top "pinned_levels" tree levels
+ * that fit in this budget are held in memory for the lifetime of the target
+ * once they have been verified, so they are never evicted or re-hashed.
+ * Both values are sampled when a target is created.
  */
 
 #include "dm-verity.h"
 #include "dm-verity-fec.h"
 
+#include <linux/highmem.h>
 #include <linux/module.h>
 #include <linux/reboot.h>
 #include <linux/vmalloc.h>
@@ -27,9 +35,13 @@
 #define DM_VERITY_ENV_VAR_NAME		"DM_VERITY_ERR_BLOCK_NR"
 
 #define DM_VERITY_DEFAULT_PREFETCH_SIZE	262144
+#define DM_VERITY_DEFAULT_HASH_CACHE	1024
+#define DM_VERITY_DEFAULT_PINNED_LEVELS	2
 
 #define DM_VERITY_MAX_CORRUPTED_ERRS	100
 
+#define DM_VERITY_MAX_MB_MSGS		8
+
 #define DM_VERITY_OPT_LOGGING		"ignore_corruption"
 #define DM_VERITY_OPT_RESTART		"restart_on_corruption"
 #define DM_VERITY_OPT_IGN_ZEROES	"ignore_zero_blocks"
@@ -41,6 +53,14 @@ static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
 module_param_named(prefetch_cluster, dm_verity_prefetch_cluster, uint, S_IRUGO | S_IWUSR);
 
+static unsigned dm_verity_hash_cache_blocks = DM_VERITY_DEFAULT_HASH_CACHE;
+
+module_param_named(hash_cache_blocks, dm_verity_hash_cache_blocks, uint, S_IRUGO | S_IWUSR);
+
+static unsigned dm_verity_pinned_levels = DM_VERITY_DEFAULT_PINNED_LEVELS;
+
+module_param_named(pinned_levels, dm_verity_pinned_levels, uint, S_IRUGO | S_IWUSR);
+
 struct dm_verity_prefetch_work {
 	struct work_struct work;
 	struct dm_verity *v;
@@ -95,7 +115,8 @@ static sector_t verity_position_at_level(struct dm_verity *v, sector_t block,
 }
 
 /*
- * Wrapper for crypto_shash_init, which handles verity salting.
+ * Wrapper for crypto_shash_init, which handles verity salting. Once the
+ * target is set up the salted state is imported rather than recomputed.
  */
 static int verity_hash_init(struct dm_verity *v, struct shash_desc *desc)
 {
@@ -104,6 +125,13 @@ static int verity_hash_init(struct dm_verity *v, struct shash_desc *desc)
 	desc->tfm = v->tfm;
 	desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
 
+	if (likely(v->initial_hashstate)) {
+		r = crypto_shash_import(desc, v->initial_hashstate);
+		if (unlikely(r < 0))
+			DMERR("crypto_shash_import failed: %d", r);
+		return r;
+	}
+
 	r = crypto_shash_init(desc);
 
 	if (unlikely(r < 0)) {
@@ -245,6 +273,34 @@ out:
 	return 1;
 }
 
+/*
+ * Return the pinned buffer of a hash block, or NULL if the block is not
+ * pinned (yet). Pinned buffers have always been verified.
+ */
+static struct dm_buffer *verity_pinned_buffer(struct dm_verity *v,
+					      sector_t hash_block)
+{
+	if (hash_block - v->hash_start >= v->pinned_blocks)
+		return NULL;
+
+	return ACCESS_ONCE(v->pinned_bufs[hash_block - v->hash_start]);
+}
+
+/*
+ * Keep a verified hash block of one of the top tree levels in memory. On
+ * success the reference on "buf" is handed over to the pinned table and
+ * true is returned. If the block is not pinnable or another process pinned
+ * it first, false is returned and the caller still owns its reference.
+ */
+static bool verity_pin_buffer(struct dm_verity *v, sector_t hash_block,
+			      struct dm_buffer *buf)
+{
+	if (hash_block - v->hash_start >= v->pinned_blocks)
+		return false;
+
+	return !cmpxchg(&v->pinned_bufs[hash_block - v->hash_start], NULL, buf);
+}
+
 /*
  * Verify hash of a metadata block pertaining to the specified data block
  * ("block" argument) at a specified level ("level" argument).
@@ -269,6 +325,13 @@ static int verity_verify_level(struct dm_verity *v, struct dm_verity_io *io,
 
 	verity_hash_at_level(v, block, level, &hash_block, &offset);
 
+	buf = verity_pinned_buffer(v, hash_block);
+	if (buf) {
+		data = dm_bufio_get_block_data(buf);
+		memcpy(want_digest, data + offset, v->digest_size);
+		return 0;
+	}
+
 	data = dm_bufio_read(v->bufio, hash_block, &buf);
 	if (IS_ERR(data))
 		return PTR_ERR(data);
@@ -304,6 +367,9 @@ static int verity_verify_level(struct dm_verity *v, struct dm_verity_io *io,
 
 	data += offset;
 	memcpy(want_digest, data, v->digest_size);
+
+	if (aux->hash_verified && verity_pin_buffer(v, hash_block, buf))
+		return 0;
 	r = 0;
 
 release_ret_r:
@@ -412,22 +478,130 @@ static inline void verity_bv_skip_block(struct dm_verity *v,
 	bio_advance_iter(bio, iter, 1 << v->data_dev_block_bits);
 }
 
+/*
+ * Forget that the data blocks of "io" were validated. Called when the read
+ * failed, so the next read of these blocks is verified from scratch.
+ */
+static void verity_invalidate_io(struct dm_verity *v, struct dm_verity_io *io)
+{
+	unsigned b;
+
+	if (!v->validated_blocks)
+		return;
+
+	for (b = 0; b < io->n_blocks; b++)
+		clear_bit(io->block + b, v->validated_blocks);
+}
+
+/*
+ * Data blocks of one bio that are hashed together by verity_verify_mb().
+ */
+struct verity_mb_batch {
+	unsigned n;
+	sector_t blocks[DM_VERITY_MAX_MB_MSGS];
+	struct bvec_iter starts[DM_VERITY_MAX_MB_MSGS];
+	struct page *pages[DM_VERITY_MAX_MB_MSGS];
+	const u8 *data[DM_VERITY_MAX_MB_MSGS];
+	u8 *digests[DM_VERITY_MAX_MB_MSGS];
+};
+
+static void verity_mb_unmap(struct verity_mb_batch *mb)
+{
+	unsigned i;
+
+	for (i = 0; i < mb->n; i++)
+		kunmap(mb->pages[i]);
+	mb->n = 0;
+}
+
+/*
+ * Hash all data blocks collected in "mb" with one crypto call and check
+ * them against their digests from the hash tree. Blocks that don't match
+ * go through FEC and error handling one at a time.
+ */
+static int verity_verify_mb(struct dm_verity *v, struct dm_verity_io *io,
+			    struct verity_mb_batch *mb)
+{
+	struct shash_desc *desc = verity_io_hash_desc(v, io);
+	unsigned i, n = mb->n;
+	int r;
+
+	if (!n)
+		return 0;
+
+	r = verity_hash_init(v, desc);
+	if (likely(!r)) {
+		r = crypto_shash_finup_mb(desc, mb->data,
+					  1 << v->data_dev_block_bits,
+					  mb->digests, n);
+		if (unlikely(r < 0))
+			DMERR("crypto_shash_finup_mb failed: %d", r);
+	}
+
+	verity_mb_unmap(mb);
+	if (unlikely(r < 0))
+		return r;
+
+	for (i = 0; i < n; i++) {
+		u8 *want_digest = verity_io_mb_want_digest(v, io, i);
+
+		if (likely(memcmp(mb->digests[i], want_digest,
+				  v->digest_size) == 0)) {
+			if (v->validated_blocks)
+				set_bit(mb->blocks[i], v->validated_blocks);
+			continue;
+		}
+
+		/* FEC checks its result against the regular want digest */
+		if (want_digest != verity_io_want_digest(v, io))
+			memcpy(verity_io_want_digest(v, io), want_digest,
+			       v->digest_size);
+
+		if (verity_fec_decode(v, io, DM_VERITY_BLOCK_TYPE_DATA,
+				      mb->blocks[i], NULL, &mb->starts[i]) == 0)
+			continue;
+		else if (verity_handle_err(v, DM_VERITY_BLOCK_TYPE_DATA,
+					   mb->blocks[i]))
+			return -EIO;
+	}
+
+	return 0;
+}
+
 /*
  * Verify one "dm_verity_io" structure.
+ *
+ * Blocks that lie within a single bio_vec are hashed directly from their
+ * pages in batches of up to v->mb_max_msgs blocks, which lets multi-buffer
+ * hash implementations work on several blocks at once. Other blocks, and
+ * all blocks of version 0 targets (which hash the salt last), are hashed
+ * one at a time.
  */
 static int verity_verify_io(struct dm_verity_io *io)
 {
 	bool is_zero;
 	struct dm_verity *v = io->v;
+	struct bio *bio = dm_bio_from_per_bio_data(io, v->ti->per_bio_data_size);
+	struct verity_mb_batch mb;
 	struct bvec_iter start;
 	unsigned b;
+	int r;
+
+	mb.n = 0;
+
+	/*
+	 * The buffers of a failed read hold whatever the device returned,
+	 * so every block has to go through hashing and FEC again.
+	 */
+	if (unlikely(bio->bi_error))
+		verity_invalidate_io(v, io);
 
 	for (b = 0; b < io->n_blocks; b++) {
-		int r;
 		sector_t cur_block = io->block + b;
 		struct shash_desc *desc = verity_io_hash_desc(v, io);
+		struct bio_vec bv;
 
-		if (v->validated_blocks &&
+		if (v->validated_blocks && likely(!bio->bi_error) &&
 		    likely(test_bit(cur_block, v->validated_blocks))) {
 			verity_bv_skip_block(v, io, &io->iter);
 			continue;
@@ -437,7 +611,7 @@ static int verity_verify_io(struct dm_verity_io *io)
 					  verity_io_want_digest(v, io),
 					  &is_zero);
 		if (unlikely(r < 0))
-			return r;
+			goto unmap;
 
 		if (is_zero) {
 			/*
@@ -447,23 +621,48 @@ static int verity_verify_io(struct dm_verity_io *io)
 			r = verity_for_bv_block(v, io, &io->iter,
 						verity_bv_zero);
 			if (unlikely(r < 0))
-				return r;
+				goto unmap;
 
 			continue;
 		}
 
+		bv = bio_iter_iovec(bio, io->iter);
+		if (likely(v->version >= 1) &&
+		    likely(bv.bv_len >= 1 << v->data_dev_block_bits)) {
+			u8 *want_digest = verity_io_mb_want_digest(v, io, mb.n);
+
+			if (want_digest != verity_io_want_digest(v, io))
+				memcpy(want_digest, verity_io_want_digest(v, io),
+				       v->digest_size);
+
+			mb.blocks[mb.n] = cur_block;
+			mb.starts[mb.n] = io->iter;
+			mb.pages[mb.n] = bv.bv_page;
+			mb.data[mb.n] = (u8 *)kmap(bv.bv_page) + bv.bv_offset;
+			mb.digests[mb.n] = verity_io_mb_real_digest(v, io, mb.n);
+			mb.n++;
+			verity_bv_skip_block(v, io, &io->iter);
+
+			if (mb.n == v->mb_max_msgs) {
+				r = verity_verify_mb(v, io, &mb);
+				if (unlikely(r < 0))
+					return r;
+			}
+			continue;
+		}
+
 		r = verity_hash_init(v, desc);
 		if (unlikely(r < 0))
-			return r;
+			goto unmap;
 
 		start = io->iter;
 		r = verity_for_bv_block(v, io, &io->iter, verity_bv_hash_update);
 		if (unlikely(r < 0))
-			return r;
+			goto unmap;
 
 		r = verity_hash_final(v, desc, verity_io_real_digest(v, io));
 		if (unlikely(r < 0))
-			return r;
+			goto unmap;
 
 		if (likely(memcmp(verity_io_real_digest(v, io),
 				  verity_io_want_digest(v, io), v->digest_size) == 0)) {
@@ -471,15 +670,25 @@ static int verity_verify_io(struct dm_verity_io *io)
 				set_bit(cur_block, v->validated_blocks);
 			continue;
 		}
+		/*
+		 * A block corrected by FEC is not marked as validated: the
+		 * data device still holds the corrupted copy.
+		 */
 		else if (verity_fec_decode(v, io, DM_VERITY_BLOCK_TYPE_DATA,
 					   cur_block, NULL, &start) == 0)
 			continue;
 		else if (verity_handle_err(v, DM_VERITY_BLOCK_TYPE_DATA,
-					   cur_block))
-			return -EIO;
+					   cur_block)) {
+			r = -EIO;
+			goto unmap;
+		}
 	}
 
-	return 0;
+	return verity_verify_mb(v, io, &mb);
+
+unmap:
+	verity_mb_unmap(&mb);
+	return r;
 }
 
 /*
@@ -510,6 +719,7 @@ static void verity_end_io(struct bio *bio)
 	struct dm_verity_io *io = bio->bi_private;
 
 	if (bio->bi_error && !verity_fec_is_enabled(io->v)) {
+		verity_invalidate_io(io->v, io);
 		verity_finish_io(io, bio->bi_error);
 		return;
 	}
@@ -730,14 +940,21 @@ EXPORT_SYMBOL_GPL(verity_io_hints);
 void verity_dtr(struct dm_target *ti)
 {
 	struct dm_verity *v = ti->private;
+	unsigned i;
 
 	if (v->verify_wq)
 		destroy_workqueue(v->verify_wq);
 
+	for (i = 0; i < v->pinned_blocks; i++)
+		if (v->pinned_bufs[i])
+			dm_bufio_release(v->pinned_bufs[i]);
+	vfree(v->pinned_bufs);
+
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
 	vfree(v->validated_blocks);
+	kfree(v->initial_hashstate);
 	kfree(v->salt);
 	kfree(v->root_digest);
 	kfree(v->zero_digest);
@@ -779,6 +996,81 @@ static int verity_alloc_most_once(struct dm_verity *v)
 	return 0;
 }
 
+/*
+ * Size the dedicated hash block cache and choose which tree levels are
+ * pinned. Levels are laid out from the root downwards starting at
+ * hash_start, so the pinned blocks form one range there. Levels are added
+ * from the top for as long as they fit in the cache budget.
+ */
+static int verity_alloc_hash_cache(struct dm_verity *v)
+{
+	struct dm_target *ti = v->ti;
+	unsigned cache_blocks = ACCESS_ONCE(dm_verity_hash_cache_blocks);
+	unsigned pinned_levels = ACCESS_ONCE(dm_verity_pinned_levels);
+	sector_t pinned_end = v->hash_start;
+	int i;
+
+	if (cache_blocks)
+		dm_bufio_set_minimum_buffers(v->bufio, cache_blocks);
+
+	for (i = v->levels - 1; i >= 0 && pinned_levels; i--, pinned_levels--) {
+		sector_t level_end = i ? v->hash_level_block[i - 1] :
+					 v->hash_blocks;
+
+		if (level_end - v->hash_start > cache_blocks)
+			break;
+		pinned_end = level_end;
+	}
+
+	if (pinned_end == v->hash_start)
+		return 0;
+
+	v->pinned_bufs = vzalloc((pinned_end - v->hash_start) *
+				 sizeof(struct dm_buffer *));
+	if (!v->pinned_bufs) {
+		ti->error = "Cannot allocate pinned hash block table";
+		return -ENOMEM;
+	}
+	v->pinned_blocks = pinned_end - v->hash_start;
+
+	return 0;
+}
+
+/*
+ * Compute the hash state after the salt once, so verity_hash_init() can
+ * import it for every block instead of hashing the salt again.
+ */
+static int verity_alloc_initial_hashstate(struct dm_verity *v)
+{
+	int r;
+	struct shash_desc *desc;
+	u8 *state;
+
+	state = kmalloc(crypto_shash_statesize(v->tfm), GFP_KERNEL);
+	if (!state)
+		return -ENOMEM;
+
+	desc = kmalloc(v->shash_descsize, GFP_KERNEL);
+	if (!desc) {
+		kfree(state);
+		return -ENOMEM;
+	}
+
+	r = verity_hash_init(v, desc);
+	if (!r)
+		r = crypto_shash_export(desc, state);
+
+	kfree(desc);
+
+	if (r) {
+		kfree(state);
+		return r;
+	}
+
+	v->initial_hashstate = state;
+	return 0;
+}
+
 static int verity_alloc_zero_digest(struct dm_verity *v)
 {
 	int r = -ENOMEM;
@@ -1033,6 +1325,15 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		}
 	}
 
+	r = verity_alloc_initial_hashstate(v);
+	if (r) {
+		ti->error = "Cannot compute initial hash state";
+		goto bad;
+	}
+
+	v->mb_max_msgs = min_t(unsigned, crypto_shash_mb_max_msgs(v->tfm),
+			       DM_VERITY_MAX_MB_MSGS);
+
 	argv += 10;
 	argc -= 10;
 
@@ -1101,6 +1402,10 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
+	r = verity_alloc_hash_cache(v);
+	if (r)
+		goto bad;
+
 	/* WQ_UNBOUND greatly improves performance when running on ramdisk */
 	v->verify_wq = alloc_workqueue("kverityd", WQ_CPU_INTENSIVE | WQ_MEM_RECLAIM | WQ_UNBOUND, num_online_cpus());
 	if (!v->verify_wq) {
@@ -1111,6 +1416,8 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 
 	ti->per_bio_data_size = sizeof(struct dm_verity_io) +
 				v->shash_descsize + v->digest_size * 2;
+	if (v->mb_max_msgs > 1)
+		ti->per_bio_data_size += v->digest_size * 2 * v->mb_max_msgs;
 
 	r = verity_fec_ctr(v);
 	if (r)
@@ -53,6 +53,8 @@ struct dm_verity {
 	unsigned char version;
 	unsigned digest_size;	/* digest size for the current hash algorithm */
 	unsigned shash_descsize;/* the size of temporary space for crypto */
+	unsigned mb_max_msgs;	/* data blocks hashed per crypto call */
+	u8 *initial_hashstate;	/* hash state after the salt */
 	int hash_failed;	/* set to 1 if hash of any block failed */
 	enum verity_mode mode;	/* mode for handling verification errors */
 	unsigned corrupted_errs;/* Number of errors for corrupted blocks */
@@ -64,6 +66,8 @@ struct dm_verity {
 
 	struct dm_verity_fec *fec;	/* forward error correction */
 	unsigned long *validated_blocks; /* bitset blocks validated */
+	struct dm_buffer **pinned_bufs;	/* verified blocks of the top levels */
+	unsigned pinned_blocks;	/* the number of entries in pinned_bufs */
 };
 
 struct dm_verity_io {
@@ -85,9 +89,13 @@ struct dm_verity_io {
 	 * u8 hash_desc[v->shash_descsize];
 	 * u8 real_digest[v->digest_size];
 	 * u8 want_digest[v->digest_size];
+	 * u8 mb_digests[v->mb_max_msgs * 2 * v->digest_size];
 	 *
 	 * To access them use: verity_io_hash_desc(), verity_io_real_digest()
-	 * and verity_io_want_digest().
+	 * and verity_io_want_digest(). mb_digests holds the real and want
+	 * digests of each block of a batch and is only present if
+	 * v->mb_max_msgs > 1, see verity_io_mb_real_digest() and
+	 * verity_io_mb_want_digest().
 	 */
 };
 
@@ -109,10 +117,33 @@ static inline u8 *verity_io_want_digest(struct dm_verity *v,
 	return (u8 *)(io + 1) + v->shash_descsize + v->digest_size;
 }
 
+/*
+ * Digests of the i-th data block of a batch. Batches of a single block
+ * use the regular real_digest and want_digest.
+ */
+static inline u8 *verity_io_mb_real_digest(struct dm_verity *v,
+					   struct dm_verity_io *io, unsigned i)
+{
+	if (v->mb_max_msgs == 1)
+		return verity_io_real_digest(v, io);
+	return verity_io_want_digest(v, io) + v->digest_size * (2 * i + 1);
+}
+
+static inline u8 *verity_io_mb_want_digest(struct dm_verity *v,
+					   struct dm_verity_io *io, unsigned i)
+{
+	if (v->mb_max_msgs == 1)
+		return verity_io_want_digest(v, io);
+	return verity_io_want_digest(v, io) + v->digest_size * (2 * i + 2);
+}
+
 static inline u8 *verity_io_digest_end(struct dm_verity *v,
 				       struct dm_verity_io *io)
 {
-	return verity_io_want_digest(v, io) + v->digest_size;
+	if (v->mb_max_msgs == 1)
+		return verity_io_want_digest(v, io) + v->digest_size;
+	return verity_io_mb_want_digest(v, io, v->mb_max_msgs - 1) +
+	       v->digest_size;
 }
 
 extern int verity_for_bv_block(struct dm_verity *v, struct dm_verity_io *io,
@@ -25,8 +25,14 @@
 #include <linux/vmalloc.h>
 #include <linux/vmstat.h>
 #include <linux/mmzone.h>
+#include <linux/workqueue.h>
 #include "ion_priv.h"
 
+/* Time refill stays off after the pool was shrunk */
+#define ION_POOL_REFILL_BACKOFF	HZ
+
+static struct workqueue_struct *ion_page_pool_wq;
+
 static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
 {
 	struct page *page;
@@ -105,6 +111,55 @@ static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 	return page;
 }
 
+static bool ion_page_pool_needs_refill(struct ion_page_pool *pool)
+{
+	return pool->high_count + pool->low_count < pool->watermark &&
+	       time_after_eq(jiffies, pool->refill_resume);
+}
+
+static void ion_page_pool_kick_refill(struct ion_page_pool *pool)
+{
+	if (ion_page_pool_wq && ion_page_pool_needs_refill(pool))
+		queue_work(ion_page_pool_wq, &pool->refill_work);
+}
+
+/*
+ * Top the pool up to its watermark so that allocations find pages that
+ * are already zeroed and clean in the cache. Allocation does not enter
+ * direct reclaim and gives up at the first failure: the pool only soaks
+ * up memory that is free anyway.
+ */
+static void ion_page_pool_refill_work(struct work_struct *work)
+{
+	struct ion_page_pool *pool = container_of(work, struct ion_page_pool,
+						  refill_work);
+	gfp_t gfp_mask = (pool->gfp_mask | __GFP_NORETRY | __GFP_NOWARN) &
+			 ~(__GFP_DIRECT_RECLAIM | __GFP_ZERO);
+	struct page *page;
+
+	while (ion_page_pool_needs_refill(pool)) {
+		page = alloc_pages(gfp_mask, pool->order);
+		if (!page)
+			break;
+
+		if (msm_ion_heap_high_order_page_zero(pool->dev, page,
+						      pool->order)) {
+			__free_pages(page, pool->order);
+			break;
+		}
+		ion_page_pool_alloc_set_cache_policy(pool, page);
+		ion_page_pool_add(pool, page);
+		cond_resched();
+	}
+}
+
+void ion_page_pool_set_watermark(struct ion_page_pool *pool,
+				 unsigned int watermark)
+{
+	pool->watermark = watermark;
+	ion_page_pool_kick_refill(pool);
+}
+
 void *ion_page_pool_alloc(struct ion_page_pool *pool, bool *from_pool)
 {
 	struct page *page = NULL;
@@ -124,6 +179,7 @@ void *ion_page_pool_alloc(struct ion_page_pool *pool, bool *from_pool)
 		page = ion_page_pool_alloc_pages(pool);
 		*from_pool = false;
 	}
+	ion_page_pool_kick_refill(pool);
 	return page;
 }
 
@@ -143,6 +199,8 @@ void *ion_page_pool_alloc_pool_only(struct ion_page_pool *pool)
 			page = ion_page_pool_remove(pool, false);
 		mutex_unlock(&pool->mutex);
 	}
+	if (page)
+		ion_page_pool_kick_refill(pool);
 
 	return page;
 }
@@ -185,6 +243,9 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 	if (nr_to_scan == 0)
 		return ion_page_pool_total(pool, high);
 
+	/* Don't refill what reclaim is taking away */
+	pool->refill_resume = jiffies + ION_POOL_REFILL_BACKOFF;
+
 	while (freed < nr_to_scan) {
 		struct page *page;
 
@@ -221,17 +282,37 @@ struct ion_page_pool *ion_page_pool_create(struct device *dev, gfp_t gfp_mask,
 	pool->order = order;
 	mutex_init(&pool->mutex);
 	plist_node_init(&pool->list, order);
+	pool->watermark = 0;
+	INIT_WORK(&pool->refill_work, ion_page_pool_refill_work);
+	pool->refill_resume = jiffies;
 
 	return pool;
 }
 
 void ion_page_pool_destroy(struct ion_page_pool *pool)
 {
+	pool->watermark = 0;
+	cancel_work_sync(&pool->refill_work);
 	kfree(pool);
 }
 
 static int __init ion_page_pool_init(void)
 {
+	struct workqueue_attrs *attrs;
+
+	ion_page_pool_wq = alloc_workqueue("ion_pool_refill",
+					   WQ_UNBOUND | WQ_FREEZABLE, 0);
+	if (!ion_page_pool_wq)
+		return -ENOMEM;
+
+	/* Refill is opportunistic, keep it out of the way of real work */
+	attrs = alloc_workqueue_attrs(GFP_KERNEL);
+	if (attrs) {
+		attrs->nice = MAX_NICE;
+		cpumask_copy(attrs->cpumask, cpu_possible_mask);
+		apply_workqueue_attrs(ion_page_pool_wq, attrs);
+		free_workqueue_attrs(attrs);
+	}
 	return 0;
 }
 device_initcall(ion_page_pool_init);
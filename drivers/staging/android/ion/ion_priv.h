@@ -30,6 +30,7 @@
 #include <linux/sched.h>
 #include <linux/shrinker.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
 #ifdef CONFIG_ION_POOL_CACHE_POLICY
 #include <asm/cacheflush.h>
 #endif
@@ -426,6 +427,12 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * @gfp_mask:		gfp_mask to use from alloc
  * @order:		order of pages in the pool
  * @list:		plist node for list of pools
+ * @watermark:		number of items the refill worker keeps in the pool,
+ *			0 disables background refill
+ * @refill_work:	worker topping the pool up to @watermark with
+ *			zeroed pages
+ * @refill_resume:	jiffies before which no refill is started because
+ *			the pool was shrunk under memory pressure
  *
  * Allows you to keep a pool of pre allocated pages to use from your heap.
  * Keeping a pool of pages that is ready for dma, ie any cached mapping have
@@ -442,6 +449,9 @@ struct ion_page_pool {
 	gfp_t gfp_mask;
 	unsigned int order;
 	struct plist_node list;
+	unsigned int watermark;
+	struct work_struct refill_work;
+	unsigned long refill_resume;
 };
 
 struct ion_page_pool *ion_page_pool_create(struct device *dev, gfp_t gfp_mask,
@@ -452,6 +462,8 @@ void *ion_page_pool_alloc_pool_only(struct ion_page_pool *);
 void ion_page_pool_free(struct ion_page_pool *, struct page *);
 void ion_page_pool_free_immediate(struct ion_page_pool *, struct page *);
 int ion_page_pool_total(struct ion_page_pool *pool, bool high);
+void ion_page_pool_set_watermark(struct ion_page_pool *pool,
+				 unsigned int watermark);
 size_t ion_system_heap_secure_page_pool_total(struct ion_heap *heap, int vmid);
 
 #ifdef CONFIG_ION_POOL_CACHE_POLICY
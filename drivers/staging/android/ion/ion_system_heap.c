@@ -23,6 +23,7 @@
 #include <linux/msm_ion.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include "ion.h"
@@ -42,11 +43,37 @@ static const unsigned int orders[] = {8, 4, 0};
 #else
 static const unsigned int orders[] = {9, 4, 0};
 #endif
+/*
+ * KB of zeroed pages kept ready per uncached pool, indexed like orders[].
+ * Scaled down so that one heap never keeps more than 1/256 of RAM.
+ */
+static unsigned int pool_refill_kb[] = {12288, 1024, 256};
 #else
 static const unsigned int orders[] = {0};
+static unsigned int pool_refill_kb[] = {1024};
 #endif
+module_param_array(pool_refill_kb, uint, NULL, 0444);
+
+#define ION_POOL_REFILL_RAM_SHIFT	8
 
 static const int num_orders = ARRAY_SIZE(orders);
+
+static unsigned int pool_refill_watermark(int index)
+{
+	unsigned long budget_kb = (totalram_pages << (PAGE_SHIFT - 10)) >>
+				  ION_POOL_REFILL_RAM_SHIFT;
+	unsigned long total_kb = 0;
+	unsigned long kb = pool_refill_kb[index];
+	int i;
+
+	for (i = 0; i < num_orders; i++)
+		total_kb += pool_refill_kb[i];
+	if (total_kb > budget_kb)
+		kb = mult_frac(kb, budget_kb, total_kb);
+
+	return (kb * SZ_1K) >> (PAGE_SHIFT + orders[index]);
+}
+
 static int order_to_index(unsigned int order)
 {
 	int i;
@@ -696,6 +723,9 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 				pool->low_count, pool->order,
 				(1 << pool->order) * PAGE_SIZE *
 					pool->low_count);
+			seq_printf(s,
+				"%u order %u pages refill watermark in uncached pool\n",
+				pool->watermark, pool->order);
 		}
 
 		uncached_total += (1 << pool->order) * PAGE_SIZE *
@@ -847,6 +877,11 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *data)
 	if (ion_system_heap_create_pools(dev, heap->cached_pools))
 		goto err_create_cached_pools;
 
+	BUILD_BUG_ON(ARRAY_SIZE(pool_refill_kb) != ARRAY_SIZE(orders));
+	for (i = 0; i < num_orders; i++)
+		ion_page_pool_set_watermark(heap->uncached_pools[i],
+					    pool_refill_watermark(i));
+
 	mutex_init(&heap->split_page_mutex);
 
 	heap->heap.debug_show = ion_system_heap_debug_show;
@@ -52,6 +52,9 @@
 #include <linux/circ_buf.h>
 #include <linux/proc_fs.h>
 #include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/almk.h>
@@ -394,6 +397,317 @@ static int test_task_state(struct task_struct *p, int state)
 
 static DEFINE_MUTEX(scan_mutex);
 
+/*
+ * Thread group leaders bucketed by oom_score_adj, so that victim
+ * selection only has to look at the buckets at or above min_score_adj
+ * rather than at every process in the system. Buckets are kept up to
+ * date from fork, exec, exit and the /proc oom_score_adj writers. A bit
+ * in lmk_adj_used is set whenever its bucket is populated and is only
+ * cleared lazily once a scan finds the bucket empty.
+ */
+#define LMK_ADJ_BUCKETS		(OOM_SCORE_ADJ_MAX - OOM_SCORE_ADJ_MIN + 1)
+#define LMK_MAX_CANDIDATES	32
+
+static struct hlist_head lmk_adj_buckets[LMK_ADJ_BUCKETS];
+static DECLARE_BITMAP(lmk_adj_used, LMK_ADJ_BUCKETS);
+static DEFINE_SPINLOCK(lmk_adj_lock);
+
+/* protected by scan_mutex */
+static struct task_struct *lmk_candidates[LMK_MAX_CANDIDATES];
+
+/*
+ * Last process killed, pinned until its mm is released or the
+ * deathpending timeout expires. Protected by scan_mutex.
+ */
+static struct task_struct *lowmem_last_victim;
+
+/*
+ * The TIF_MEMDIE check in the bucket walk only sees the buckets that are
+ * scanned, so a victim whose oom_score_adj lies below min_score_adj would
+ * not hold off the next kill. Check the last victim directly.
+ */
+static bool lowmem_last_victim_dying(void)
+{
+	struct task_struct *p = lowmem_last_victim;
+	bool dying;
+
+	if (!p)
+		return false;
+
+	rcu_read_lock();
+	dying = time_before_eq(jiffies, lowmem_deathpending_timeout) &&
+		pid_alive(p) && !test_task_flag(p, TIF_MM_RELEASED);
+	rcu_read_unlock();
+	if (dying)
+		return true;
+
+	put_task_struct(p);
+	lowmem_last_victim = NULL;
+	return false;
+}
+
+static inline int lmk_adj_bucket(short oom_score_adj)
+{
+	return oom_score_adj - OOM_SCORE_ADJ_MIN;
+}
+
+static void __lmk_adj_insert(struct task_struct *p)
+{
+	int bucket = lmk_adj_bucket(p->signal->oom_score_adj);
+
+	hlist_add_head(&p->lmk_adj_node, &lmk_adj_buckets[bucket]);
+	__set_bit(bucket, lmk_adj_used);
+}
+
+/*
+ * Kernel threads are indexed as well: one that execs a user binary
+ * drops PF_KTHREAD without passing through fork again. They are
+ * filtered out when candidates are collected.
+ */
+void lowmem_adj_index_add(struct task_struct *p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lmk_adj_lock, flags);
+	__lmk_adj_insert(p);
+	spin_unlock_irqrestore(&lmk_adj_lock, flags);
+}
+
+void lowmem_adj_index_del(struct task_struct *p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lmk_adj_lock, flags);
+	if (!hlist_unhashed(&p->lmk_adj_node))
+		hlist_del_init(&p->lmk_adj_node);
+	spin_unlock_irqrestore(&lmk_adj_lock, flags);
+}
+
+void lowmem_adj_index_update(struct task_struct *task)
+{
+	struct task_struct *p = task->group_leader;
+	unsigned long flags;
+
+	spin_lock_irqsave(&lmk_adj_lock, flags);
+	if (!hlist_unhashed(&p->lmk_adj_node)) {
+		hlist_del(&p->lmk_adj_node);
+		__lmk_adj_insert(p);
+	}
+	spin_unlock_irqrestore(&lmk_adj_lock, flags);
+}
+
+/* A non-leader thread has exec'd and taken over as group leader */
+void lowmem_adj_index_replace(struct task_struct *old, struct task_struct *new)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lmk_adj_lock, flags);
+	if (hlist_unhashed(&old->lmk_adj_node)) {
+		INIT_HLIST_NODE(&new->lmk_adj_node);
+	} else {
+		hlist_add_before(&new->lmk_adj_node, &old->lmk_adj_node);
+		hlist_del_init(&old->lmk_adj_node);
+	}
+	spin_unlock_irqrestore(&lmk_adj_lock, flags);
+}
+
+/*
+ * Take references on up to LMK_MAX_CANDIDATES user processes from the
+ * highest populated bucket between *bucket and @floor, skipping the
+ * first *skip entries of that bucket. The cursor is advanced so that the
+ * next call continues where this one stopped; *skip is left at 0 once
+ * the bucket the candidates came from has been exhausted.
+ *
+ * Only references are taken here. The caller inspects the candidates
+ * after dropping lmk_adj_lock, since task_lock nests outside it.
+ */
+static int lowmem_adj_index_collect(int *bucket, int floor, int *skip,
+				    struct task_struct **cand)
+{
+	struct task_struct *p;
+	unsigned long flags;
+	int limit = *bucket + 1;
+	int nr = 0, pos, b;
+
+	spin_lock_irqsave(&lmk_adj_lock, flags);
+	while (limit > floor) {
+		b = find_last_bit(lmk_adj_used, limit);
+		if (b == limit || b < floor)
+			break;
+
+		pos = 0;
+		hlist_for_each_entry(p, &lmk_adj_buckets[b], lmk_adj_node) {
+			if (pos++ < *skip || p->flags & PF_KTHREAD)
+				continue;
+			if (nr == LMK_MAX_CANDIDATES) {
+				*bucket = b;
+				*skip = pos - 1;
+				goto out;
+			}
+			get_task_struct(p);
+			cand[nr++] = p;
+		}
+
+		if (hlist_empty(&lmk_adj_buckets[b]))
+			__clear_bit(b, lmk_adj_used);
+		*skip = 0;
+		limit = b;
+		if (nr)
+			break;
+	}
+	*bucket = limit - 1;
+out:
+	spin_unlock_irqrestore(&lmk_adj_lock, flags);
+
+	return nr;
+}
+
+/*
+ * Kill latency bookkeeping: for the last LMK_KILL_STATS kills record when
+ * the shrinker was entered, when SIGKILL was sent and when the victim's
+ * address space was finally torn down.
+ */
+#define LMK_KILL_STATS	16
+
+struct lmk_kill_stat {
+	pid_t tgid;
+	short oom_score_adj;
+	unsigned long rss_kb;
+	u64 trigger_ns;
+	u64 kill_ns;
+	u64 freed_ns;
+};
+
+static struct lmk_kill_stat lmk_kill_stats[LMK_KILL_STATS];
+static unsigned int lmk_kill_head;
+static atomic_t lmk_kill_pending = ATOMIC_INIT(0);
+static DEFINE_SPINLOCK(lmk_kill_lock);
+
+static u64 lmk_kill_count;
+static u64 lmk_select_ns_total;
+static u64 lmk_select_ns_max;
+static u64 lmk_reclaim_count;
+static u64 lmk_reclaim_ns_total;
+static u64 lmk_reclaim_ns_max;
+
+static void lmk_kill_stat_record(struct task_struct *selected, short adj,
+				 int tasksize, u64 trigger_ns, u64 kill_ns)
+{
+	struct lmk_kill_stat *stat;
+	u64 delta = kill_ns - trigger_ns;
+
+	spin_lock(&lmk_kill_lock);
+	stat = &lmk_kill_stats[lmk_kill_head];
+	if (stat->kill_ns && !stat->freed_ns)
+		atomic_dec(&lmk_kill_pending);
+	stat->tgid = selected->tgid;
+	stat->oom_score_adj = adj;
+	stat->rss_kb = tasksize * (long)(PAGE_SIZE / 1024);
+	stat->trigger_ns = trigger_ns;
+	stat->kill_ns = kill_ns;
+	stat->freed_ns = 0;
+	lmk_kill_head = (lmk_kill_head + 1) % LMK_KILL_STATS;
+
+	lmk_kill_count++;
+	lmk_select_ns_total += delta;
+	if (delta > lmk_select_ns_max)
+		lmk_select_ns_max = delta;
+	atomic_inc(&lmk_kill_pending);
+	spin_unlock(&lmk_kill_lock);
+}
+
+void lowmem_victim_mm_exit(struct task_struct *tsk)
+{
+	struct lmk_kill_stat *stat;
+	u64 now, delta;
+	int i;
+
+	if (!atomic_read(&lmk_kill_pending))
+		return;
+
+	now = ktime_get_ns();
+	spin_lock(&lmk_kill_lock);
+	for (i = 0; i < LMK_KILL_STATS; i++) {
+		stat = &lmk_kill_stats[i];
+		if (!stat->kill_ns || stat->freed_ns || stat->tgid != tsk->tgid)
+			continue;
+
+		stat->freed_ns = now;
+		delta = now - stat->kill_ns;
+		lmk_reclaim_count++;
+		lmk_reclaim_ns_total += delta;
+		if (delta > lmk_reclaim_ns_max)
+			lmk_reclaim_ns_max = delta;
+		atomic_dec(&lmk_kill_pending);
+		break;
+	}
+	spin_unlock(&lmk_kill_lock);
+}
+
+static int lmk_kill_latency_show(struct seq_file *s, void *unused)
+{
+	struct lmk_kill_stat *stat;
+	unsigned int i, idx;
+
+	spin_lock(&lmk_kill_lock);
+	seq_printf(s, "kills: %llu\n", lmk_kill_count);
+	seq_printf(s, "trigger_to_kill_us: avg %llu max %llu\n",
+		   lmk_kill_count ?
+			div64_u64(lmk_select_ns_total, lmk_kill_count) /
+			NSEC_PER_USEC : 0,
+		   div64_u64(lmk_select_ns_max, NSEC_PER_USEC));
+	seq_printf(s, "kill_to_free_us: count %llu avg %llu max %llu\n",
+		   lmk_reclaim_count,
+		   lmk_reclaim_count ?
+			div64_u64(lmk_reclaim_ns_total, lmk_reclaim_count) /
+			NSEC_PER_USEC : 0,
+		   div64_u64(lmk_reclaim_ns_max, NSEC_PER_USEC));
+
+	seq_puts(s, "\n     tgid   adj     rss_kb  trigger_to_kill_us  kill_to_free_us\n");
+	for (i = 0; i < LMK_KILL_STATS; i++) {
+		idx = (lmk_kill_head + LMK_KILL_STATS - 1 - i) % LMK_KILL_STATS;
+		stat = &lmk_kill_stats[idx];
+		if (!stat->kill_ns)
+			continue;
+		seq_printf(s, "%9d %5hd %10lu %19llu ", stat->tgid,
+			   stat->oom_score_adj, stat->rss_kb,
+			   div64_u64(stat->kill_ns - stat->trigger_ns,
+				     NSEC_PER_USEC));
+		if (stat->freed_ns)
+			seq_printf(s, "%16llu\n",
+				   div64_u64(stat->freed_ns - stat->kill_ns,
+					     NSEC_PER_USEC));
+		else
+			seq_printf(s, "%16s\n", "pending");
+	}
+	spin_unlock(&lmk_kill_lock);
+
+	return 0;
+}
+
+static int lmk_kill_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lmk_kill_latency_show, inode->i_private);
+}
+
+static const struct file_operations lmk_kill_latency_fops = {
+	.open = lmk_kill_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void lmk_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("lowmemorykiller", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+	debugfs_create_file("kill_latency", S_IRUGO, dir, NULL,
+			    &lmk_kill_latency_fops);
+}
+
 int can_use_cma_pages(gfp_t gfp_mask)
 {
 	int can_use = 0;
@@ -567,6 +881,7 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 {
 	struct task_struct *tsk;
 	struct task_struct *selected = NULL;
+	struct task_struct **cand = lmk_candidates;
 	unsigned long rem = 0;
 	int tasksize;
 	int i;
@@ -580,10 +895,15 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 	int other_file;
 	int minfree_count_offset = 0;
 	int array_count = ARRAY_SIZE(lowmem_per_minfree_count);
+	int bucket, skip, nr;
+	bool dying = false;
+	u64 trigger_ns;
 
 	if (!mutex_trylock(&scan_mutex))
 		return 0;
 
+	trigger_ns = ktime_get_ns();
+
 	other_free = global_page_state(NR_FREE_PAGES);
 
 	if (global_page_state(NR_SHMEM) + total_swapcache_pages() <
@@ -629,53 +949,84 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 	}
 
 	selected_oom_score_adj = min_score_adj;
+	dying = lowmem_last_victim_dying();
 
-	rcu_read_lock();
-	for_each_process(tsk) {
-		struct task_struct *p;
-		short oom_score_adj;
-
-		if (tsk->flags & PF_KTHREAD)
-			continue;
-
-		/* if task no longer has any memory ignore it */
-		if (test_task_flag(tsk, TIF_MM_RELEASED))
-			continue;
+	/*
+	 * Walk the oom_score_adj index from the top down. The first bucket
+	 * holding a process with memory decides the victim; within it the
+	 * largest RSS wins, as before.
+	 */
+	bucket = LMK_ADJ_BUCKETS - 1;
+	skip = 0;
+	while (!dying &&
+	       (nr = lowmem_adj_index_collect(&bucket,
+					      lmk_adj_bucket(min_score_adj),
+					      &skip, cand))) {
+		rcu_read_lock();
+		for (i = 0; i < nr; i++) {
+			struct task_struct *p;
+			short oom_score_adj;
+
+			tsk = cand[i];
+
+			/* if task no longer has any memory ignore it */
+			if (test_task_flag(tsk, TIF_MM_RELEASED))
+				continue;
 
-		if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-			if (test_task_flag(tsk, TIF_MEMDIE)) {
-				rcu_read_unlock();
-				mutex_unlock(&scan_mutex);
-				return 0;
+			if (time_before_eq(jiffies,
+					   lowmem_deathpending_timeout)) {
+				if (test_task_flag(tsk, TIF_MEMDIE)) {
+					dying = true;
+					break;
+				}
 			}
-		}
 
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
+			p = find_lock_task_mm(tsk);
+			if (!p)
+				continue;
 
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(p->mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
+			oom_score_adj = p->signal->oom_score_adj;
+			if (oom_score_adj < min_score_adj) {
+				task_unlock(p);
 				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
+			}
+			tasksize = get_mm_rss(p->mm);
+			task_unlock(p);
+			if (tasksize <= 0)
 				continue;
+			if (selected) {
+				if (oom_score_adj < selected_oom_score_adj)
+					continue;
+				if (oom_score_adj == selected_oom_score_adj &&
+				    tasksize <= selected_tasksize)
+					continue;
+				put_task_struct(selected);
+			}
+			get_task_struct(p);
+			selected = p;
+			selected_tasksize = tasksize;
+			selected_oom_score_adj = oom_score_adj;
+			lowmem_print(3, "select '%s' (%d), adj %hd, size %d, to kill\n",
+				     p->comm, p->pid, oom_score_adj, tasksize);
 		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(3, "select '%s' (%d), adj %hd, size %d, to kill\n",
-			     p->comm, p->pid, oom_score_adj, tasksize);
+		rcu_read_unlock();
+
+		for (i = 0; i < nr; i++)
+			put_task_struct(cand[i]);
+
+		/* the rest of the bucket may still hold a larger process */
+		if (selected && !skip)
+			break;
 	}
+
+	if (dying) {
+		if (selected)
+			put_task_struct(selected);
+		mutex_unlock(&scan_mutex);
+		return 0;
+	}
+
+	rcu_read_lock();
 	if (selected) {
 		long cache_size, cache_limit, free;
 
@@ -686,6 +1037,7 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 				     selected->pid);
 			rcu_read_unlock();
 			mutex_unlock(&scan_mutex);
+			put_task_struct(selected);
 			return 0;
 		}
 
@@ -699,6 +1051,9 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		if (selected->mm)
 			mark_oom_victim(selected);
 		task_unlock(selected);
+		lmk_kill_stat_record(selected, selected_oom_score_adj,
+				     selected_tasksize, trigger_ns,
+				     ktime_get_ns());
 		cache_size = other_file * (long)(PAGE_SIZE / 1024);
 		cache_limit = minfree * (long)(PAGE_SIZE / 1024);
 		free = other_free * (long)(PAGE_SIZE / 1024);
@@ -737,9 +1092,12 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		}
 
 		lowmem_deathpending_timeout = jiffies + HZ;
+		if (lowmem_last_victim)
+			put_task_struct(lowmem_last_victim);
+		get_task_struct(selected);
+		lowmem_last_victim = selected;
 		rem += selected_tasksize;
 		rcu_read_unlock();
-		get_task_struct(selected);
 		/* give the system time to free up the memory */
 		msleep_interruptible(20);
 		trace_almk_shrink(selected_tasksize, ret,
@@ -773,6 +1131,7 @@ static int __init lowmem_init(void)
 	register_shrinker(&lowmem_shrinker);
 	vmpressure_notifier_register(&lmk_vmpr_nb);
 	lmk_event_init();
+	lmk_debugfs_init();
 	return 0;
 }
 device_initcall(lowmem_init);
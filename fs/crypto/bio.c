@@ -23,26 +23,75 @@
 #include <linux/module.h>
 #include <linux/bio.h>
 #include <linux/namei.h>
+#include <linux/page_runs.h>
+#include <crypto/skcipher.h>
 #include "fscrypt_private.h"
 
+/*
+ * Read bios with more than this many pages are split into slices which are
+ * decrypted on several CPUs at once.
+ */
+#define FSCRYPT_SLICE_PAGES	16
+
+/*
+ * Decrypt @nr pages of @inode in place, reusing one cipher request for all of
+ * them.  Pages which fail to decrypt get PG_error set.
+ */
+static void fscrypt_decrypt_pages(struct inode *inode, struct bio_vec *bv,
+				  unsigned int nr)
+{
+	const struct fscrypt_info *ci = inode->i_crypt_info;
+	struct skcipher_request *req;
+	DECLARE_CRYPTO_WAIT(wait);
+
+	req = skcipher_request_alloc(ci->ci_ctfm, GFP_NOFS);
+	if (!req) {
+		for (; nr; nr--, bv++)
+			SetPageError(bv->bv_page);
+		return;
+	}
+	skcipher_request_set_callback(req,
+			CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+			crypto_req_done, &wait);
+
+	for (; nr; nr--, bv++) {
+		struct page *page = bv->bv_page;
+		struct fscrypt_iv iv;
+		struct scatterlist sg;
+		int res;
+
+		fscrypt_generate_iv(&iv, page->index, ci);
+		sg_init_table(&sg, 1);
+		sg_set_page(&sg, page, PAGE_SIZE, 0);
+		skcipher_request_set_crypt(req, &sg, &sg, PAGE_SIZE, &iv);
+		res = crypto_wait_req(crypto_skcipher_decrypt(req), &wait);
+		if (res) {
+			fscrypt_err(inode->i_sb,
+				    "decryption failed for inode %lu, block %lu: %d",
+				    inode->i_ino, page->index, res);
+			WARN_ON_ONCE(1);
+			SetPageError(page);
+		}
+	}
+	skcipher_request_free(req);
+}
+
 static void __fscrypt_decrypt_bio(struct bio *bio, bool done)
 {
 	struct bio_vec *bv;
 	int i;
 
+	process_bio_page_runs(bio, fscrypt_decrypt_pages, FSCRYPT_SLICE_PAGES,
+			      fscrypt_slice_workqueue);
+	if (!done)
+		return;
+
 	bio_for_each_segment_all(bv, bio, i) {
 		struct page *page = bv->bv_page;
-		int ret = fscrypt_decrypt_page(page->mapping->host, page,
-				PAGE_SIZE, 0, page->index);
 
-		if (ret) {
-			WARN_ON_ONCE(1);
-			SetPageError(page);
-		} else if (done) {
+		if (!PageError(page))
 			SetPageUptodate(page);
-		}
-		if (done)
-			unlock_page(page);
+		unlock_page(page);
 	}
 }
 
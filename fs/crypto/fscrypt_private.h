@@ -96,9 +96,17 @@ static inline bool fscrypt_valid_enc_modes(u32 contents_mode,
 	return false;
 }
 
+struct fscrypt_iv {
+	__le64 index;
+	u8 padding[FS_IV_SIZE - sizeof(__le64)];
+};
+
 /* crypto.c */
 extern struct kmem_cache *fscrypt_info_cachep;
 extern int fscrypt_initialize(unsigned int cop_flags);
+extern struct workqueue_struct *fscrypt_slice_workqueue;
+extern void fscrypt_generate_iv(struct fscrypt_iv *iv, u64 lblk_num,
+				const struct fscrypt_info *ci);
 extern int fscrypt_do_page_crypto(const struct inode *inode,
 				  fscrypt_direction_t rw, u64 lblk_num,
 				  struct page *src_page,
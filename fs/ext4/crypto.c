@@ -35,6 +35,7 @@
 #include <linux/scatterlist.h>
 #include <linux/spinlock_types.h>
 #include <linux/namei.h>
+#include <linux/page_runs.h>
 
 #include "ext4_extents.h"
 #include "xattr.h"
@@ -143,6 +144,7 @@ out:
 }
 
 struct workqueue_struct *ext4_read_workqueue;
+static struct workqueue_struct *ext4_decrypt_slice_workqueue;
 static DEFINE_MUTEX(crypto_init);
 
 /**
@@ -161,6 +163,9 @@ void ext4_exit_crypto(void)
 	if (ext4_read_workqueue)
 		destroy_workqueue(ext4_read_workqueue);
 	ext4_read_workqueue = NULL;
+	if (ext4_decrypt_slice_workqueue)
+		destroy_workqueue(ext4_decrypt_slice_workqueue);
+	ext4_decrypt_slice_workqueue = NULL;
 	if (ext4_crypto_ctx_cachep)
 		kmem_cache_destroy(ext4_crypto_ctx_cachep);
 	ext4_crypto_ctx_cachep = NULL;
@@ -188,6 +193,15 @@ int ext4_init_crypto(void)
 	if (!ext4_read_workqueue)
 		goto fail;
 
+	/*
+	 * Slices of large read bios, see ext4_decrypt_bio().  The read work
+	 * waits for them, so they need a rescuer.
+	 */
+	ext4_decrypt_slice_workqueue = alloc_workqueue("ext4_crypto_slice",
+					WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+	if (!ext4_decrypt_slice_workqueue)
+		goto fail;
+
 	ext4_crypto_ctx_cachep = KMEM_CACHE(ext4_crypto_ctx,
 					    SLAB_RECLAIM_ACCOUNT);
 	if (!ext4_crypto_ctx_cachep)
@@ -389,6 +403,82 @@ int ext4_decrypt(struct page *page)
 				page->index, page, page, GFP_NOFS);
 }
 
+/*
+ * Read bios with more than this many pages are split into slices which are
+ * decrypted on several CPUs at once.
+ */
+#define EXT4_DECRYPT_SLICE_PAGES	16
+
+/*
+ * Decrypt @nr pages of @inode in place, reusing one cipher request for all of
+ * them.  Pages which fail to decrypt get PG_error set.
+ */
+static void ext4_decrypt_pages(struct inode *inode, struct bio_vec *bv,
+			       unsigned int nr)
+{
+	struct crypto_ablkcipher *tfm = EXT4_I(inode)->i_crypt_info->ci_ctfm;
+	struct ablkcipher_request *req;
+	DECLARE_EXT4_COMPLETION_RESULT(ecr);
+
+	req = ablkcipher_request_alloc(tfm, GFP_NOFS);
+	if (!req) {
+		printk_ratelimited(KERN_ERR
+				   "%s: crypto_request_alloc() failed\n",
+				   __func__);
+		for (; nr; nr--, bv++)
+			SetPageError(bv->bv_page);
+		return;
+	}
+	ablkcipher_request_set_callback(
+		req, CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+		ext4_crypt_complete, &ecr);
+
+	for (; nr; nr--, bv++) {
+		struct page *page = bv->bv_page;
+		pgoff_t index = page->index;
+		u8 xts_tweak[EXT4_XTS_TWEAK_SIZE];
+		struct scatterlist sg;
+		int res;
+
+		memcpy(xts_tweak, &index, sizeof(index));
+		memset(&xts_tweak[sizeof(index)], 0,
+		       EXT4_XTS_TWEAK_SIZE - sizeof(index));
+
+		sg_init_table(&sg, 1);
+		sg_set_page(&sg, page, PAGE_CACHE_SIZE, 0);
+		ablkcipher_request_set_crypt(req, &sg, &sg, PAGE_CACHE_SIZE,
+					     xts_tweak);
+		res = crypto_ablkcipher_decrypt(req);
+		if (res == -EINPROGRESS || res == -EBUSY) {
+			wait_for_completion(&ecr.completion);
+			reinit_completion(&ecr.completion);
+			res = ecr.res;
+		}
+		if (res) {
+			printk_ratelimited(KERN_ERR
+				"%s: crypto_ablkcipher_decrypt() returned %d\n",
+				__func__, res);
+			WARN_ON_ONCE(1);
+			SetPageError(page);
+		}
+	}
+	ablkcipher_request_free(req);
+}
+
+/**
+ * ext4_decrypt_bio() - Decrypts all pages of a read bio in-place
+ * @bio: The completed read bio.  Its pages must be locked.
+ *
+ * Large bios are decrypted on several CPUs, see process_bio_page_runs().
+ * Pages which fail to decrypt get PG_error set.
+ */
+void ext4_decrypt_bio(struct bio *bio)
+{
+	process_bio_page_runs(bio, ext4_decrypt_pages,
+			      EXT4_DECRYPT_SLICE_PAGES,
+			      ext4_decrypt_slice_workqueue);
+}
+
 int ext4_encrypted_zeroout(struct inode *inode, ext4_lblk_t lblk,
 			   ext4_fsblk_t pblk, ext4_lblk_t len)
 {
@@ -49,8 +49,8 @@
 #include <trace/events/android_fs.h>
 
 /*
- * Call ext4_decrypt on every single page, reusing the encryption
- * context.
+ * Decrypt the whole bio in one go, reusing the encryption context, then
+ * complete its pages.
  */
 static void completion_pages(struct work_struct *work)
 {
@@ -61,20 +61,14 @@ static void completion_pages(struct work_struct *work)
 	struct bio_vec	*bv;
 	int		i;
 
+	if (!ext4_is_ice_enabled())
+		ext4_decrypt_bio(bio);
+
 	bio_for_each_segment_all(bv, bio, i) {
 		struct page *page = bv->bv_page;
 
-		if (ext4_is_ice_enabled()) {
+		if (!PageError(page))
 			SetPageUptodate(page);
-		} else {
-			int ret = ext4_decrypt(page);
-
-			if (ret) {
-				WARN_ON_ONCE(1);
-				SetPageError(page);
-			} else
-				SetPageUptodate(page);
-		}
 		unlock_page(page);
 	}
 	ext4_release_crypto_ctx(ctx);
@@ -18,10 +18,12 @@
 #include <linux/pagemap.h>
 #include <linux/file.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/pipe_fs_i.h>
 #include <linux/swap.h>
 #include <linux/splice.h>
 #include <linux/freezer.h>
+#include <linux/percpu.h>
 
 MODULE_ALIAS_MISCDEV(FUSE_MINOR);
 MODULE_ALIAS("devname:fuse");
@@ -337,18 +339,116 @@ static unsigned len_args(unsigned numargs, struct fuse_arg *args)
 
 static u64 fuse_get_unique(struct fuse_iqueue *fiq)
 {
-	return ++fiq->reqctr;
+	return atomic64_inc_return(&fiq->reqctr);
+}
+
+static bool fuse_cpu_pending(struct fuse_iqueue *fiq)
+{
+	return atomic_read(&fiq->nr_cpu_pending) != 0;
+}
+
+/*
+ * Wake an idle reader bound to a CPU other than @self, so that it steals
+ * work which the readers at hand are too busy to pick up. Returns false
+ * if no bound reader was waiting.
+ */
+static bool fuse_kick_idle(struct fuse_iqueue *fiq, int self)
+{
+	struct fuse_cpu_queue *cq;
+	int i, cpu;
+
+	/*
+	 * Pairs with set_current_state() in fuse_cpu_queue_wait(): either we
+	 * see the reader on the wait queue, or it sees the work we queued.
+	 */
+	smp_mb();
+	for (i = 1; i <= nr_cpu_ids; i++) {
+		cpu = (self + i) % nr_cpu_ids;
+		if (cpu == self || !cpu_possible(cpu))
+			continue;
+
+		cq = per_cpu_ptr(fiq->cpu_queues, cpu);
+		if (!waitqueue_active(&cq->waitq))
+			continue;
+
+		spin_lock(&cq->waitq.lock);
+		if (waitqueue_active(&cq->waitq)) {
+			cq->steal = 1;
+			wake_up_locked(&cq->waitq);
+			spin_unlock(&cq->waitq.lock);
+			return true;
+		}
+		spin_unlock(&cq->waitq.lock);
+	}
+	return false;
+}
+
+/*
+ * Called with fiq->waitq.lock held. If no unbound reader is waiting,
+ * get a bound one to come and look.
+ */
+static void fuse_iqueue_wake(struct fuse_iqueue *fiq)
+{
+	if (waitqueue_active(&fiq->waitq))
+		wake_up_locked(&fiq->waitq);
+	else if (fiq->cpu_queues)
+		fuse_kick_idle(fiq, -1);
 }
 
 static void queue_request(struct fuse_iqueue *fiq, struct fuse_req *req)
 {
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
+	req->cq = NULL;
 	list_add_tail(&req->list, &fiq->pending);
-	wake_up_locked(&fiq->waitq);
+	fuse_iqueue_wake(fiq);
 	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
 }
 
+/*
+ * Queue @req for the daemon thread serving the current CPU, if a device
+ * is bound to it. Returns false if the request has to go to fc->iq.
+ */
+static bool queue_request_cpu(struct fuse_iqueue *fiq, struct fuse_req *req)
+{
+	struct fuse_cpu_queue __percpu *cqs = READ_ONCE(fiq->cpu_queues);
+	struct fuse_cpu_queue *cq;
+	bool idle;
+	int cpu;
+
+	if (!cqs)
+		return false;
+
+	cpu = raw_smp_processor_id();
+	cq = per_cpu_ptr(cqs, cpu);
+	if (!READ_ONCE(cq->nr_devs))
+		return false;
+
+	req->in.h.len = sizeof(struct fuse_in_header) +
+		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
+	req->in.h.unique = fuse_get_unique(fiq);
+
+	spin_lock(&cq->waitq.lock);
+	if (!cq->connected || !cq->nr_devs) {
+		spin_unlock(&cq->waitq.lock);
+		return false;
+	}
+	req->cq = cq;
+	list_add_tail(&req->list, &cq->pending);
+	atomic_inc(&fiq->nr_cpu_pending);
+	idle = waitqueue_active(&cq->waitq);
+	if (idle)
+		wake_up_locked(&cq->waitq);
+	spin_unlock(&cq->waitq.lock);
+
+	/* no bound reader at hand, unbound readers steal as well */
+	if (!idle && !fuse_kick_idle(fiq, cpu))
+		wake_up(&fiq->waitq);
+	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+
+	return true;
+}
+
 void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 		       u64 nodeid, u64 nlookup)
 {
@@ -361,7 +461,7 @@ void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 	if (fiq->connected) {
 		fiq->forget_list_tail->next = forget;
 		fiq->forget_list_tail = forget;
-		wake_up_locked(&fiq->waitq);
+		fuse_iqueue_wake(fiq);
 		kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
 	} else {
 		kfree(forget);
@@ -379,6 +479,8 @@ static void flush_bg_queue(struct fuse_conn *fc)
 		req = list_entry(fc->bg_queue.next, struct fuse_req, list);
 		list_del(&req->list);
 		fc->active_background++;
+		if (queue_request_cpu(fiq, req))
+			continue;
 		spin_lock(&fiq->waitq.lock);
 		req->in.h.unique = fuse_get_unique(fiq);
 		queue_request(fiq, req);
@@ -449,7 +551,7 @@ static void queue_interrupt(struct fuse_iqueue *fiq, struct fuse_req *req)
 	}
 	if (list_empty(&req->intr_entry)) {
 		list_add_tail(&req->intr_entry, &fiq->interrupts);
-		wake_up_locked(&fiq->waitq);
+		fuse_iqueue_wake(fiq);
 	}
 	spin_unlock(&fiq->waitq.lock);
 	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
@@ -475,6 +577,7 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 	}
 
 	if (!test_bit(FR_FORCE, &req->flags)) {
+		struct fuse_cpu_queue *cq;
 		sigset_t oldset;
 
 		/* Only fatal signals may interrupt this */
@@ -486,15 +589,29 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 		if (!err)
 			return;
 
+		/*
+		 * req->cq is set before the request is queued. After that it
+		 * is only changed by fuse_dev_unbind_cpu(), which holds both
+		 * fiq->waitq.lock and the per-CPU queue lock.
+		 */
 		spin_lock(&fiq->waitq.lock);
+		cq = req->cq;
+		if (cq)
+			spin_lock(&cq->waitq.lock);
 		/* Request is not yet in userspace, bail out */
 		if (test_bit(FR_PENDING, &req->flags)) {
 			list_del(&req->list);
+			if (cq)
+				atomic_dec(&fiq->nr_cpu_pending);
+			if (cq)
+				spin_unlock(&cq->waitq.lock);
 			spin_unlock(&fiq->waitq.lock);
 			__fuse_put_request(req);
 			req->out.h.error = -EINTR;
 			return;
 		}
+		if (cq)
+			spin_unlock(&cq->waitq.lock);
 		spin_unlock(&fiq->waitq.lock);
 	}
 
@@ -512,22 +629,25 @@ static void __fuse_request_send(struct fuse_conn *fc, struct fuse_req *req)
 	struct fuse_iqueue *fiq = &fc->iq;
 
 	BUG_ON(test_bit(FR_BACKGROUND, &req->flags));
-	spin_lock(&fiq->waitq.lock);
-	if (!fiq->connected) {
-		spin_unlock(&fiq->waitq.lock);
-		req->out.h.error = -ENOTCONN;
-	} else {
+	/* acquire extra reference, since request is still needed
+	   after request_end() */
+	__fuse_get_request(req);
+	if (!queue_request_cpu(fiq, req)) {
+		spin_lock(&fiq->waitq.lock);
+		if (!fiq->connected) {
+			spin_unlock(&fiq->waitq.lock);
+			__fuse_put_request(req);
+			req->out.h.error = -ENOTCONN;
+			return;
+		}
 		req->in.h.unique = fuse_get_unique(fiq);
 		queue_request(fiq, req);
-		/* acquire extra reference, since request is still needed
-		   after request_end() */
-		__fuse_get_request(req);
 		spin_unlock(&fiq->waitq.lock);
-
-		request_wait_answer(fc, req);
-		/* Pairs with smp_wmb() in request_end() */
-		smp_rmb();
 	}
+
+	request_wait_answer(fc, req);
+	/* Pairs with smp_wmb() in request_end() */
+	smp_rmb();
 }
 
 void fuse_request_send(struct fuse_conn *fc, struct fuse_req *req)
@@ -1258,6 +1378,85 @@ __releases(fiq->waitq.lock)
 		return fuse_read_batch_forget(fiq, cs, nbytes);
 }
 
+static struct fuse_req *fuse_cpu_queue_pop(struct fuse_iqueue *fiq,
+					   struct fuse_cpu_queue *cq)
+{
+	struct fuse_req *req = NULL;
+
+	spin_lock(&cq->waitq.lock);
+	if (!list_empty(&cq->pending)) {
+		req = list_first_entry(&cq->pending, struct fuse_req, list);
+		clear_bit(FR_PENDING, &req->flags);
+		list_del_init(&req->list);
+		atomic_dec(&fiq->nr_cpu_pending);
+	}
+	spin_unlock(&cq->waitq.lock);
+
+	return req;
+}
+
+/*
+ * Take a request queued for a CPU whose readers are busy, skipping the
+ * queue @self of a bound reader.  Start with the CPU next to ours so
+ * that idle readers spread out.
+ */
+static struct fuse_req *fuse_steal_request(struct fuse_iqueue *fiq,
+					   struct fuse_cpu_queue *self)
+{
+	struct fuse_cpu_queue *cq;
+	struct fuse_req *req;
+	int i, cpu, this_cpu = raw_smp_processor_id();
+
+	for (i = 1; i <= nr_cpu_ids; i++) {
+		cpu = (this_cpu + i) % nr_cpu_ids;
+		if (!cpu_possible(cpu))
+			continue;
+
+		cq = per_cpu_ptr(fiq->cpu_queues, cpu);
+		if (cq == self || list_empty(&cq->pending))
+			continue;
+
+		req = fuse_cpu_queue_pop(fiq, cq);
+		if (req)
+			return req;
+	}
+	return NULL;
+}
+
+static bool fuse_cpu_queue_ready(struct fuse_iqueue *fiq,
+				 struct fuse_cpu_queue *cq)
+{
+	return !cq->connected || cq->steal || request_pending(fiq) ||
+		fuse_cpu_pending(fiq);
+}
+
+/*
+ * Wait until there is work for a reader bound to @cq.  Not using the
+ * _locked wait variant: fuse_kick_idle() relies on the reader being on
+ * the wait queue before it rechecks fc->iq.
+ */
+static int fuse_cpu_queue_wait(struct fuse_iqueue *fiq,
+			       struct fuse_cpu_queue *cq, struct file *file)
+{
+	int err;
+
+	if ((file->f_flags & O_NONBLOCK) && !fuse_cpu_queue_ready(fiq, cq))
+		return -EAGAIN;
+
+	err = wait_event_interruptible_exclusive(cq->waitq,
+					fuse_cpu_queue_ready(fiq, cq));
+	if (err)
+		return err;
+
+	spin_lock(&cq->waitq.lock);
+	cq->steal = 0;
+	if (!cq->connected)
+		err = -ENODEV;
+	spin_unlock(&cq->waitq.lock);
+
+	return err;
+}
+
 /*
  * Read a single request into the userspace filesystem's buffer.  This
  * function waits until a request is available, then removes it from
@@ -1266,6 +1465,9 @@ __releases(fiq->waitq.lock)
  * was an error during the copying then it's finished by calling
  * request_end().  Otherwise add it to the processing list, and set
  * the 'sent' flag.
+ *
+ * A device bound to a CPU reads from that CPU's queue first, then from
+ * fc->iq, and finally steals from the other CPUs before going to sleep.
  */
 static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 				struct fuse_copy_state *cs, size_t nbytes)
@@ -1274,19 +1476,44 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 	struct fuse_conn *fc = fud->fc;
 	struct fuse_iqueue *fiq = &fc->iq;
 	struct fuse_pqueue *fpq = &fud->pq;
+	struct fuse_cpu_queue *cq;
 	struct fuse_req *req;
 	struct fuse_in *in;
 	unsigned reqsize;
 
  restart:
+	cq = READ_ONCE(fud->cq);
+	if (cq) {
+		req = fuse_cpu_queue_pop(fiq, cq);
+		if (req)
+			goto dispatch;
+
+		if (request_pending(fiq)) {
+			spin_lock(&fiq->waitq.lock);
+			if (fiq->connected && request_pending(fiq))
+				goto dispatch_iq;
+			spin_unlock(&fiq->waitq.lock);
+		}
+
+		req = fuse_steal_request(fiq, cq);
+		if (req)
+			goto dispatch;
+
+		err = fuse_cpu_queue_wait(fiq, cq, file);
+		if (err)
+			return err;
+		goto restart;
+	}
+
 	spin_lock(&fiq->waitq.lock);
 	err = -EAGAIN;
 	if ((file->f_flags & O_NONBLOCK) && fiq->connected &&
-	    !request_pending(fiq))
+	    !request_pending(fiq) && !fuse_cpu_pending(fiq))
 		goto err_unlock;
 
 	err = wait_event_interruptible_exclusive_locked(fiq->waitq,
-				!fiq->connected || request_pending(fiq));
+				!fiq->connected || request_pending(fiq) ||
+				fuse_cpu_pending(fiq));
 	if (err)
 		goto err_unlock;
 
@@ -1294,6 +1521,16 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 	if (!fiq->connected)
 		goto err_unlock;
 
+	if (!request_pending(fiq)) {
+		/* only the per-CPU queues have work, whose readers are busy */
+		spin_unlock(&fiq->waitq.lock);
+		req = fuse_steal_request(fiq, NULL);
+		if (req)
+			goto dispatch;
+		goto restart;
+	}
+
+ dispatch_iq:
 	if (!list_empty(&fiq->interrupts)) {
 		req = list_entry(fiq->interrupts.next, struct fuse_req,
 				 intr_entry);
@@ -1313,6 +1550,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 	list_del_init(&req->list);
 	spin_unlock(&fiq->waitq.lock);
 
+ dispatch:
 	in = &req->in;
 	reqsize = in->h.len;
 	/* If request is too large, reply with an error and restart the read */
@@ -1630,6 +1868,193 @@ err:
 	return err;
 }
 
+/*
+ * Point @name at the NUL terminated name following a notification header
+ * of @hdrsize bytes in @buf.
+ */
+static int fuse_notify_buf_name(void *buf, unsigned int size,
+				unsigned int hdrsize, u32 namelen,
+				struct qstr *name)
+{
+	char *p = buf + hdrsize;
+
+	if (namelen > FUSE_NAME_MAX)
+		return -ENAMETOOLONG;
+	if (size != hdrsize + namelen + 1)
+		return -EINVAL;
+
+	p[namelen] = 0;
+	name->name = p;
+	name->len = namelen;
+	name->hash = full_name_hash(name->name, name->len);
+	return 0;
+}
+
+/*
+ * Apply one notification that has already been copied into @buf.  Called
+ * with fc->killsb held for read and fc->sb set.
+ */
+static int fuse_notify_buf(struct fuse_conn *fc, u32 code, void *buf,
+			   unsigned int size)
+{
+	struct super_block *sb = fc->sb;
+	struct qstr name;
+	int err;
+
+	switch (code) {
+	case FUSE_NOTIFY_INVAL_INODE: {
+		struct fuse_notify_inval_inode_out *arg = buf;
+
+		if (size != sizeof(*arg))
+			return -EINVAL;
+		return fuse_reverse_inval_inode(sb, arg->ino, arg->off,
+						arg->len);
+	}
+	case FUSE_NOTIFY_INVAL_ENTRY: {
+		struct fuse_notify_inval_entry_out *arg = buf;
+
+		if (size < sizeof(*arg))
+			return -EINVAL;
+		err = fuse_notify_buf_name(buf, size, sizeof(*arg),
+					   arg->namelen, &name);
+		if (err)
+			return err;
+		return fuse_reverse_inval_entry(sb, arg->parent, 0, &name);
+	}
+	case FUSE_NOTIFY_DELETE: {
+		struct fuse_notify_delete_out *arg = buf;
+
+		if (size < sizeof(*arg))
+			return -EINVAL;
+		err = fuse_notify_buf_name(buf, size, sizeof(*arg),
+					   arg->namelen, &name);
+		if (err)
+			return err;
+		return fuse_reverse_inval_entry(sb, arg->parent, arg->child,
+						&name);
+	}
+	case FUSE_NOTIFY_ENTRY: {
+		struct fuse_notify_entry_out *arg = buf;
+
+		if (size < sizeof(*arg))
+			return -EINVAL;
+		err = fuse_notify_buf_name(buf, size, sizeof(*arg),
+					   arg->namelen, &name);
+		if (err)
+			return err;
+		return fuse_reverse_link_entry(sb, arg->parent, &name,
+					       &arg->entry);
+	}
+	default:
+		return -EINVAL;
+	}
+}
+
+static int fuse_notify_entry(struct fuse_conn *fc, unsigned int size,
+			     struct fuse_copy_state *cs)
+{
+	void *buf = NULL;
+	int err = -EINVAL;
+
+	if (size < sizeof(struct fuse_notify_entry_out) ||
+	    size > sizeof(struct fuse_notify_entry_out) + FUSE_NAME_MAX + 1)
+		goto err;
+
+	err = -ENOMEM;
+	buf = kmalloc(size, GFP_KERNEL);
+	if (!buf)
+		goto err;
+
+	err = fuse_copy_one(cs, buf, size);
+	if (err)
+		goto err;
+	fuse_copy_finish(cs);
+
+	down_read(&fc->killsb);
+	err = -ENOENT;
+	if (fc->sb)
+		err = fuse_notify_buf(fc, FUSE_NOTIFY_ENTRY, buf, size);
+	up_read(&fc->killsb);
+	kfree(buf);
+	return err;
+
+err:
+	kfree(buf);
+	fuse_copy_finish(cs);
+	return err;
+}
+
+/*
+ * Apply a batch of cache notifications under a single killsb acquisition
+ * and a single write(2).  A malformed record stops the batch; otherwise
+ * every record is applied and the first error other than -ENOENT (the
+ * object isn't cached, so there was nothing to do) is returned.
+ */
+static int fuse_notify_batch(struct fuse_conn *fc, unsigned int size,
+			     struct fuse_copy_state *cs)
+{
+	struct fuse_notify_batch_out *outarg;
+	struct fuse_notify_batch_rec *rec;
+	void *buf = NULL;
+	unsigned int pos;
+	u32 i;
+	int err = -EINVAL;
+
+	if (size < sizeof(*outarg) || size > FUSE_NOTIFY_BATCH_MAX)
+		goto err;
+
+	err = -ENOMEM;
+	buf = vmalloc(size);
+	if (!buf)
+		goto err;
+
+	err = fuse_copy_one(cs, buf, size);
+	if (err)
+		goto err;
+	fuse_copy_finish(cs);
+
+	outarg = buf;
+	pos = sizeof(*outarg);
+
+	down_read(&fc->killsb);
+	err = -ENOENT;
+	if (!fc->sb)
+		goto out_unlock;
+
+	err = 0;
+	for (i = 0; i < outarg->count; i++) {
+		int ret;
+
+		if (size - pos < sizeof(*rec)) {
+			err = -EINVAL;
+			break;
+		}
+		rec = buf + pos;
+		pos += sizeof(*rec);
+		if (rec->size > size - pos) {
+			err = -EINVAL;
+			break;
+		}
+
+		ret = fuse_notify_buf(fc, rec->code, buf + pos, rec->size);
+		if (ret && ret != -ENOENT && !err)
+			err = ret;
+
+		pos = min_t(unsigned int, size,
+			    pos + FUSE_DIRENT_ALIGN(rec->size));
+	}
+
+out_unlock:
+	up_read(&fc->killsb);
+	vfree(buf);
+	return err;
+
+err:
+	vfree(buf);
+	fuse_copy_finish(cs);
+	return err;
+}
+
 static int fuse_notify_store(struct fuse_conn *fc, unsigned int size,
 			     struct fuse_copy_state *cs)
 {
@@ -1854,10 +2279,19 @@ static int fuse_notify(struct fuse_conn *fc, enum fuse_notify_code code,
 	case FUSE_NOTIFY_DELETE:
 		return fuse_notify_delete(fc, size, cs);
 
-	default:
-		fuse_copy_finish(cs);
-		return -EINVAL;
+	case FUSE_NOTIFY_ENTRY:
+		if (!fc->persistent_cache)
+			break;
+		return fuse_notify_entry(fc, size, cs);
+
+	case FUSE_NOTIFY_BATCH:
+		if (!fc->persistent_cache)
+			break;
+		return fuse_notify_batch(fc, size, cs);
 	}
+
+	fuse_copy_finish(cs);
+	return -EINVAL;
 }
 
 /* Look up request on processing list by unique ID */
@@ -2110,6 +2544,7 @@ static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 {
 	unsigned mask = POLLOUT | POLLWRNORM;
 	struct fuse_iqueue *fiq;
+	struct fuse_cpu_queue *cq;
 	struct fuse_dev *fud = fuse_get_dev(file);
 
 	if (!fud)
@@ -2117,11 +2552,14 @@ static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 
 	fiq = &fud->fc->iq;
 	poll_wait(file, &fiq->waitq, wait);
+	cq = READ_ONCE(fud->cq);
+	if (cq)
+		poll_wait(file, &cq->waitq, wait);
 
 	spin_lock(&fiq->waitq.lock);
 	if (!fiq->connected)
 		mask = POLLERR;
-	else if (request_pending(fiq))
+	else if (request_pending(fiq) || fuse_cpu_pending(fiq))
 		mask |= POLLIN | POLLRDNORM;
 	spin_unlock(&fiq->waitq.lock);
 
@@ -2217,6 +2655,21 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		spin_lock(&fiq->waitq.lock);
 		fiq->connected = 0;
 		list_splice_init(&fiq->pending, &to_end2);
+		if (fiq->cpu_queues) {
+			int cpu;
+
+			for_each_possible_cpu(cpu) {
+				struct fuse_cpu_queue *cq;
+
+				cq = per_cpu_ptr(fiq->cpu_queues, cpu);
+				spin_lock(&cq->waitq.lock);
+				cq->connected = 0;
+				list_splice_init(&cq->pending, &to_end2);
+				wake_up_all_locked(&cq->waitq);
+				spin_unlock(&cq->waitq.lock);
+			}
+			atomic_set(&fiq->nr_cpu_pending, 0);
+		}
 		list_for_each_entry(req, &to_end2, list)
 			clear_bit(FR_PENDING, &req->flags);
 		while (forget_pending(fiq))
@@ -2247,6 +2700,114 @@ void fuse_wait_aborted(struct fuse_conn *fc)
 	wait_event(fc->blocked_waitq, atomic_read(&fc->num_waiting) == 0);
 }
 
+/*
+ * Allocate the per-CPU queues on first use, so that connections whose
+ * daemon never binds a device don't pay for them.
+ */
+static int fuse_iqueue_alloc_cpu_queues(struct fuse_iqueue *fiq)
+{
+	struct fuse_cpu_queue __percpu *cqs;
+	int cpu, err = 0;
+
+	if (READ_ONCE(fiq->cpu_queues))
+		return 0;
+
+	cqs = alloc_percpu(struct fuse_cpu_queue);
+	if (!cqs)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct fuse_cpu_queue *cq = per_cpu_ptr(cqs, cpu);
+
+		init_waitqueue_head(&cq->waitq);
+		INIT_LIST_HEAD(&cq->pending);
+		cq->connected = 1;
+	}
+
+	/* fuse_abort_conn() checks for the queues under this lock */
+	spin_lock(&fiq->waitq.lock);
+	if (!fiq->connected) {
+		err = -ENODEV;
+	} else if (!fiq->cpu_queues) {
+		smp_store_release(&fiq->cpu_queues, cqs);
+		cqs = NULL;
+	}
+	spin_unlock(&fiq->waitq.lock);
+	free_percpu(cqs);
+
+	return err;
+}
+
+/*
+ * Stop serving the per-CPU queue @fud is bound to.  Requests left there
+ * with no reader to serve them are moved over to fc->iq.
+ */
+static void fuse_dev_unbind_cpu(struct fuse_dev *fud)
+{
+	struct fuse_iqueue *fiq = &fud->fc->iq;
+	struct fuse_cpu_queue *cq = fud->cq;
+	struct fuse_req *req;
+	int moved = 0;
+
+	if (!cq)
+		return;
+
+	WRITE_ONCE(fud->cq, NULL);
+
+	spin_lock(&fiq->waitq.lock);
+	spin_lock(&cq->waitq.lock);
+	if (!--cq->nr_devs && !list_empty(&cq->pending)) {
+		list_for_each_entry(req, &cq->pending, list) {
+			req->cq = NULL;
+			moved++;
+		}
+		list_splice_tail_init(&cq->pending, &fiq->pending);
+		atomic_sub(moved, &fiq->nr_cpu_pending);
+	}
+	/* readers blocked on this device have to notice the change */
+	cq->steal = 1;
+	wake_up_all_locked(&cq->waitq);
+	spin_unlock(&cq->waitq.lock);
+	if (moved)
+		fuse_iqueue_wake(fiq);
+	spin_unlock(&fiq->waitq.lock);
+}
+
+/*
+ * Bind @fud to the queue of @cpu, or unbind it if @cpu is -1.  Requests
+ * submitted on that CPU are then read from this device; the daemon is
+ * expected to read it from a thread pinned to the same CPU.
+ */
+static int fuse_dev_bind_cpu(struct fuse_dev *fud, int cpu)
+{
+	struct fuse_iqueue *fiq = &fud->fc->iq;
+	struct fuse_cpu_queue *cq;
+	int err;
+
+	if (cpu != -1 && (cpu < 0 || cpu >= nr_cpu_ids || !cpu_possible(cpu)))
+		return -EINVAL;
+
+	err = fuse_iqueue_alloc_cpu_queues(fiq);
+	if (err)
+		return err;
+
+	fuse_dev_unbind_cpu(fud);
+	if (cpu == -1)
+		return 0;
+
+	cq = per_cpu_ptr(fiq->cpu_queues, cpu);
+	spin_lock(&cq->waitq.lock);
+	if (!cq->connected) {
+		spin_unlock(&cq->waitq.lock);
+		return -ENODEV;
+	}
+	cq->nr_devs++;
+	spin_unlock(&cq->waitq.lock);
+	WRITE_ONCE(fud->cq, cq);
+
+	return 0;
+}
+
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
 	struct fuse_dev *fud = fuse_get_dev(file);
@@ -2256,6 +2817,8 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 		struct fuse_pqueue *fpq = &fud->pq;
 		LIST_HEAD(to_end);
 
+		fuse_dev_unbind_cpu(fud);
+
 		spin_lock(&fpq->lock);
 		WARN_ON(!list_empty(&fpq->io));
 		list_splice_init(&fpq->processing, &to_end);
@@ -2334,6 +2897,19 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 				fput(old);
 			}
 		}
+	} else if (cmd == FUSE_DEV_IOC_BIND_CPU) {
+		struct fuse_dev *fud = fuse_get_dev(file);
+		int cpu;
+
+		err = -EINVAL;
+		if (fud && file->f_op == &fuse_dev_operations) {
+			err = -EFAULT;
+			if (!get_user(cpu, (__u32 __user *) arg)) {
+				mutex_lock(&fuse_mutex);
+				err = fuse_dev_bind_cpu(fud, cpu);
+				mutex_unlock(&fuse_mutex);
+			}
+		}
 	}
 	return err;
 }
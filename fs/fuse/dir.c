@@ -7,6 +7,7 @@
 */
 
 #include "fuse_i.h"
+#include "fuse_passthrough.h"
 
 #include <linux/pagemap.h>
 #include <linux/file.h>
@@ -71,10 +72,15 @@ static u64 fuse_dentry_time(struct dentry *entry)
  */
 
 /*
- * Calculate the time in jiffies until a dentry/attributes are valid
+ * Calculate the time in jiffies until a dentry/attributes are valid.
+ *
+ * The timeouts are checked with time_before64(), so "forever" must stay
+ * within half the jiffies range of now; ~0ULL would read as long expired.
  */
-static u64 time_to_jiffies(unsigned long sec, unsigned long nsec)
+static u64 time_to_jiffies(u64 sec, unsigned long nsec)
 {
+	if (sec == FUSE_VALID_FOREVER)
+		return get_jiffies_64() + (U64_MAX >> 2);
 	if (sec || nsec) {
 		struct timespec ts = {sec, nsec};
 		return get_jiffies_64() + timespec_to_jiffies(&ts);
@@ -1216,43 +1222,21 @@ static int parse_dirfile(char *buf, size_t nbytes, struct file *file,
 	return 0;
 }
 
-static int fuse_direntplus_link(struct file *file,
-				struct fuse_direntplus *direntplus,
-				u64 attr_version)
+/*
+ * Instantiate or refresh the dentry @name under @parent from a lookup
+ * result that did not come from a lookup: READDIRPLUS or
+ * FUSE_NOTIFY_ENTRY.  Called with the parent's i_mutex held.
+ */
+static int fuse_link_entry(struct dentry *parent, struct qstr *name,
+			   struct fuse_entry_out *o, u64 attr_version)
 {
 	int err;
-	struct fuse_entry_out *o = &direntplus->entry_out;
-	struct fuse_dirent *dirent = &direntplus->dirent;
-	struct dentry *parent = file->f_path.dentry;
-	struct qstr name = QSTR_INIT(dirent->name, dirent->namelen);
 	struct dentry *dentry;
 	struct dentry *alias;
 	struct inode *dir = d_inode(parent);
 	struct fuse_conn *fc;
 	struct inode *inode;
 
-	if (!o->nodeid) {
-		/*
-		 * Unlike in the case of fuse_lookup, zero nodeid does not mean
-		 * ENOENT. Instead, it only means the userspace filesystem did
-		 * not want to return attributes/handle for this entry.
-		 *
-		 * So do nothing.
-		 */
-		return 0;
-	}
-
-	if (name.name[0] == '.') {
-		/*
-		 * We could potentially refresh the attributes of the directory
-		 * and its parent?
-		 */
-		if (name.len == 1)
-			return 0;
-		if (name.name[1] == '.' && name.len == 2)
-			return 0;
-	}
-
 	if (invalid_nodeid(o->nodeid))
 		return -EIO;
 	if (fuse_invalid_attr(&o->attr))
@@ -1260,8 +1244,8 @@ static int fuse_direntplus_link(struct file *file,
 
 	fc = get_fuse_conn(dir);
 
-	name.hash = full_name_hash(name.name, name.len);
-	dentry = d_lookup(parent, &name);
+	name->hash = full_name_hash(name->name, name->len);
+	dentry = d_lookup(parent, name);
 	if (dentry) {
 		inode = d_inode(dentry);
 		if (!inode) {
@@ -1292,7 +1276,7 @@ static int fuse_direntplus_link(struct file *file,
 		dput(dentry);
 	}
 
-	dentry = d_alloc(parent, &name);
+	dentry = d_alloc(parent, name);
 	err = -ENOMEM;
 	if (!dentry)
 		goto out;
@@ -1323,6 +1307,83 @@ out:
 	return err;
 }
 
+static bool fuse_is_dot_or_dotdot(const struct qstr *name)
+{
+	return name->name[0] == '.' &&
+		(name->len == 1 || (name->name[1] == '.' && name->len == 2));
+}
+
+static int fuse_direntplus_link(struct file *file,
+				struct fuse_direntplus *direntplus,
+				u64 attr_version)
+{
+	struct fuse_entry_out *o = &direntplus->entry_out;
+	struct fuse_dirent *dirent = &direntplus->dirent;
+	struct qstr name = QSTR_INIT(dirent->name, dirent->namelen);
+
+	if (!o->nodeid) {
+		/*
+		 * Unlike in the case of fuse_lookup, zero nodeid does not mean
+		 * ENOENT. Instead, it only means the userspace filesystem did
+		 * not want to return attributes/handle for this entry.
+		 *
+		 * So do nothing.
+		 */
+		return 0;
+	}
+
+	if (fuse_is_dot_or_dotdot(&name)) {
+		/*
+		 * We could potentially refresh the attributes of the directory
+		 * and its parent?
+		 */
+		return 0;
+	}
+
+	return fuse_link_entry(file->f_path.dentry, &name, o, attr_version);
+}
+
+int fuse_reverse_link_entry(struct super_block *sb, u64 parent_nodeid,
+			    struct qstr *name, struct fuse_entry_out *o)
+{
+	int err;
+	struct fuse_conn *fc = get_fuse_conn_super(sb);
+	struct fuse_forget_link *forget;
+	struct inode *parent;
+	struct dentry *dir;
+
+	/* no lookup was counted for these */
+	if (!o->nodeid || fuse_is_dot_or_dotdot(name))
+		return -EINVAL;
+
+	err = -ENOENT;
+	parent = ilookup5(sb, parent_nodeid, fuse_inode_eq, &parent_nodeid);
+	if (!parent)
+		goto forget;
+
+	mutex_lock(&parent->i_mutex);
+	err = -ENOTDIR;
+	if (S_ISDIR(parent->i_mode)) {
+		err = -ENOENT;
+		dir = d_find_alias(parent);
+		if (dir) {
+			err = fuse_link_entry(dir, name, o,
+					      fuse_get_attr_version(fc));
+			dput(dir);
+		}
+	}
+	mutex_unlock(&parent->i_mutex);
+	iput(parent);
+	if (!err)
+		return 0;
+
+forget:
+	forget = fuse_alloc_forget();
+	if (forget)
+		fuse_queue_forget(fc, forget, o->nodeid, 1);
+	return err;
+}
+
 static int parse_dirplusfile(char *buf, size_t nbytes, struct file *file,
 			     struct dir_context *ctx, u64 attr_version)
 {
@@ -1368,6 +1429,13 @@ static int parse_dirplusfile(char *buf, size_t nbytes, struct file *file,
 	return 0;
 }
 
+/*
+ * With a persistent cache every READDIRPLUS entry is worth linking, even
+ * those that don't fit the caller's buffer, so ask for several pages at
+ * once.  That is about as many entries as a 32k getdents() buffer takes.
+ */
+#define FUSE_READDIRPLUS_ORDER	3
+
 static int fuse_readdir(struct file *file, struct dir_context *ctx)
 {
 	int plus, err;
@@ -1377,28 +1445,40 @@ static int fuse_readdir(struct file *file, struct dir_context *ctx)
 	struct fuse_conn *fc = get_fuse_conn(inode);
 	struct fuse_req *req;
 	u64 attr_version = 0;
+	unsigned order = 0;
+	unsigned i;
 
 	if (is_bad_inode(inode))
 		return -EIO;
 
-	req = fuse_get_req(fc, 1);
-	if (IS_ERR(req))
-		return PTR_ERR(req);
-
-	page = alloc_page(GFP_KERNEL);
-	if (!page) {
-		fuse_put_request(fc, req);
+	plus = fuse_use_readdirplus(inode, ctx);
+	if (plus && fc->persistent_cache) {
+		order = FUSE_READDIRPLUS_ORDER;
+		page = alloc_pages(GFP_KERNEL | __GFP_NOWARN | __GFP_NORETRY,
+				   order);
+		if (!page)
+			order = 0;
+	}
+	if (!order)
+		page = alloc_page(GFP_KERNEL);
+	if (!page)
 		return -ENOMEM;
+
+	req = fuse_get_req(fc, 1 << order);
+	if (IS_ERR(req)) {
+		__free_pages(page, order);
+		return PTR_ERR(req);
 	}
 
-	plus = fuse_use_readdirplus(inode, ctx);
 	req->out.argpages = 1;
-	req->num_pages = 1;
-	req->pages[0] = page;
-	req->page_descs[0].length = PAGE_SIZE;
+	req->num_pages = 1 << order;
+	for (i = 0; i < req->num_pages; i++) {
+		req->pages[i] = page + i;
+		req->page_descs[i].length = PAGE_SIZE;
+	}
 	if (plus) {
 		attr_version = fuse_get_attr_version(fc);
-		fuse_read_fill(req, file, ctx->pos, PAGE_SIZE,
+		fuse_read_fill(req, file, ctx->pos, PAGE_SIZE << order,
 			       FUSE_READDIRPLUS);
 	} else {
 		fuse_read_fill(req, file, ctx->pos, PAGE_SIZE,
@@ -1419,7 +1499,7 @@ static int fuse_readdir(struct file *file, struct dir_context *ctx)
 		}
 	}
 
-	__free_page(page);
+	__free_pages(page, order);
 	fuse_invalidate_atime(inode);
 	return err;
 }
@@ -1832,6 +1912,9 @@ static int fuse_getattr(struct vfsmount *mnt, struct dentry *entry,
 	if (!fuse_allow_current_process(fc))
 		return -EACCES;
 
+	if (S_ISREG(inode->i_mode) && !fuse_passthrough_getattr(inode, stat))
+		return 0;
+
 	return fuse_update_attributes(inode, stat, NULL, NULL);
 }
 
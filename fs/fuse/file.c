@@ -193,6 +193,7 @@ void fuse_finish_open(struct inode *inode, struct file *file)
 
 	if (ff->open_flags & FOPEN_DIRECT_IO)
 		file->f_op = &fuse_direct_io_file_operations;
+	fuse_passthrough_open(inode, ff);
 	if (!(ff->open_flags & FOPEN_KEEP_CACHE))
 		invalidate_inode_pages2(inode->i_mapping);
 	if (ff->open_flags & FOPEN_STREAM)
@@ -276,7 +277,7 @@ void fuse_release_common(struct file *file, int opcode)
 	if (unlikely(!ff))
 		return;
 
-	fuse_passthrough_release(ff);
+	fuse_passthrough_release(file_inode(file), ff);
 
 	req = ff->reserved_req;
 	fuse_prepare_release(ff, file->f_flags, opcode);
@@ -543,6 +544,9 @@ out:
 static int fuse_fsync(struct file *file, loff_t start, loff_t end,
 		      int datasync)
 {
+	if (fuse_passthrough_active(file->private_data))
+		return fuse_passthrough_fsync(file, start, end, datasync);
+
 	return fuse_fsync_common(file, start, end, datasync, 0);
 }
 
@@ -996,6 +1000,10 @@ static ssize_t fuse_file_read_iter(struct kiocb *iocb, struct iov_iter *to)
 	struct fuse_conn *fc = get_fuse_conn(inode);
 	struct fuse_file *ff = iocb->ki_filp->private_data;
 
+	/* The lower filesystem knows its own size */
+	if (fuse_passthrough_active(ff))
+		return fuse_passthrough_read_iter(iocb, to);
+
 	/*
 	 * In auto invalidate mode, always update attributes on read.
 	 * Otherwise, only update if we attempt to read past EOF (to ensure
@@ -1009,10 +1017,7 @@ static ssize_t fuse_file_read_iter(struct kiocb *iocb, struct iov_iter *to)
 			return err;
 	}
 
-	if (ff && ff->passthrough_enabled && ff->passthrough_filp)
-		ret_val = fuse_passthrough_read_iter(iocb, to);
-	else
-		ret_val = generic_file_read_iter(iocb, to);
+	ret_val = generic_file_read_iter(iocb, to);
 
 	return ret_val;
 }
@@ -1280,7 +1285,7 @@ static ssize_t fuse_file_write_iter(struct kiocb *iocb, struct iov_iter *from)
 	if (err)
 		goto out;
 
-	if (ff && ff->passthrough_enabled && ff->passthrough_filp) {
+	if (fuse_passthrough_active(ff)) {
 		written = fuse_passthrough_write_iter(iocb, from);
 		goto out;
 	}
@@ -2161,6 +2166,9 @@ static int fuse_file_mmap(struct file *file, struct vm_area_struct *vma)
 {
 	struct fuse_file *ff = file->private_data;
 
+	if (fuse_passthrough_active(ff))
+		return fuse_passthrough_mmap(file, vma);
+
 	ff->passthrough_enabled = 0;
 	if ((vma->vm_flags & VM_SHARED) && (vma->vm_flags & VM_MAYWRITE))
 		fuse_link_write_file(file);
@@ -3085,6 +3093,27 @@ out:
 	return err;
 }
 
+static ssize_t fuse_file_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe, size_t len,
+				     unsigned int flags)
+{
+	if (fuse_passthrough_active(in->private_data))
+		return fuse_passthrough_splice_read(in, ppos, pipe, len, flags);
+
+	return generic_file_splice_read(in, ppos, pipe, len, flags);
+}
+
+static ssize_t fuse_file_splice_write(struct pipe_inode_info *pipe,
+				      struct file *out, loff_t *ppos,
+				      size_t len, unsigned int flags)
+{
+	if (fuse_passthrough_active(out->private_data))
+		return fuse_passthrough_splice_write(pipe, out, ppos, len,
+						     flags);
+
+	return iter_file_splice_write(pipe, out, ppos, len, flags);
+}
+
 static const struct file_operations fuse_file_operations = {
 	.llseek		= fuse_file_llseek,
 	.read_iter	= fuse_file_read_iter,
@@ -3096,7 +3125,8 @@ static const struct file_operations fuse_file_operations = {
 	.fsync		= fuse_fsync,
 	.lock		= fuse_file_lock,
 	.flock		= fuse_file_flock,
-	.splice_read	= generic_file_splice_read,
+	.splice_read	= fuse_file_splice_read,
+	.splice_write	= fuse_file_splice_write,
 	.unlocked_ioctl	= fuse_file_ioctl,
 	.compat_ioctl	= fuse_file_compat_ioctl,
 	.poll		= fuse_file_poll,
@@ -108,6 +108,13 @@ struct fuse_inode {
 	/** List of writepage requestst (pending or sent) */
 	struct list_head writepages;
 
+	/** Lower file of an open passthrough file, used by getattr.
+	 * Protected by fc->lock */
+	struct file *passthrough_filp;
+
+	/** Number of open passthrough files.  Protected by fc->lock */
+	unsigned passthrough_count;
+
 	/** Miscellaneous bits describing inode state */
 	unsigned long state;
 };
@@ -321,6 +328,9 @@ struct fuse_req {
 	/** Unique ID for the interrupt request */
 	u64 intr_unique;
 
+	/** Per-CPU queue the request was queued on, NULL for fc->iq */
+	struct fuse_cpu_queue *cq;
+
 	/* Request flags, updated with test/set/clear_bit() */
 	unsigned long flags;
 
@@ -405,7 +415,7 @@ struct fuse_iqueue {
 	wait_queue_head_t waitq;
 
 	/** The next unique request id */
-	u64 reqctr;
+	atomic64_t reqctr;
 
 	/** The list of pending requests */
 	struct list_head pending;
@@ -422,6 +432,39 @@ struct fuse_iqueue {
 
 	/** O_ASYNC requests */
 	struct fasync_struct *fasync;
+
+	/** Per-CPU queues, allocated on the first FUSE_DEV_IOC_BIND_CPU */
+	struct fuse_cpu_queue __percpu *cpu_queues;
+
+	/** Number of requests queued on all the per-CPU queues */
+	atomic_t nr_cpu_pending;
+};
+
+/**
+ * Input queue of one CPU, read by the devices bound to that CPU.
+ * Requests are queued here instead of on fc->iq when a device is
+ * bound to the submitting CPU. Bound readers that run out of work
+ * take requests from fc->iq and then from the other CPUs' queues;
+ * unbound readers steal from the per-CPU queues when fc->iq is empty.
+ *
+ * Lock order is fc->iq.waitq.lock, then waitq.lock of a per-CPU queue;
+ * never hold two per-CPU queue locks at once.
+ */
+struct fuse_cpu_queue {
+	/** Bound readers wait on this, its lock protects the queue */
+	wait_queue_head_t waitq;
+
+	/** The list of pending requests */
+	struct list_head pending;
+
+	/** Number of devices bound to this CPU */
+	unsigned nr_devs;
+
+	/** Cleared when the connection is aborted */
+	unsigned connected:1;
+
+	/** An idle reader was woken to steal work from elsewhere */
+	unsigned steal:1;
 };
 
 struct fuse_pqueue {
@@ -450,6 +493,9 @@ struct fuse_dev {
 
 	/** list entry on fc->devices */
 	struct list_head entry;
+
+	/** Per-CPU queue this device is bound to, or NULL */
+	struct fuse_cpu_queue *cq;
 };
 
 /**
@@ -626,6 +672,10 @@ struct fuse_conn {
 	/** Does the filesystem want adaptive readdirplus? */
 	unsigned readdirplus_auto:1;
 
+	/** Mounted with persistent_cache: entries are pushed and may be
+	    valid forever */
+	unsigned persistent_cache:1;
+
 	/** Does the filesystem support asynchronous direct-IO submission? */
 	unsigned async_dio:1;
 
@@ -939,6 +989,13 @@ int fuse_reverse_inval_inode(struct super_block *sb, u64 nodeid,
 int fuse_reverse_inval_entry(struct super_block *sb, u64 parent_nodeid,
 			     u64 child_nodeid, struct qstr *name);
 
+/**
+ * File-system tells the kernel about a directory entry, as a lookup or
+ * READDIRPLUS reply would.  A FORGET is sent if the entry can't be used.
+ */
+int fuse_reverse_link_entry(struct super_block *sb, u64 parent_nodeid,
+			    struct qstr *name, struct fuse_entry_out *o);
+
 int fuse_do_open(struct fuse_conn *fc, u64 nodeid, struct file *file,
 		 bool isdir);
 
@@ -20,12 +20,34 @@
 #include <linux/fuse.h>
 #include <linux/file.h>
 
+static inline bool fuse_passthrough_active(struct fuse_file *ff)
+{
+	return ff && ff->passthrough_enabled && ff->passthrough_filp;
+}
+
 void fuse_setup_passthrough(struct fuse_conn *fc, struct fuse_req *req);
 
+void fuse_passthrough_open(struct inode *inode, struct fuse_file *ff);
+
 ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to);
 
 ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from);
 
-void fuse_passthrough_release(struct fuse_file *ff);
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe, size_t len,
+				     unsigned int flags);
+
+ssize_t fuse_passthrough_splice_write(struct pipe_inode_info *pipe,
+				      struct file *out, loff_t *ppos,
+				      size_t len, unsigned int flags);
+
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
+int fuse_passthrough_fsync(struct file *file, loff_t start, loff_t end,
+			   int datasync);
+
+int fuse_passthrough_getattr(struct inode *inode, struct kstat *stat);
+
+void fuse_passthrough_release(struct inode *inode, struct fuse_file *ff);
 
 #endif /* _FS_FUSE_PASSTHROUGH_H */
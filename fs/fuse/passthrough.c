@@ -16,6 +16,8 @@
 
 #include <linux/aio.h>
 #include <linux/fs_stack.h>
+#include <linux/mm.h>
+#include <linux/splice.h>
 
 void fuse_setup_passthrough(struct fuse_conn *fc, struct fuse_req *req)
 {
@@ -64,6 +66,25 @@ void fuse_setup_passthrough(struct fuse_conn *fc, struct fuse_req *req)
 	req->passthrough_filp = passthrough_filp;
 }
 
+/*
+ * Remember the lower file of an opened passthrough file in the inode, so
+ * that getattr can be answered without the daemon while it is open.
+ */
+void fuse_passthrough_open(struct inode *inode, struct fuse_file *ff)
+{
+	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_inode *fi = get_fuse_inode(inode);
+
+	if (!ff->passthrough_filp)
+		return;
+
+	spin_lock(&fc->lock);
+	if (!fi->passthrough_filp)
+		fi->passthrough_filp = get_file(ff->passthrough_filp);
+	fi->passthrough_count++;
+	spin_unlock(&fc->lock);
+}
+
 static ssize_t fuse_passthrough_read_write_iter(struct kiocb *iocb,
 					    struct iov_iter *iter, int do_write)
 {
@@ -121,11 +142,180 @@ ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from)
 	return fuse_passthrough_read_write_iter(iocb, from, 1);
 }
 
-void fuse_passthrough_release(struct fuse_file *ff)
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe, size_t len,
+				     unsigned int flags)
+{
+	ssize_t ret_val;
+	struct fuse_file *ff = in->private_data;
+	struct file *passthrough_filp = ff->passthrough_filp;
+
+	/* lock passthrough file to prevent it from being released */
+	get_file(passthrough_filp);
+	if (passthrough_filp->f_op->splice_read)
+		ret_val = passthrough_filp->f_op->splice_read(passthrough_filp,
+						ppos, pipe, len, flags);
+	else
+		ret_val = default_file_splice_read(passthrough_filp, ppos,
+						   pipe, len, flags);
+	if (ret_val >= 0)
+		fsstack_copy_attr_atime(file_inode(in),
+					file_inode(passthrough_filp));
+
+	/* unlock passthrough file */
+	fput(passthrough_filp);
+
+	return ret_val;
+}
+
+ssize_t fuse_passthrough_splice_write(struct pipe_inode_info *pipe,
+				      struct file *out, loff_t *ppos,
+				      size_t len, unsigned int flags)
+{
+	ssize_t ret_val;
+	struct fuse_file *ff = out->private_data;
+	struct file *passthrough_filp = ff->passthrough_filp;
+	struct inode *fuse_inode = file_inode(out);
+	struct inode *passthrough_inode = file_inode(passthrough_filp);
+
+	if (!passthrough_filp->f_op->splice_write &&
+	    !passthrough_filp->f_op->write_iter)
+		return -EINVAL;
+
+	/* lock passthrough file to prevent it from being released */
+	get_file(passthrough_filp);
+	file_start_write(passthrough_filp);
+	if (passthrough_filp->f_op->splice_write)
+		ret_val = passthrough_filp->f_op->splice_write(pipe,
+					passthrough_filp, ppos, len, flags);
+	else
+		ret_val = iter_file_splice_write(pipe, passthrough_filp, ppos,
+						 len, flags);
+	file_end_write(passthrough_filp);
+
+	if (ret_val > 0) {
+		spin_lock(&ff->fc->lock);
+		fsstack_copy_inode_size(fuse_inode, passthrough_inode);
+		spin_unlock(&ff->fc->lock);
+		fsstack_copy_attr_times(fuse_inode, passthrough_inode);
+	}
+
+	/* unlock passthrough file */
+	fput(passthrough_filp);
+
+	return ret_val;
+}
+
+/*
+ * Map the lower file in place of the fuse file, so that page faults are
+ * served from the lower page cache and stay coherent with passthrough
+ * read and write.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	int ret_val;
+	struct fuse_file *ff = file->private_data;
+	struct file *passthrough_filp = ff->passthrough_filp;
+
+	if (!passthrough_filp->f_op->mmap)
+		return -ENODEV;
+
+	vma->vm_file = get_file(passthrough_filp);
+	ret_val = passthrough_filp->f_op->mmap(passthrough_filp, vma);
+	if (ret_val) {
+		/* drop the reference taken for the new vm_file */
+		fput(passthrough_filp);
+	} else {
+		/* drop the reference mmap_region() took for the old one */
+		fput(file);
+		fsstack_copy_attr_atime(file_inode(file),
+					file_inode(passthrough_filp));
+	}
+
+	return ret_val;
+}
+
+int fuse_passthrough_fsync(struct file *file, loff_t start, loff_t end,
+			   int datasync)
 {
+	int ret_val;
+	struct fuse_file *ff = file->private_data;
+
+	/* pages written through another, non-passthrough open */
+	ret_val = filemap_write_and_wait_range(file->f_mapping, start, end);
+	if (ret_val)
+		return ret_val;
+
+	return vfs_fsync_range(ff->passthrough_filp, start, end, datasync);
+}
+
+/*
+ * Answer getattr from the lower inode while a passthrough file is open.
+ * Mode and ownership stay as last reported by the daemon, which may
+ * present them differently from the lower filesystem; size, blocks and
+ * times come from the lower inode, which is where passthrough I/O lands.
+ *
+ * Returns -ENOENT if no passthrough file is open.
+ */
+int fuse_passthrough_getattr(struct inode *inode, struct kstat *stat)
+{
+	int ret_val;
+	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_inode *fi = get_fuse_inode(inode);
+	struct file *passthrough_filp;
+	struct inode *passthrough_inode;
+	struct kstat lower_stat;
+
+	spin_lock(&fc->lock);
+	passthrough_filp = fi->passthrough_filp;
+	if (passthrough_filp)
+		get_file(passthrough_filp);
+	spin_unlock(&fc->lock);
+
+	if (!passthrough_filp)
+		return -ENOENT;
+
+	passthrough_inode = file_inode(passthrough_filp);
+	ret_val = vfs_getattr(&passthrough_filp->f_path, &lower_stat);
+	if (!ret_val) {
+		spin_lock(&fc->lock);
+		fsstack_copy_inode_size(inode, passthrough_inode);
+		spin_unlock(&fc->lock);
+		fsstack_copy_attr_times(inode, passthrough_inode);
+
+		generic_fillattr(inode, stat);
+		stat->mode = fi->orig_i_mode;
+		stat->ino = fi->orig_ino;
+		stat->size = lower_stat.size;
+		stat->blocks = lower_stat.blocks;
+		stat->atime = lower_stat.atime;
+		stat->mtime = lower_stat.mtime;
+		stat->ctime = lower_stat.ctime;
+	}
+
+	fput(passthrough_filp);
+
+	return ret_val;
+}
+
+void fuse_passthrough_release(struct inode *inode, struct fuse_file *ff)
+{
+	struct fuse_conn *fc = ff->fc;
+	struct fuse_inode *fi = get_fuse_inode(inode);
+	struct file *inode_filp = NULL;
+
 	if (!(ff->passthrough_filp))
 		return;
 
+	spin_lock(&fc->lock);
+	if (fi->passthrough_count && !--fi->passthrough_count) {
+		inode_filp = fi->passthrough_filp;
+		fi->passthrough_filp = NULL;
+	}
+	spin_unlock(&fc->lock);
+	if (inode_filp)
+		fput(inode_filp);
+
 	/* Release the passthrough file. */
 	fput(ff->passthrough_filp);
 	ff->passthrough_filp = NULL;
@@ -0,0 +1,120 @@
+/*
+ * linux/fs/page_runs.c
+ *
+ * Spread the per-page work on a completed read bio, such as decrypting
+ * it in place, over several CPUs.  The pages are handed to the filesystem
+ * in runs of consecutive pages that belong to the same inode.
+ */
+
+#include <linux/atomic.h>
+#include <linux/bio.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/fs.h>
+#include <linux/module.h>
+#include <linux/page_runs.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+struct page_run_slice {
+	struct work_struct work;
+	struct bio *bio;
+	unsigned int start;
+	unsigned int end;
+	page_run_fn *fn;
+	atomic_t *pending;
+	struct completion *done;
+};
+
+/* Call @fn on bi_io_vec[start..end), in runs of pages of the same inode. */
+static void bio_for_each_page_run(struct bio *bio, unsigned int start,
+				  unsigned int end, page_run_fn *fn)
+{
+	while (start < end) {
+		struct bio_vec *bv = &bio->bi_io_vec[start];
+		struct inode *inode = bv->bv_page->mapping->host;
+		unsigned int nr = 1;
+
+		while (start + nr < end &&
+		       bv[nr].bv_page->mapping->host == inode)
+			nr++;
+
+		fn(inode, bv, nr);
+		start += nr;
+	}
+}
+
+static void page_run_slice_work(struct work_struct *work)
+{
+	struct page_run_slice *slice =
+		container_of(work, struct page_run_slice, work);
+
+	bio_for_each_page_run(slice->bio, slice->start, slice->end, slice->fn);
+	if (atomic_dec_and_test(slice->pending))
+		complete(slice->done);
+}
+
+/**
+ * process_bio_page_runs - process the pages of a read bio on several CPUs
+ * @bio:	bio whose pages to process; all pages must be in the page cache
+ * @fn:		called for each run of consecutive pages of the same inode
+ * @slice_pages: bios with more pages than this are split into slices
+ * @wq:		per-CPU workqueue the extra slices are queued on
+ *
+ * Description:
+ *   Splits the pages of @bio into up to one slice per online CPU.  All but
+ *   the first slice are queued on @wq, each on a different CPU; the first is
+ *   processed by the caller, which then waits for the rest.  If the slices
+ *   can't be allocated, the caller processes the whole bio.  Since the caller
+ *   waits for the slices, @fn must not wait on anything queued behind it,
+ *   and @wq needs a rescuer if the caller is needed for reclaim.
+ */
+void process_bio_page_runs(struct bio *bio, page_run_fn *fn,
+			   unsigned int slice_pages,
+			   struct workqueue_struct *wq)
+{
+	unsigned int nr_pages = bio->bi_vcnt;
+	unsigned int nr_slices;
+	struct page_run_slice *slices = NULL;
+	atomic_t pending;
+	DECLARE_COMPLETION_ONSTACK(done);
+	unsigned int i;
+	int cpu;
+
+	nr_slices = min_t(unsigned int, DIV_ROUND_UP(nr_pages, slice_pages),
+			  num_online_cpus());
+	if (nr_slices > 1)
+		slices = kmalloc_array(nr_slices - 1, sizeof(*slices),
+				       GFP_NOIO | __GFP_NOWARN);
+	if (!slices) {
+		bio_for_each_page_run(bio, 0, nr_pages, fn);
+		return;
+	}
+
+	atomic_set(&pending, nr_slices - 1);
+	cpu = raw_smp_processor_id();
+	for (i = 1; i < nr_slices; i++) {
+		struct page_run_slice *slice = &slices[i - 1];
+
+		INIT_WORK(&slice->work, page_run_slice_work);
+		slice->bio = bio;
+		slice->start = nr_pages * i / nr_slices;
+		slice->end = nr_pages * (i + 1) / nr_slices;
+		slice->fn = fn;
+		slice->pending = &pending;
+		slice->done = &done;
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+		queue_work_on(cpu, wq, &slice->work);
+	}
+
+	bio_for_each_page_run(bio, 0, nr_pages / nr_slices, fn);
+	wait_for_completion(&done);
+	kfree(slices);
+}
+EXPORT_SYMBOL_GPL(process_bio_page_runs);
+
+MODULE_DESCRIPTION("Per-CPU processing of read bio page runs");
+MODULE_LICENSE("GPL");
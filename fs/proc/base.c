@@ -1145,6 +1145,7 @@ static ssize_t oom_adj_write(struct file *file, const char __user *buf,
 		  task_pid_nr(task));
 
 	task->signal->oom_score_adj = oom_adj;
+	lowmem_adj_index_update(task);
 	trace_oom_score_adj_update(task);
 err_sighand:
 	unlock_task_sighand(task, &flags);
@@ -1233,6 +1234,7 @@ static ssize_t oom_score_adj_write(struct file *file, const char __user *buf,
 	task->signal->oom_score_adj = (short)oom_score_adj;
 	if (has_capability_noaudit(current, CAP_SYS_RESOURCE))
 		task->signal->oom_score_adj_min = (short)oom_score_adj;
+	lowmem_adj_index_update(task);
 	trace_oom_score_adj_update(task);
 
 err_sighand:
@@ -1560,6 +1560,85 @@ cont:
 	return 0;
 }
 
+/*
+ * Like reclaim_pte_range() but only for exclusively mapped anon pages
+ * which have not been referenced since the idle bits were last set. The
+ * whole range is walked even once nr_to_reclaim is used up: every page
+ * that was referenced gets its idle bit set again, and the idle ones are
+ * counted so the caller learns the cold size of the process.
+ */
+static int reclaim_idle_pte_range(pmd_t *pmd, unsigned long addr,
+				unsigned long end, struct mm_walk *walk)
+{
+	struct reclaim_param *rp = walk->private;
+	struct vm_area_struct *vma = rp->vma;
+	pte_t *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+	LIST_HEAD(page_list);
+	bool referenced;
+	int isolated;
+	int reclaimed;
+
+	split_huge_page_pmd(vma, addr, pmd);
+	if (pmd_trans_unstable(pmd))
+		return 0;
+cont:
+	isolated = 0;
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		ptent = *pte;
+		if (!pte_present(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page || !PageAnon(page) || page_mapcount(page) != 1)
+			continue;
+
+		referenced = ptep_clear_young_notify(vma, addr, pte);
+		/* without PG_idle only the pte young bit can be trusted */
+		if (IS_ENABLED(CONFIG_IDLE_PAGE_TRACKING) && !page_is_idle(page))
+			referenced = true;
+
+		if (referenced) {
+			/* keep page_referenced() from seeing it as old */
+			set_page_young(page);
+			set_page_idle(page);
+			continue;
+		}
+
+		rp->nr_idle++;
+		if (!rp->nr_to_reclaim || isolate_lru_page(page))
+			continue;
+
+		list_add(&page->lru, &page_list);
+		inc_zone_page_state(page, NR_ISOLATED_ANON +
+				page_is_file_cache(page));
+		isolated++;
+		rp->nr_scanned++;
+		if (isolated >= SWAP_CLUSTER_MAX ||
+		    isolated >= rp->nr_to_reclaim) {
+			pte++;
+			addr += PAGE_SIZE;
+			break;
+		}
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+	if (isolated) {
+		reclaimed = reclaim_pages_from_list(&page_list, vma);
+		rp->nr_reclaimed += reclaimed;
+		rp->nr_to_reclaim -= reclaimed;
+		if (rp->nr_to_reclaim < 0)
+			rp->nr_to_reclaim = 0;
+	}
+
+	if (addr != end)
+		goto cont;
+
+	cond_resched();
+	return 0;
+}
+
 enum reclaim_type {
 	RECLAIM_FILE,
 	RECLAIM_ANON,
@@ -1567,8 +1646,8 @@ enum reclaim_type {
 	RECLAIM_RANGE,
 };
 
-struct reclaim_param reclaim_task_anon(struct task_struct *task,
-		int nr_to_reclaim)
+static struct reclaim_param __reclaim_task_anon(struct task_struct *task,
+		int nr_to_reclaim, bool idle)
 {
 	struct mm_struct *mm;
 	struct vm_area_struct *vma;
@@ -1577,13 +1656,15 @@ struct reclaim_param reclaim_task_anon(struct task_struct *task,
 
 	rp.nr_reclaimed = 0;
 	rp.nr_scanned = 0;
+	rp.nr_idle = 0;
 	get_task_struct(task);
 	mm = get_task_mm(task);
 	if (!mm)
 		goto out;
 
 	reclaim_walk.mm = mm;
-	reclaim_walk.pmd_entry = reclaim_pte_range;
+	reclaim_walk.pmd_entry = idle ? reclaim_idle_pte_range :
+					reclaim_pte_range;
 
 	rp.nr_to_reclaim = nr_to_reclaim;
 	reclaim_walk.private = &rp;
@@ -1599,7 +1680,7 @@ struct reclaim_param reclaim_task_anon(struct task_struct *task,
 		if (vma->vm_flags & VM_LOCKED)
 			continue;
 
-		if (!rp.nr_to_reclaim)
+		if (!idle && !rp.nr_to_reclaim)
 			break;
 
 		rp.vma = vma;
@@ -1615,6 +1696,23 @@ out:
 	return rp;
 }
 
+struct reclaim_param reclaim_task_anon(struct task_struct *task,
+		int nr_to_reclaim)
+{
+	return __reclaim_task_anon(task, nr_to_reclaim, false);
+}
+
+/*
+ * Reclaim up to @nr_to_reclaim anon pages of @task that have been idle
+ * since the previous call, and set the idle bit on everything else.
+ * With @nr_to_reclaim == 0 this only samples and (re)arms the idle bits.
+ */
+struct reclaim_param reclaim_task_idle_anon(struct task_struct *task,
+		int nr_to_reclaim)
+{
+	return __reclaim_task_anon(task, nr_to_reclaim, true);
+}
+
 static ssize_t reclaim_write(struct file *file, const char __user *buf,
 				size_t count, loff_t *ppos)
 {
@@ -107,6 +107,8 @@ static int sdcardfs_d_revalidate(struct dentry *dentry, unsigned int flags)
 	/* If our top's inode is gone, we may be out of date */
 	inode = igrab(d_inode(dentry));
 	if (inode) {
+		fixup_stale_top(inode);
+
 		data = top_data_get(SDCARDFS_I(inode));
 		if (!data || data->abandoned) {
 			err = 0;
@@ -130,6 +130,10 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	case PERM_ANDROID_DATA:
 	case PERM_ANDROID_MEDIA:
 		info->data->perm = PERM_ANDROID_PACKAGE;
+		/* read before the package list, see package_gen() */
+		info->data->name_hash = package_name_hash(name);
+		info->data->gen = package_gen(info->data->name_hash);
+		smp_rmb();
 		appid = get_appid(name->name);
 		if (appid != 0 && !is_excluded(name->name, parent_data->userid))
 			info->data->d_uid =
@@ -266,67 +270,64 @@ retry_deleg:
 	sdcardfs_put_lower_path(dentry, &path);
 }
 
-static int descendant_may_need_fixup(struct sdcardfs_inode_data *data,
-		struct limit_search *limit)
+static bool top_data_stale(const struct sdcardfs_inode_data *top)
 {
-	if (data->perm == PERM_ROOT)
-		return (limit->flags & BY_USERID) ?
-				data->userid == limit->userid : 1;
-	if (data->perm == PERM_PRE_ROOT || data->perm == PERM_ANDROID)
-		return 1;
-	return 0;
+	return top->perm == PERM_ANDROID_PACKAGE && !top->abandoned &&
+		READ_ONCE(top->gen) != package_gen(top->name_hash);
 }
 
-static int needs_fixup(perm_t perm)
+/*
+ * Whether the top @inode takes its owner from was derived before the last
+ * change to the package list.  Doesn't sleep, so it can be used to bail
+ * out of RCU walk before calling fixup_stale_top().
+ */
+bool top_is_stale(struct inode *inode)
 {
-	if (perm == PERM_ANDROID_DATA || perm == PERM_ANDROID_OBB
-			|| perm == PERM_ANDROID_MEDIA)
-		return 1;
-	return 0;
+	struct sdcardfs_inode_data *top = top_data_get(SDCARDFS_I(inode));
+	bool stale;
+
+	if (!top)
+		return false;
+	stale = top_data_stale(top);
+	data_put(top);
+	return stale;
 }
 
-static void __fixup_perms_recursive(struct dentry *dentry, struct limit_search *limit, int depth)
+/*
+ * Package directories are the only nodes whose derived state depends on
+ * the package list.  Changes to the list just bump package_gen(), so
+ * when the top @inode takes its owner from is a package directory that
+ * was derived before the last such change, rederive that directory.
+ * This covers every inode of the subtree however it is reached, be it
+ * by path walk, from a cwd or through a dirfd.  May sleep.
+ */
+void fixup_stale_top(struct inode *inode)
 {
-	struct dentry *child;
-	struct sdcardfs_inode_info *info;
+	struct sdcardfs_inode_data *top = top_data_get(SDCARDFS_I(inode));
+	struct dentry *dentry, *parent;
 
-	/*
-	 * All paths will terminate their recursion on hitting PERM_ANDROID_OBB,
-	 * PERM_ANDROID_MEDIA, or PERM_ANDROID_DATA. This happens at a depth of
-	 * at most 3.
-	 */
-	WARN(depth > 3, "%s: Max expected depth exceeded!\n", __func__);
-	spin_lock_nested(&dentry->d_lock, depth);
-	if (!d_inode(dentry)) {
-		spin_unlock(&dentry->d_lock);
+	if (!top)
 		return;
-	}
-	info = SDCARDFS_I(d_inode(dentry));
-
-	if (needs_fixup(info->data->perm)) {
-		list_for_each_entry(child, &dentry->d_subdirs, d_child) {
-			spin_lock_nested(&child->d_lock, depth + 1);
-			if (!(limit->flags & BY_NAME) || qstr_case_eq(&child->d_name, &limit->name)) {
-				if (d_inode(child)) {
-					get_derived_permission(dentry, child);
-					fixup_tmp_permissions(d_inode(child));
-					spin_unlock(&child->d_lock);
-					break;
-				}
-			}
-			spin_unlock(&child->d_lock);
-		}
-	} else if (descendant_may_need_fixup(info->data, limit)) {
-		list_for_each_entry(child, &dentry->d_subdirs, d_child) {
-			__fixup_perms_recursive(child, limit, depth + 1);
+	if (!top_data_stale(top))
+		goto out;
+
+	/* the package directory is @inode itself or one of its ancestors */
+	dentry = d_find_alias(inode);
+	while (dentry && !IS_ROOT(dentry)) {
+		if (SDCARDFS_I(d_inode(dentry))->data == top) {
+			parent = dget_parent(dentry);
+			get_derived_permission(parent, dentry);
+			fixup_tmp_permissions(d_inode(dentry));
+			dput(parent);
+			break;
 		}
+		parent = dget_parent(dentry);
+		dput(dentry);
+		dentry = parent;
 	}
-	spin_unlock(&dentry->d_lock);
-}
-
-void fixup_perms_recursive(struct dentry *dentry, struct limit_search *limit)
-{
-	__fixup_perms_recursive(dentry, limit, 0);
+	dput(dentry);
+out:
+	data_put(top);
 }
 
 /* main function for updating derived permission */
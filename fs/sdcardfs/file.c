@@ -168,63 +168,36 @@ out:
 }
 #endif
 
+/*
+ * Map the lower file directly, as overlayfs does: the vma is handed to
+ * the lower ->mmap with the lower file as vm_file, so faults go straight
+ * to the lower page cache and no sdcardfs pages are ever instantiated.
+ */
 static int sdcardfs_mmap(struct file *file, struct vm_area_struct *vma)
 {
-	int err = 0;
-	bool willwrite;
+	int err;
 	struct file *lower_file;
-	const struct vm_operations_struct *saved_vm_ops = NULL;
-
-	/* this might be deferred to mmap's writepage */
-	willwrite = ((vma->vm_flags | VM_SHARED | VM_WRITE) == vma->vm_flags);
-
-	/*
-	 * File systems which do not implement ->writepage may use
-	 * generic_file_readonly_mmap as their ->mmap op.  If you call
-	 * generic_file_readonly_mmap with VM_WRITE, you'd get an -EINVAL.
-	 * But we cannot call the lower ->mmap op, so we can't tell that
-	 * writeable mappings won't work.  Therefore, our only choice is to
-	 * check if the lower file system supports the ->writepage, and if
-	 * not, return EINVAL (the same error that
-	 * generic_file_readonly_mmap returns in that case).
-	 */
+
+	if (WARN_ON(file != vma->vm_file))
+		return -EIO;
+
 	lower_file = sdcardfs_lower_file(file);
-	if (willwrite && !lower_file->f_mapping->a_ops->writepage) {
-		err = -EINVAL;
-		pr_err("sdcardfs: lower file system does not support writeable mmap\n");
-		goto out;
-	}
+	if (!lower_file->f_op->mmap)
+		return -ENODEV;
 
-	/*
-	 * find and save lower vm_ops.
-	 *
-	 * XXX: the VFS should have a cleaner way of finding the lower vm_ops
-	 */
-	if (!SDCARDFS_F(file)->lower_vm_ops) {
-		err = lower_file->f_op->mmap(lower_file, vma);
-		if (err) {
-			pr_err("sdcardfs: lower mmap failed %d\n", err);
-			goto out;
-		}
-		saved_vm_ops = vma->vm_ops; /* save: came from lower ->mmap */
+	vma->vm_file = get_file(lower_file);
+	err = lower_file->f_op->mmap(lower_file, vma);
+	if (err) {
+		/* mmap_region() drops the reference on the upper file */
+		fput(lower_file);
+		pr_err("sdcardfs: lower mmap failed %d\n", err);
+		return err;
 	}
 
-	/*
-	 * Next 3 lines are all I need from generic_file_mmap.  I definitely
-	 * don't want its test for ->readpage which returns -ENOEXEC.
-	 */
+	/* the vma now holds the lower file instead of ours */
+	fput(file);
 	file_accessed(file);
-	vma->vm_ops = &sdcardfs_vm_ops;
-
-	file->f_mapping->a_ops = &sdcardfs_aops; /* set our aops */
-	if (!SDCARDFS_F(file)->lower_vm_ops) /* save for our ->fault */
-		SDCARDFS_F(file)->lower_vm_ops = saved_vm_ops;
-	vma->vm_private_data = file;
-	get_file(lower_file);
-	vma->vm_file = lower_file;
-
-out:
-	return err;
+	return 0;
 }
 
 static int sdcardfs_open(struct inode *inode, struct file *file)
@@ -416,6 +389,24 @@ out:
 	return err;
 }
 
+static ssize_t sdcardfs_splice_read(struct file *file, loff_t *ppos,
+				    struct pipe_inode_info *pipe, size_t len,
+				    unsigned int flags)
+{
+	ssize_t err;
+	struct file *lower_file;
+
+	lower_file = sdcardfs_lower_file(file);
+	if (!lower_file->f_op->splice_read)
+		return -EINVAL;
+
+	err = lower_file->f_op->splice_read(lower_file, ppos, pipe, len, flags);
+	if (err >= 0)
+		fsstack_copy_attr_atime(file_inode(file),
+					file_inode(lower_file));
+	return err;
+}
+
 /*
  * Sdcardfs write_iter, redirect modified iocb to lower write_iter
  */
@@ -465,6 +456,8 @@ const struct file_operations sdcardfs_main_fops = {
 	.fasync		= sdcardfs_fasync,
 	.read_iter	= sdcardfs_read_iter,
 	.write_iter	= sdcardfs_write_iter,
+	.splice_read	= sdcardfs_splice_read,
+	.splice_write	= iter_file_splice_write,
 };
 
 /* trimmed directory options */
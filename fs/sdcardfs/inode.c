@@ -571,8 +571,15 @@ static int sdcardfs_permission_default(struct inode *inode, int mask)
 	int err;
 	int owner_mode, visible_mode = 0775;
 	struct inode tmp;
-	struct sdcardfs_inode_data *top = top_data_get(SDCARDFS_I(inode));
+	struct sdcardfs_inode_data *top;
 
+	if (mask & MAY_NOT_BLOCK) {
+		if (top_is_stale(inode))
+			return -ECHILD;
+	} else {
+		fixup_stale_top(inode);
+	}
+	top = top_data_get(SDCARDFS_I(inode));
 	if (!top)
 		return -EINVAL;
 
@@ -620,10 +627,18 @@ static int sdcardfs_permission(struct vfsmount *mnt, struct inode *inode, int ma
 {
 	int err;
 	struct inode tmp;
-	struct sdcardfs_inode_data *top = top_data_get(SDCARDFS_I(inode));
+	struct sdcardfs_inode_data *top;
 
 	if (IS_ERR(mnt))
 		return PTR_ERR(mnt);
+	/* rederiving may sleep; let the VFS retry in ref-walk */
+	if (mask & MAY_NOT_BLOCK) {
+		if (top_is_stale(inode))
+			return -ECHILD;
+	} else {
+		fixup_stale_top(inode);
+	}
+	top = top_data_get(SDCARDFS_I(inode));
 #ifdef CONFIG_MULTISPACE_FEATURE_ENABLED
 	uid_t cred_userid;
 	uid_t inode_userid;
@@ -857,6 +872,8 @@ static int sdcardfs_getattr(struct vfsmount *mnt, struct dentry *dentry,
 	}
 	dput(parent);
 
+	fixup_stale_top(d_inode(dentry));
+
 	sdcardfs_get_lower_path(dentry, &lower_path);
 	err = vfs_getattr(&lower_path, &lower_stat);
 	if (err)
@@ -45,6 +45,17 @@ static DEFINE_HASHTABLE(ext_to_groupid, 8);
 
 static struct kmem_cache *hashtable_entry_cachep;
 
+/*
+ * Generation counters for state derived from the package list.  A change
+ * to one package bumps the bucket its name hashes to, a change to all of
+ * a user's packages bumps package_gen_all.  Package directories remember
+ * the sum they were derived against and rederive once it moves.
+ */
+#define PACKAGE_GEN_BITS	8
+
+static atomic_t package_gen_all = ATOMIC_INIT(0);
+static atomic_t package_gen_hash[1 << PACKAGE_GEN_BITS];
+
 static unsigned int full_name_case_hash(const unsigned char *name, unsigned int len)
 {
 	unsigned long hash = init_name_hash();
@@ -87,6 +98,37 @@ static appid_t __get_appid(const struct qstr *key)
 	return 0;
 }
 
+unsigned int package_name_hash(const struct qstr *name)
+{
+	return full_name_case_hash(name->name, name->len);
+}
+
+/*
+ * Generation of the package whose package_name_hash() is @hash.
+ *
+ * Callers read the generation before looking the package up, with a read
+ * barrier in between; the update side changes the tables first and bumps
+ * the generation after.  A lookup that races with an update thus always
+ * ends up with a stale generation and is redone on next access.
+ */
+unsigned int package_gen(unsigned int hash)
+{
+	return atomic_read(&package_gen_all) +
+		atomic_read(&package_gen_hash[hash_32(hash, PACKAGE_GEN_BITS)]);
+}
+
+static void package_gen_bump(const struct qstr *key)
+{
+	smp_mb__before_atomic();
+	atomic_inc(&package_gen_hash[hash_32(key->hash, PACKAGE_GEN_BITS)]);
+}
+
+static void package_gen_bump_all(void)
+{
+	smp_mb__before_atomic();
+	atomic_inc(&package_gen_all);
+}
+
 appid_t get_appid(const char *key)
 {
 	struct qstr q;
@@ -278,46 +320,6 @@ static int insert_userid_exclude_entry_locked(const struct qstr *key, userid_t v
 	return 0;
 }
 
-static void fixup_all_perms_name(const struct qstr *key)
-{
-	struct sdcardfs_sb_info *sbinfo;
-	struct limit_search limit = {
-		.flags = BY_NAME,
-		.name = QSTR_INIT(key->name, key->len),
-	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
-}
-
-static void fixup_all_perms_name_userid(const struct qstr *key, userid_t userid)
-{
-	struct sdcardfs_sb_info *sbinfo;
-	struct limit_search limit = {
-		.flags = BY_NAME | BY_USERID,
-		.name = QSTR_INIT(key->name, key->len),
-		.userid = userid,
-	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
-}
-
-static void fixup_all_perms_userid(userid_t userid)
-{
-	struct sdcardfs_sb_info *sbinfo;
-	struct limit_search limit = {
-		.flags = BY_USERID,
-		.userid = userid,
-	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
-}
-
 static int insert_packagelist_entry(const struct qstr *key, appid_t value)
 {
 	int err;
@@ -325,7 +327,7 @@ static int insert_packagelist_entry(const struct qstr *key, appid_t value)
 	mutex_lock(&sdcardfs_super_list_lock);
 	err = insert_packagelist_appid_entry_locked(key, value);
 	if (!err)
-		fixup_all_perms_name(key);
+		package_gen_bump(key);
 	mutex_unlock(&sdcardfs_super_list_lock);
 
 	return err;
@@ -349,7 +351,7 @@ static int insert_userid_exclude_entry(const struct qstr *key, userid_t value)
 	mutex_lock(&sdcardfs_super_list_lock);
 	err = insert_userid_exclude_entry_locked(key, value);
 	if (!err)
-		fixup_all_perms_name_userid(key, value);
+		package_gen_bump(key);
 	mutex_unlock(&sdcardfs_super_list_lock);
 
 	return err;
@@ -390,7 +392,7 @@ static void remove_packagelist_entry(const struct qstr *key)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_packagelist_entry_locked(key);
-	fixup_all_perms_name(key);
+	package_gen_bump(key);
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
 
@@ -439,7 +441,7 @@ static void remove_userid_all_entry(userid_t userid)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_userid_all_entry_locked(userid);
-	fixup_all_perms_userid(userid);
+	package_gen_bump_all();
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
 
@@ -463,7 +465,7 @@ static void remove_userid_exclude_entry(const struct qstr *key, userid_t userid)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_userid_exclude_entry_locked(key, userid);
-	fixup_all_perms_name_userid(key, userid);
+	package_gen_bump(key);
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
 
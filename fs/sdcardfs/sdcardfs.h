@@ -138,7 +138,6 @@ extern const struct inode_operations sdcardfs_symlink_iops;
 extern const struct super_operations sdcardfs_sops;
 extern const struct dentry_operations sdcardfs_ci_dops;
 extern const struct address_space_operations sdcardfs_aops, sdcardfs_dummy_aops;
-extern const struct vm_operations_struct sdcardfs_vm_ops;
 
 extern int sdcardfs_init_inode_cache(void);
 extern void sdcardfs_destroy_inode_cache(void);
@@ -164,7 +163,6 @@ extern void sdcardfs_update_xattr_dirwriter(struct dentry *lower_dentry,
 /* file private data */
 struct sdcardfs_file_info {
 	struct file *lower_file;
-	const struct vm_operations_struct *lower_vm_ops;
 };
 
 struct sdcardfs_inode_data {
@@ -177,6 +175,11 @@ struct sdcardfs_inode_data {
 	bool under_android;
 	bool under_cache;
 	bool under_obb;
+
+	/* for PERM_ANDROID_PACKAGE: package_name_hash() of the name and the
+	 * package_gen() this was derived against */
+	unsigned int name_hash;
+	unsigned int gen;
 };
 
 /* sdcardfs inode data in memory */
@@ -531,6 +534,8 @@ extern struct list_head sdcardfs_super_list;
 extern appid_t get_appid(const char *app_name);
 extern appid_t get_ext_gid(const char *app_name);
 extern appid_t is_excluded(const char *app_name, userid_t userid);
+extern unsigned int package_name_hash(const struct qstr *name);
+extern unsigned int package_gen(unsigned int hash);
 extern int check_caller_access_to_name(struct inode *parent_node, const struct qstr *name);
 #ifdef CONFIG_SDCARD_FS_DIR_WRITER
 extern int add_app_name_to_list(appid_t appid, char *list, int len);
@@ -539,19 +544,12 @@ extern int packagelist_init(void);
 extern void packagelist_exit(void);
 
 /* for derived_perm.c */
-#define BY_NAME		(1 << 0)
-#define BY_USERID	(1 << 1)
-struct limit_search {
-	unsigned int flags;
-	struct qstr name;
-	userid_t userid;
-};
-
 extern void setup_derived_state(struct inode *inode, perm_t perm,
 			userid_t userid, uid_t uid);
 extern void get_derived_permission(struct dentry *parent, struct dentry *dentry);
 extern void get_derived_permission_new(struct dentry *parent, struct dentry *dentry, const struct qstr *name);
-extern void fixup_perms_recursive(struct dentry *dentry, struct limit_search *limit);
+extern bool top_is_stale(struct inode *inode);
+extern void fixup_stale_top(struct inode *inode);
 
 extern void update_derived_permission_lock(struct dentry *dentry);
 void fixup_lower_ownership(struct dentry *dentry, const char *name);
@@ -160,12 +160,19 @@ struct shash_desc {
  * @digest: see struct ahash_alg
  * @export: see struct ahash_alg
  * @import: see struct ahash_alg
+ * @finup_mb: Finish @num_msgs messages of @len bytes each, all continuing from
+ *	      the state held in the descriptor, and write their digests to
+ *	      @outs. Implementations may interleave or otherwise share work
+ *	      between the messages. The descriptor state is undefined after
+ *	      the call. Optional; only algorithms without an alignmask may
+ *	      provide it.
  * @setkey: see struct ahash_alg
  * @digestsize: see struct ahash_alg
  * @statesize: see struct ahash_alg
  * @descsize: Size of the operational state for the message digest. This state
  * 	      size is the memory size that needs to be allocated for
  *	      shash_desc.__ctx
+ * @mb_max_msgs: Maximum number of messages accepted by @finup_mb
  * @base: internally used
  */
 struct shash_alg {
@@ -179,10 +186,14 @@ struct shash_alg {
 		      unsigned int len, u8 *out);
 	int (*export)(struct shash_desc *desc, void *out);
 	int (*import)(struct shash_desc *desc, const void *in);
+	int (*finup_mb)(struct shash_desc *desc, const u8 * const data[],
+			unsigned int len, u8 * const outs[],
+			unsigned int num_msgs);
 	int (*setkey)(struct crypto_shash *tfm, const u8 *key,
 		      unsigned int keylen);
 
 	unsigned int descsize;
+	unsigned int mb_max_msgs;
 
 	/* These fields must match hash_alg_common. */
 	unsigned int digestsize
@@ -706,6 +717,18 @@ static inline unsigned int crypto_shash_statesize(struct crypto_shash *tfm)
 	return crypto_shash_alg(tfm)->statesize;
 }
 
+/**
+ * crypto_shash_mb_max_msgs() - obtain the multi-buffer batch size
+ * @tfm: cipher handle
+ *
+ * Return: the maximum number of messages crypto_shash_finup_mb() accepts,
+ *	   1 if the algorithm has no multi-buffer implementation
+ */
+static inline unsigned int crypto_shash_mb_max_msgs(struct crypto_shash *tfm)
+{
+	return crypto_shash_alg(tfm)->mb_max_msgs;
+}
+
 static inline u32 crypto_shash_get_flags(struct crypto_shash *tfm)
 {
 	return crypto_tfm_get_flags(crypto_shash_tfm(tfm));
@@ -872,4 +895,24 @@ int crypto_shash_final(struct shash_desc *desc, u8 *out);
 int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 		       unsigned int len, u8 *out);
 
+/**
+ * crypto_shash_finup_mb() - calculate message digests of equal sized buffers
+ * @desc: see crypto_shash_final()
+ * @data: array of @num_msgs buffers
+ * @len: length of each buffer in bytes
+ * @outs: array of @num_msgs digest buffers
+ * @num_msgs: number of buffers, at most crypto_shash_mb_max_msgs()
+ *
+ * Every message continues from the state currently held in @desc, as if
+ * the state were copied and crypto_shash_finup() called once per buffer.
+ * The state of @desc is undefined afterwards; it has to be re-initialized
+ * or re-imported before it is used again.
+ *
+ * Return: 0 if the message digest creation was successful; < 0 if an error
+ *	   occurred
+ */
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs);
+
 #endif	/* _CRYPTO_HASH_H */
@@ -531,6 +531,13 @@ struct mm_struct {
 #ifdef CONFIG_MSM_APP_SETTINGS
 	int app_setting;
 #endif
+#ifdef CONFIG_PROCESS_RECLAIM
+	/* Idle sampling state of mm/process_reclaim.c */
+	unsigned long reclaim_idle_gen;	/* scan period idle bits were set in */
+	unsigned long reclaim_cold;	/* idle anon pages left by last walk */
+	unsigned long reclaim_last;	/* pages reclaimed by last walk */
+	atomic_long_t reclaim_swapins;	/* swap-ins since last walk */
+#endif
 
 	struct work_struct async_put_work;
 };
@@ -116,6 +116,29 @@ static inline bool task_will_free_mem(struct task_struct *task)
 extern void dump_tasks(struct mem_cgroup *memcg,
 		const nodemask_t *nodemask);
 
+/*
+ * The Android lowmemorykiller keeps thread group leaders indexed by
+ * oom_score_adj. The index hooks are called with tasklist_lock or the
+ * task's sighand lock held whenever a leader appears, goes away or
+ * changes its oom_score_adj. lowmem_victim_mm_exit() is called once the
+ * last user of an address space has dropped it.
+ */
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+extern void lowmem_adj_index_add(struct task_struct *p);
+extern void lowmem_adj_index_del(struct task_struct *p);
+extern void lowmem_adj_index_update(struct task_struct *p);
+extern void lowmem_adj_index_replace(struct task_struct *old,
+				     struct task_struct *new);
+extern void lowmem_victim_mm_exit(struct task_struct *p);
+#else
+static inline void lowmem_adj_index_add(struct task_struct *p) { }
+static inline void lowmem_adj_index_del(struct task_struct *p) { }
+static inline void lowmem_adj_index_update(struct task_struct *p) { }
+static inline void lowmem_adj_index_replace(struct task_struct *old,
+					    struct task_struct *new) { }
+static inline void lowmem_victim_mm_exit(struct task_struct *p) { }
+#endif
+
 /* sysctls */
 extern int sysctl_oom_dump_tasks;
 extern int sysctl_oom_kill_allocating_task;
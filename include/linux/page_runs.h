@@ -0,0 +1,16 @@
+#ifndef _LINUX_PAGE_RUNS_H
+#define _LINUX_PAGE_RUNS_H
+
+struct bio;
+struct bio_vec;
+struct inode;
+struct workqueue_struct;
+
+typedef void (page_run_fn)(struct inode *inode, struct bio_vec *bv,
+			   unsigned int nr);
+
+extern void process_bio_page_runs(struct bio *bio, page_run_fn *fn,
+				  unsigned int slice_pages,
+				  struct workqueue_struct *wq);
+
+#endif /* _LINUX_PAGE_RUNS_H */
@@ -1725,6 +1725,9 @@ struct task_struct {
 #endif
 
 	struct list_head tasks;
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+	struct hlist_node lmk_adj_node;	/* lowmemorykiller oom_score_adj index */
+#endif
 #ifdef CONFIG_SMP
 	struct plist_node pushable_tasks;
 	struct rb_node pushable_dl_tasks;
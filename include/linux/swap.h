@@ -251,6 +251,14 @@ struct swap_info_struct {
 	struct swap_cluster_info discard_cluster_tail; /* list tail of discard clusters */
 	unsigned int write_pending;
 	unsigned int max_writes;
+	/* swap_ratio tiering statistics, see mm/swap_ratio.c */
+	atomic_long_t tier_writes;	/* pages written since swapon */
+	atomic_long_t tier_reads;	/* pages read back (refaults) */
+	atomic_long_t tier_win_writes;	/* writes since last ratio update */
+	atomic_long_t tier_win_reads;	/* reads since last ratio update */
+	unsigned long write_lat_ns;	/* moving average write latency */
+	unsigned long read_lat_ns;	/* moving average read latency */
+	unsigned int refault_permille;	/* moving average reads per write */
 };
 
 /* linux/mm/workingset.c */
@@ -337,6 +345,7 @@ extern unsigned long shrink_all_memory(unsigned long nr_pages);
 extern int vm_swappiness;
 extern int sysctl_swap_ratio;
 extern int sysctl_swap_ratio_enable;
+extern int sysctl_swap_ratio_adaptive;
 extern int remove_mapping(struct address_space *mapping, struct page *page);
 extern unsigned long vm_total_pages;
 
@@ -404,7 +413,7 @@ extern struct address_space swapper_spaces[];
 #define swap_address_space(entry) (&swapper_spaces[swp_type(entry)])
 extern unsigned long total_swapcache_pages(void);
 extern void show_swap_cache_info(void);
-extern int add_to_swap(struct page *, struct list_head *list);
+extern int add_to_swap(struct page *, struct list_head *list, bool cold);
 extern int add_to_swap_cache(struct page *, swp_entry_t, gfp_t);
 extern int __add_to_swap_cache(struct page *page, swp_entry_t entry);
 extern void __delete_from_swap_cache(struct page *);
@@ -445,6 +454,7 @@ static inline long get_nr_swap_pages(void)
 
 extern void si_swapinfo(struct sysinfo *);
 extern swp_entry_t get_swap_page(void);
+extern swp_entry_t get_cold_swap_page(void);
 extern swp_entry_t get_swap_page_of_type(int);
 extern int add_swap_count_continuation(swp_entry_t, gfp_t);
 extern void swap_shmem_alloc(swp_entry_t);
@@ -526,7 +536,8 @@ static inline struct page *lookup_swap_cache(swp_entry_t swp)
 	return NULL;
 }
 
-static inline int add_to_swap(struct page *page, struct list_head *list)
+static inline int add_to_swap(struct page *page, struct list_head *list,
+			      bool cold)
 {
 	return 0;
 }
@@ -11,8 +11,10 @@ extern spinlock_t swap_avail_lock;
 extern struct plist_head swap_avail_head;
 extern struct swap_info_struct *swap_info[];
 extern int try_to_unuse(unsigned int, bool, unsigned long);
-extern int swap_ratio(struct swap_info_struct **si);
+extern int swap_ratio(struct swap_info_struct **si, bool cold);
 extern void setup_swap_ratio(struct swap_info_struct *p, int prio);
+extern void swap_ratio_account(struct swap_info_struct *si, bool write,
+			       u64 lat_ns);
 extern bool is_swap_ratio_group(int prio);
 extern unsigned long generic_max_swapfile_size(void);
 extern unsigned long max_swapfile_size(void);
@@ -59,6 +59,38 @@ TRACE_EVENT(process_reclaim,
 			__entry->nr_to_reclaim)
 );
 
+TRACE_EVENT(process_reclaim_idle,
+
+	TP_PROTO(int tasksize, short oom_score_adj, int nr_scanned,
+		int nr_idle, int nr_reclaimed, long swapins),
+
+	TP_ARGS(tasksize, oom_score_adj, nr_scanned, nr_idle,
+			nr_reclaimed, swapins),
+
+	TP_STRUCT__entry(
+		__field(int, tasksize)
+		__field(short, oom_score_adj)
+		__field(int, nr_scanned)
+		__field(int, nr_idle)
+		__field(int, nr_reclaimed)
+		__field(long, swapins)
+	),
+
+	TP_fast_assign(
+		__entry->tasksize	= tasksize;
+		__entry->oom_score_adj	= oom_score_adj;
+		__entry->nr_scanned	= nr_scanned;
+		__entry->nr_idle	= nr_idle;
+		__entry->nr_reclaimed	= nr_reclaimed;
+		__entry->swapins	= swapins;
+	),
+
+	TP_printk("%d, %hd, %d, %d, %d, %ld",
+			__entry->tasksize, __entry->oom_score_adj,
+			__entry->nr_scanned, __entry->nr_idle,
+			__entry->nr_reclaimed, __entry->swapins)
+);
+
 TRACE_EVENT(process_reclaim_eff,
 
 	TP_PROTO(int efficiency, int reclaim_avg_efficiency),
@@ -585,6 +585,46 @@ TRACE_EVENT(sched_update_pred_demand,
 		__entry->bucket[8], __entry->bucket[9])
 );
 
+TRACE_EVENT(sched_pred_demand_stats,
+
+	TP_PROTO(struct rq *rq, struct task_struct *p, u32 runtime,
+		 u32 old_pred, u32 pred_demand, bool hit),
+
+	TP_ARGS(rq, p, runtime, old_pred, pred_demand, hit),
+
+	TP_STRUCT__entry(
+		__array(	char,	comm,   TASK_COMM_LEN	)
+		__field(       pid_t,	pid			)
+		__field(unsigned int,	runtime			)
+		__field(unsigned int,	old_pred		)
+		__field(	 s64,	error			)
+		__field(unsigned int,	pred_demand		)
+		__field(	bool,	hit			)
+		__field(	 u64,	hits			)
+		__field(	 u64,	misses			)
+		__field(	 int,	cpu			)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		__entry->pid		= p->pid;
+		__entry->runtime	= runtime;
+		__entry->old_pred	= old_pred;
+		__entry->error		= (s64)old_pred - runtime;
+		__entry->pred_demand	= pred_demand;
+		__entry->hit		= hit;
+		__entry->hits		= rq->pred_hits;
+		__entry->misses		= rq->pred_misses;
+		__entry->cpu		= rq->cpu;
+	),
+
+	TP_printk("%d (%s): runtime %u predicted %u error %lld hit %d next %u cpu %d hits %llu misses %llu",
+		__entry->pid, __entry->comm, __entry->runtime,
+		__entry->old_pred, __entry->error, __entry->hit,
+		__entry->pred_demand, __entry->cpu,
+		__entry->hits, __entry->misses)
+);
+
 TRACE_EVENT(sched_migration_update_sum,
 
 	TP_PROTO(struct task_struct *p, enum migrate_types migrate_type, struct rq *rq),
@@ -295,6 +295,7 @@ enum transaction_flags {
 	TF_ROOT_OBJECT	= 0x04,	/* contents are the component's root object */
 	TF_STATUS_CODE	= 0x08,	/* contents are a 32-bit status code */
 	TF_ACCEPT_FDS	= 0x10,	/* allow replies with file descriptors */
+	TF_LARGE_DATA	= 0x10000, /* copy payload from pinned sender pages */
 };
 
 struct binder_transaction_data {
@@ -375,6 +375,14 @@ enum fuse_notify_code {
 	FUSE_NOTIFY_RETRIEVE = 5,
 	FUSE_NOTIFY_DELETE = 6,
 	FUSE_NOTIFY_CODE_MAX,
+
+	/*
+	 * Android extensions, only accepted on a connection mounted with
+	 * the persistent_cache option. Numbered like FUSE_CANONICAL_PATH,
+	 * well clear of the upstream codes.
+	 */
+	FUSE_NOTIFY_ENTRY = 2017,
+	FUSE_NOTIFY_BATCH = 2018,
 };
 
 /* The read buffer is required to be at least 8k, but may be much larger */
@@ -382,6 +390,13 @@ enum fuse_notify_code {
 
 #define FUSE_COMPAT_ENTRY_OUT_SIZE 120
 
+/*
+ * An entry_valid or attr_valid of FUSE_VALID_FOREVER never times out; the
+ * cached entry or attributes stay valid until invalidated, either by a
+ * local change or by a notification from the filesystem.
+ */
+#define FUSE_VALID_FOREVER ((uint64_t) -1)
+
 struct fuse_entry_out {
 	uint64_t	nodeid;		/* Inode ID */
 	uint64_t	generation;	/* Inode generation: nodeid:gen must
@@ -734,6 +749,36 @@ struct fuse_notify_delete_out {
 	uint32_t	padding;
 };
 
+/*
+ * Push a lookup result into the kernel's dentry and attribute caches.
+ * The filesystem counts it as a lookup; the kernel sends a FORGET if it
+ * can't use the entry.  Followed by the NUL terminated name.
+ */
+struct fuse_notify_entry_out {
+	uint64_t	parent;
+	uint32_t	namelen;
+	uint32_t	padding;
+	struct fuse_entry_out entry;
+};
+
+/*
+ * FUSE_NOTIFY_BATCH carries @count records, each a fuse_notify_batch_rec
+ * followed by the @size bytes of a FUSE_NOTIFY_INVAL_INODE,
+ * FUSE_NOTIFY_INVAL_ENTRY, FUSE_NOTIFY_DELETE or FUSE_NOTIFY_ENTRY
+ * notification and padded to FUSE_DIRENT_ALIGN.
+ */
+#define FUSE_NOTIFY_BATCH_MAX	(256 * 1024)
+
+struct fuse_notify_batch_out {
+	uint32_t	count;
+	uint32_t	padding;
+};
+
+struct fuse_notify_batch_rec {
+	uint32_t	code;
+	uint32_t	size;
+};
+
 struct fuse_notify_store_out {
 	uint64_t	nodeid;
 	uint64_t	offset;
@@ -761,5 +806,6 @@ struct fuse_notify_retrieve_in {
 
 /* Device ioctls: */
 #define FUSE_DEV_IOC_CLONE	_IOR(229, 0, uint32_t)
+#define FUSE_DEV_IOC_BIND_CPU	_IOW(229, 1, uint32_t)
 
 #endif /* _LINUX_FUSE_H */
@@ -73,6 +73,7 @@ static void __unhash_process(struct task_struct *p, bool group_dead)
 		detach_pid(p, PIDTYPE_SID);
 
 		list_del_rcu(&p->tasks);
+		lowmem_adj_index_del(p);
 		list_del_init(&p->sibling);
 		__this_cpu_dec(process_counts);
 	}
@@ -445,8 +446,10 @@ static void exit_mm(struct task_struct *tsk)
 	mm_released = mmput(mm);
 	if (test_thread_flag(TIF_MEMDIE))
 		exit_oom_victim();
-	if (mm_released)
+	if (mm_released) {
 		set_tsk_thread_flag(tsk, TIF_MM_RELEASED);
+		lowmem_victim_mm_exit(tsk);
+	}
 }
 
 static struct task_struct *find_alive_thread(struct task_struct *p)
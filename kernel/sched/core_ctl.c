@@ -27,6 +27,9 @@
 #define MAX_CPUS_PER_CLUSTER 4
 #define MAX_CLUSTERS 2
 
+/* number of past low-need periods used to predict the next one */
+#define LOW_NEED_HIST 8
+
 struct cluster_data {
 	bool inited;
 	unsigned int min_cpus;
@@ -53,6 +56,27 @@ struct cluster_data {
 	unsigned int first_cpu;
 	unsigned int boost;
 	struct kobject kobj;
+
+	/*
+	 * How long the need stayed below its previous level, for the last
+	 * LOW_NEED_HIST such periods, and when the current one began.
+	 */
+	unsigned int low_need_ms[LOW_NEED_HIST];
+	unsigned int low_need_idx;
+	unsigned int last_new_need;
+	s64 low_need_ts;
+
+	/* measured cost of isolating and unisolating a CPU */
+	unsigned int isolate_cost_us;
+	unsigned int unisolate_cost_us;
+	unsigned int break_even_ms;
+
+	/* transitions and time (ms) spent at each active CPU count */
+	u64 nr_active_up;
+	u64 nr_active_down;
+	u64 active_time_ms[MAX_CPUS_PER_CLUSTER + 1];
+	unsigned int stat_active_cpus;
+	s64 stat_ts;
 };
 
 struct cpu_data {
@@ -271,6 +295,63 @@ static ssize_t show_enable(const struct cluster_data *state, char *buf)
 	return scnprintf(buf, PAGE_SIZE, "%u\n", state->enable);
 }
 
+static ssize_t store_break_even_ms(struct cluster_data *state,
+				   const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u\n", &val) != 1)
+		return -EINVAL;
+
+	state->break_even_ms = val;
+	apply_need(state);
+
+	return count;
+}
+
+static unsigned int cluster_break_even_ms(const struct cluster_data *cluster);
+static unsigned int predict_low_need_ms(const struct cluster_data *cluster);
+
+static ssize_t show_break_even_ms(const struct cluster_data *state, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", cluster_break_even_ms(state));
+}
+
+static ssize_t show_stats(const struct cluster_data *cluster, char *buf)
+{
+	ssize_t count = 0;
+	unsigned int i;
+	s64 now = ktime_to_ms(ktime_get());
+	u64 time_ms;
+
+	spin_lock_irq(&state_lock);
+	count += snprintf(buf + count, PAGE_SIZE - count,
+			"Active CPU count up: %llu\n", cluster->nr_active_up);
+	count += snprintf(buf + count, PAGE_SIZE - count,
+			"Active CPU count down: %llu\n",
+			cluster->nr_active_down);
+	for (i = 0; i <= cluster->num_cpus; i++) {
+		time_ms = cluster->active_time_ms[i];
+		if (i == cluster->stat_active_cpus && cluster->stat_ts)
+			time_ms += now - cluster->stat_ts;
+		count += snprintf(buf + count, PAGE_SIZE - count,
+				"Time at %u active (ms): %llu\n", i, time_ms);
+	}
+	count += snprintf(buf + count, PAGE_SIZE - count,
+			"Isolate cost (us): %u\n", cluster->isolate_cost_us);
+	count += snprintf(buf + count, PAGE_SIZE - count,
+			"Unisolate cost (us): %u\n",
+			cluster->unisolate_cost_us);
+	count += snprintf(buf + count, PAGE_SIZE - count,
+			"Break-even (ms): %u\n", cluster_break_even_ms(cluster));
+	count += snprintf(buf + count, PAGE_SIZE - count,
+			"Predicted low need (ms): %u\n",
+			predict_low_need_ms(cluster));
+	spin_unlock_irq(&state_lock);
+
+	return count;
+}
+
 static ssize_t show_need_cpus(const struct cluster_data *state, char *buf)
 {
 	return snprintf(buf, PAGE_SIZE, "%u\n", state->need_cpus);
@@ -400,6 +481,8 @@ core_ctl_attr_ro(active_cpus);
 core_ctl_attr_ro(global_state);
 core_ctl_attr_rw(not_preferred);
 core_ctl_attr_rw(enable);
+core_ctl_attr_rw(break_even_ms);
+core_ctl_attr_ro(stats);
 
 static struct attribute *default_attrs[] = {
 	&min_cpus.attr,
@@ -414,6 +497,8 @@ static struct attribute *default_attrs[] = {
 	&active_cpus.attr,
 	&global_state.attr,
 	&not_preferred.attr,
+	&break_even_ms.attr,
+	&stats.attr,
 	NULL
 };
 
@@ -543,6 +628,111 @@ static unsigned int get_active_cpu_count(const struct cluster_data *cluster)
 				sched_isolate_count(&cluster->cpu_mask, true);
 }
 
+/*
+ * Account the time spent at the current active CPU count and count the
+ * transition if it changed. Called with state_lock held.
+ */
+static void account_active_time(struct cluster_data *cluster, s64 now)
+{
+	if (cluster->stat_ts)
+		cluster->active_time_ms[cluster->stat_active_cpus] +=
+						now - cluster->stat_ts;
+	cluster->stat_ts = now;
+}
+
+static void update_active_cpus(struct cluster_data *cluster)
+{
+	unsigned int active = get_active_cpu_count(cluster);
+
+	cluster->active_cpus = active;
+	if (active == cluster->stat_active_cpus)
+		return;
+
+	account_active_time(cluster, ktime_to_ms(ktime_get()));
+	if (active > cluster->stat_active_cpus)
+		cluster->nr_active_up++;
+	else
+		cluster->nr_active_down++;
+	cluster->stat_active_cpus = active;
+}
+
+/* Fold a measured isolation or unisolation latency into an average */
+static void update_cost(unsigned int *cost_us, ktime_t start)
+{
+	unsigned int sample = ktime_us_delta(ktime_get(), start);
+
+	if (!*cost_us)
+		*cost_us = sample;
+	else
+		*cost_us = (*cost_us * 7 + sample) / 8;
+}
+
+/*
+ * A CPU taken out and brought back costs at least the measured latency of
+ * the two transitions. It also costs migrating its tasks and refilling
+ * its caches afterwards, which that latency does not show. An isolation
+ * shorter than BREAK_EVEN_SCALE times that latency is assumed to cost more
+ * than it saves.
+ */
+#define BREAK_EVEN_SCALE	64
+
+static unsigned int cluster_break_even_ms(const struct cluster_data *cluster)
+{
+	unsigned int cost_us;
+
+	if (cluster->break_even_ms)
+		return cluster->break_even_ms;
+
+	cost_us = cluster->isolate_cost_us + cluster->unisolate_cost_us;
+	return DIV_ROUND_UP(cost_us * BREAK_EVEN_SCALE, USEC_PER_MSEC);
+}
+
+/* Expected length of a low-need period: the mean of recent ones */
+static unsigned int predict_low_need_ms(const struct cluster_data *cluster)
+{
+	unsigned int i, n = 0;
+	u64 sum = 0;
+
+	for (i = 0; i < LOW_NEED_HIST; i++) {
+		if (!cluster->low_need_ms[i])
+			continue;
+		sum += cluster->low_need_ms[i];
+		n++;
+	}
+
+	return n ? div_u64(sum, n) : 0;
+}
+
+/*
+ * Track how long the need stays down each time it drops, and return
+ * whether the period the cluster is in now is expected to last long
+ * enough to be worth isolating CPUs for: either recent ones did, or this
+ * one already has. Called with state_lock held.
+ */
+static bool low_need_worth_isolating(struct cluster_data *cluster,
+				     unsigned int new_need, s64 now)
+{
+	unsigned int break_even = cluster_break_even_ms(cluster);
+
+	if (new_need < cluster->last_new_need) {
+		if (!cluster->low_need_ts)
+			cluster->low_need_ts = now;
+	} else if (new_need > cluster->last_new_need && cluster->low_need_ts) {
+		cluster->low_need_ms[cluster->low_need_idx] =
+				max_t(s64, now - cluster->low_need_ts, 1);
+		cluster->low_need_idx = (cluster->low_need_idx + 1) %
+							LOW_NEED_HIST;
+		cluster->low_need_ts = 0;
+	}
+	cluster->last_new_need = new_need;
+
+	if (!break_even)
+		return true;
+	if (cluster->low_need_ts && now - cluster->low_need_ts >= break_even)
+		return true;
+	return predict_low_need_ms(cluster) >= break_even;
+}
+
 static bool is_active(const struct cpu_data *state)
 {
 	return cpu_online(state->cpu) && !cpu_isolated(state->cpu);
@@ -564,6 +754,7 @@ static bool eval_need(struct cluster_data *cluster)
 	bool need_flag = false;
 	unsigned int new_need;
 	s64 now, elapsed;
+	bool worth_isolating, need_driven = false;
 
 	if (unlikely(!cluster->inited))
 		return 0;
@@ -573,7 +764,7 @@ static bool eval_need(struct cluster_data *cluster)
 	if (cluster->boost || !cluster->enable) {
 		need_cpus = cluster->max_cpus;
 	} else {
-		cluster->active_cpus = get_active_cpu_count(cluster);
+		update_active_cpus(cluster);
 		thres_idx = cluster->active_cpus ? cluster->active_cpus - 1 : 0;
 		list_for_each_entry(c, &cluster->lru, sib) {
 			if (c->busy >= cluster->busy_up_thres[thres_idx] ||
@@ -584,12 +775,17 @@ static bool eval_need(struct cluster_data *cluster)
 			need_cpus += c->is_busy;
 		}
 		need_cpus = apply_task_need(cluster, need_cpus);
+		need_driven = true;
 	}
 	new_need = apply_limits(cluster, need_cpus);
+	/* capped by max_cpus rather than following the need down */
+	if (new_need < need_cpus)
+		need_driven = false;
 	need_flag = adjustment_possible(cluster, new_need);
 
 	last_need = cluster->need_cpus;
 	now = ktime_to_ms(ktime_get());
+	worth_isolating = low_need_worth_isolating(cluster, new_need, now);
 
 	if (new_need > cluster->active_cpus) {
 		ret = 1;
@@ -602,6 +798,16 @@ static bool eval_need(struct cluster_data *cluster)
 
 		elapsed =  now - cluster->need_ts;
 		ret = elapsed >= cluster->offline_delay_ms;
+
+		/*
+		 * Don't isolate for a dip that is expected to end before
+		 * isolating pays for itself; a periodic load would just
+		 * bring the CPUs straight back. A lower max_cpus is not a
+		 * dip and is applied regardless.
+		 */
+		if (new_need < cluster->active_cpus && need_driven &&
+		    !worth_isolating)
+			ret = 0;
 	}
 
 	if (ret) {
@@ -745,6 +951,7 @@ static void try_to_isolate(struct cluster_data *cluster, unsigned int need)
 	unsigned long flags;
 	unsigned int num_cpus = cluster->num_cpus;
 	unsigned int nr_isolated = 0;
+	ktime_t start;
 
 	/*
 	 * Protect against entry being removed (and added at tail) by other
@@ -766,15 +973,17 @@ static void try_to_isolate(struct cluster_data *cluster, unsigned int need)
 		spin_unlock_irqrestore(&state_lock, flags);
 
 		pr_debug("Trying to isolate CPU%u\n", c->cpu);
+		start = ktime_get();
 		if (!sched_isolate_cpu(c->cpu)) {
+			update_cost(&cluster->isolate_cost_us, start);
 			c->isolated_by_us = true;
 			move_cpu_lru(c);
 			nr_isolated++;
 		} else {
 			pr_debug("Unable to isolate CPU%u\n", c->cpu);
 		}
-		cluster->active_cpus = get_active_cpu_count(cluster);
 		spin_lock_irqsave(&state_lock, flags);
+		update_active_cpus(cluster);
 	}
 	cluster->nr_isolated_cpus += nr_isolated;
 	spin_unlock_irqrestore(&state_lock, flags);
@@ -801,15 +1010,17 @@ static void try_to_isolate(struct cluster_data *cluster, unsigned int need)
 		spin_unlock_irqrestore(&state_lock, flags);
 
 		pr_debug("Trying to isolate CPU%u\n", c->cpu);
+		start = ktime_get();
 		if (!sched_isolate_cpu(c->cpu)) {
+			update_cost(&cluster->isolate_cost_us, start);
 			c->isolated_by_us = true;
 			move_cpu_lru(c);
 			nr_isolated++;
 		} else {
 			pr_debug("Unable to isolate CPU%u\n", c->cpu);
 		}
-		cluster->active_cpus = get_active_cpu_count(cluster);
 		spin_lock_irqsave(&state_lock, flags);
+		update_active_cpus(cluster);
 	}
 	cluster->nr_isolated_cpus += nr_isolated;
 	spin_unlock_irqrestore(&state_lock, flags);
@@ -823,6 +1034,7 @@ static void __try_to_unisolate(struct cluster_data *cluster,
 	unsigned long flags;
 	unsigned int num_cpus = cluster->num_cpus;
 	unsigned int nr_unisolated = 0;
+	ktime_t start;
 
 	/*
 	 * Protect against entry being removed (and added at tail) by other
@@ -844,15 +1056,17 @@ static void __try_to_unisolate(struct cluster_data *cluster,
 		spin_unlock_irqrestore(&state_lock, flags);
 
 		pr_debug("Trying to unisolate CPU%u\n", c->cpu);
+		start = ktime_get();
 		if (!sched_unisolate_cpu(c->cpu)) {
+			update_cost(&cluster->unisolate_cost_us, start);
 			c->isolated_by_us = false;
 			move_cpu_lru(c);
 			nr_unisolated++;
 		} else {
 			pr_debug("Unable to unisolate CPU%u\n", c->cpu);
 		}
-		cluster->active_cpus = get_active_cpu_count(cluster);
 		spin_lock_irqsave(&state_lock, flags);
+		update_active_cpus(cluster);
 	}
 	cluster->nr_isolated_cpus -= nr_unisolated;
 	spin_unlock_irqrestore(&state_lock, flags);
@@ -928,7 +1142,9 @@ static int __ref cpu_callback(struct notifier_block *nfb,
 
 	switch (action & ~CPU_TASKS_FROZEN) {
 	case CPU_ONLINE:
-		cluster->active_cpus = get_active_cpu_count(cluster);
+		spin_lock_irqsave(&state_lock, flags);
+		update_active_cpus(cluster);
+		spin_unlock_irqrestore(&state_lock, flags);
 
 		/*
 		 * Moving to the end of the list should only happen in
@@ -954,7 +1170,9 @@ static int __ref cpu_callback(struct notifier_block *nfb,
 		move_cpu_lru(state);
 
 		state->busy = 0;
-		cluster->active_cpus = get_active_cpu_count(cluster);
+		spin_lock_irqsave(&state_lock, flags);
+		update_active_cpus(cluster);
+		spin_unlock_irqrestore(&state_lock, flags);
 		break;
 	default:
 		return NOTIFY_DONE;
@@ -1081,6 +1299,9 @@ static int cluster_init(const struct cpumask *mask)
 		list_add_tail(&state->sib, &cluster->lru);
 	}
 	cluster->active_cpus = get_active_cpu_count(cluster);
+	cluster->last_new_need = cluster->need_cpus;
+	cluster->stat_active_cpus = cluster->active_cpus;
+	cluster->stat_ts = ktime_to_ms(ktime_get());
 
 	cluster->core_ctl_thread = kthread_run(try_core_ctl, (void *) cluster,
 					"core_ctl/%d", first_cpu);
@@ -2506,16 +2506,31 @@ done:
 					new_window, full_window);
 }
 
+/*
+ * Score the prediction made for the window that just closed with busy
+ * time @runtime, then fold @runtime into the histogram and predict the
+ * next window. A prediction hits when it reached @runtime's bucket, so
+ * that the frequency it asked for was enough.
+ */
 static inline u32 predict_and_update_buckets(struct rq *rq,
 			struct task_struct *p, u32 runtime) {
 
 	int bidx;
+	u32 old = p->ravg.pred_demand;
 	u32 pred_demand;
+	bool hit;
 
 	bidx = busy_to_bucket(runtime);
+	hit = busy_to_bucket(old) >= bidx;
+	if (hit)
+		rq->pred_hits++;
+	else
+		rq->pred_misses++;
+
 	pred_demand = get_pred_busy(rq, p, bidx, runtime);
 	bucket_increase(p->ravg.busy_buckets, bidx);
 
+	trace_sched_pred_demand_stats(rq, p, runtime, old, pred_demand, hit);
 	return pred_demand;
 }
 
@@ -816,6 +816,8 @@ struct rq {
 	u8 curr_table;
 	int prev_top;
 	int curr_top;
+	u64 pred_hits;
+	u64 pred_misses;
 #endif
 
 #ifdef CONFIG_SCHED_WALT
@@ -1917,6 +1917,13 @@ static struct ctl_table vm_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec_minmax,
 	},
+	{
+		.procname	= "swap_ratio_adaptive",
+		.data		= &sysctl_swap_ratio_adaptive,
+		.maxlen		= sizeof(sysctl_swap_ratio_adaptive),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+	},
 #endif
 	{ }
 };
@@ -22,6 +22,7 @@
 #include <linux/frontswap.h>
 #include <linux/blkdev.h>
 #include <linux/uio.h>
+#include <linux/swapfile.h>
 #include <asm/pgtable.h>
 
 static struct bio *get_swap_bio(gfp_t gfp_flags,
@@ -34,6 +35,8 @@ static struct bio *get_swap_bio(gfp_t gfp_flags,
 		bio->bi_iter.bi_sector = map_swap_page(page, &bio->bi_bdev);
 		bio->bi_iter.bi_sector <<= PAGE_SHIFT - 9;
 		bio->bi_end_io = end_io;
+		/* submission time, for the swap_ratio latency averages */
+		bio->bi_private = (void *)(unsigned long)ktime_get_ns();
 
 		bio_add_page(bio, page, PAGE_SIZE, 0);
 		BUG_ON(bio->bi_iter.bi_size != PAGE_SIZE);
@@ -41,6 +44,15 @@ static struct bio *get_swap_bio(gfp_t gfp_flags,
 	return bio;
 }
 
+static void swap_bio_account(struct bio *bio, struct page *page, bool write)
+{
+	unsigned long start = (unsigned long)bio->bi_private;
+
+	if (start && PageSwapCache(page))
+		swap_ratio_account(page_swap_info(page), write,
+				   (unsigned long)ktime_get_ns() - start);
+}
+
 void end_swap_bio_write(struct bio *bio)
 {
 	struct page *page = bio->bi_io_vec[0].bv_page;
@@ -61,6 +73,8 @@ void end_swap_bio_write(struct bio *bio)
 				iminor(bio->bi_bdev->bd_inode),
 				(unsigned long long)bio->bi_iter.bi_sector);
 		ClearPageReclaim(page);
+	} else {
+		swap_bio_account(bio, page, true);
 	}
 	end_page_writeback(page);
 	bio_put(bio);
@@ -81,6 +95,7 @@ static void end_swap_bio_read(struct bio *bio)
 	}
 
 	SetPageUptodate(page);
+	swap_bio_account(bio, page, false);
 
 	/*
 	 * There is no guarantee that the page is in swap cache - the software
@@ -255,6 +270,7 @@ int __swap_writepage(struct page *page, struct writeback_control *wbc,
 	struct bio *bio;
 	int ret, rw = WRITE;
 	struct swap_info_struct *sis = page_swap_info(page);
+	u64 start;
 
 	if (sis->flags & SWP_FILE) {
 		struct kiocb kiocb;
@@ -297,8 +313,10 @@ int __swap_writepage(struct page *page, struct writeback_control *wbc,
 		return ret;
 	}
 
+	start = ktime_get_ns();
 	ret = bdev_write_page(sis->bdev, swap_page_sector(page), page, wbc);
 	if (!ret) {
+		swap_ratio_account(sis, true, ktime_get_ns() - start);
 		count_vm_event(PSWPOUT);
 		return 0;
 	}
@@ -326,6 +344,7 @@ int swap_readpage(struct page *page)
 	struct bio *bio;
 	int ret = 0;
 	struct swap_info_struct *sis = page_swap_info(page);
+	u64 start;
 
 	VM_BUG_ON_PAGE(!PageLocked(page), page);
 	VM_BUG_ON_PAGE(PageUptodate(page), page);
@@ -345,8 +364,10 @@ int swap_readpage(struct page *page)
 		return ret;
 	}
 
+	start = ktime_get_ns();
 	ret = bdev_read_page(sis->bdev, swap_page_sector(page), page);
 	if (!ret) {
+		swap_ratio_account(sis, false, ktime_get_ns() - start);
 		count_vm_event(PSWPIN);
 		return 0;
 	}
@@ -20,6 +20,8 @@
 #include <linux/rcupdate.h>
 #include <linux/notifier.h>
 #include <linux/vmpressure.h>
+#include <linux/sizes.h>
+#include <linux/math64.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/process_reclaim.h>
@@ -52,6 +54,32 @@ static short min_score_adj = 360;
 module_param_named(min_score_adj, min_score_adj, short,
 	S_IRUGO | S_IWUSR);
 
+/*
+ * Only anon pages which have stayed idle for idle_age_periods process
+ * reclaim runs are reclaimed. A process is walked once to set the idle
+ * bits on its pages and is not looked at again until that many runs
+ * have passed; the next walk reclaims what is still idle and re-arms
+ * the rest.
+ */
+static int idle_age_periods = 2;
+module_param_named(idle_age_periods, idle_age_periods, int,
+	S_IRUGO | S_IWUSR);
+
+/*
+ * Swap-ins of victims per MB reclaimed from them, over all runs since
+ * boot. Every swap-in is counted, including those of pages that were
+ * swapped out by kswapd or direct reclaim, so this is an upper bound on
+ * the refaults caused by process reclaim. Lower is better.
+ */
+static int reclaim_swapins_per_mb;
+module_param_named(reclaim_swapins_per_mb, reclaim_swapins_per_mb,
+			int, S_IRUGO);
+
+/* Only touched by swap_fn, which never runs concurrently */
+static unsigned long reclaim_gen = 1;
+static u64 total_victim_reclaimed;
+static u64 total_victim_swapins;
+
 /*
  * Scheduling process reclaim workqueue unecessarily
  * when the reclaim efficiency is low does not make
@@ -75,6 +103,8 @@ struct selected_task {
 	struct task_struct *p;
 	int tasksize;
 	short oom_score_adj;
+	/* only set the idle bits, nothing is known to be cold yet */
+	bool sample;
 };
 
 int selected_cmp(const void *a, const void *b)
@@ -107,12 +137,62 @@ static int test_task_flag(struct task_struct *p, int flag)
 	return 0;
 }
 
+/*
+ * Estimated cold anon pages of @mm, discounted by the swap-ins of @mm
+ * since the last walk relative to what that walk reclaimed. Called with
+ * the owning task locked.
+ */
+static int reclaim_score(struct mm_struct *mm, int anon)
+{
+	unsigned long cold = min_t(unsigned long, mm->reclaim_cold, anon);
+	unsigned long swapins = atomic_long_read(&mm->reclaim_swapins);
+	unsigned long rate;
+
+	if (!mm->reclaim_last)
+		return cold;
+
+	/* swap-ins as a percentage of the last reclaim, capped at 10x */
+	rate = min(swapins * 100 / mm->reclaim_last, 1000UL);
+
+	return cold * 100 / (100 + rate);
+}
+
+/*
+ * Record the outcome of an idle walk of @p: when it happened and how
+ * much is still cold. Returns the swap-ins of @p since the previous
+ * walk.
+ */
+static long reclaim_update_mm(struct task_struct *p, struct reclaim_param *rp)
+{
+	struct mm_struct *mm;
+	long swapins;
+
+	mm = get_task_mm(p);
+	if (!mm)
+		return 0;
+
+	swapins = atomic_long_xchg(&mm->reclaim_swapins, 0);
+	if (mm->reclaim_last) {
+		total_victim_swapins += swapins;
+	} else {
+		/* swap-ins before we reclaimed anything aren't ours */
+		swapins = 0;
+	}
+
+	mm->reclaim_idle_gen = reclaim_gen;
+	mm->reclaim_cold = rp->nr_idle - rp->nr_reclaimed;
+	mm->reclaim_last = rp->nr_reclaimed;
+	mmput(mm);
+
+	return swapins;
+}
+
 static void swap_fn(struct work_struct *work)
 {
 	struct task_struct *tsk;
 	struct reclaim_param rp;
 
-	/* Pick the best MAX_SWAP_TASKS tasks in terms of anon size */
+	/* Pick the best MAX_SWAP_TASKS tasks in terms of cold anon size */
 	struct selected_task selected[MAX_SWAP_TASKS] = {{0, 0, 0},};
 	int si = 0;
 	int i;
@@ -120,13 +200,18 @@ static void swap_fn(struct work_struct *work)
 	int total_sz = 0;
 	int total_scan = 0;
 	int total_reclaimed = 0;
+	int nr_sample = 0;
 	int nr_to_reclaim;
 	int efficiency;
+	long swapins;
 
 	rcu_read_lock();
 	for_each_process(tsk) {
 		struct task_struct *p;
+		struct mm_struct *mm;
 		short oom_score_adj;
+		bool sample;
+		int anon;
 
 		if (tsk->flags & PF_KTHREAD)
 			continue;
@@ -144,34 +229,57 @@ static void swap_fn(struct work_struct *work)
 			continue;
 		}
 
-		tasksize = get_mm_counter(p->mm, MM_ANONPAGES);
+		mm = p->mm;
+		if (mm->reclaim_idle_gen &&
+		    reclaim_gen - mm->reclaim_idle_gen < idle_age_periods) {
+			/* idle bits are too young to tell anything yet */
+			task_unlock(p);
+			continue;
+		}
+
+		anon = get_mm_counter(mm, MM_ANONPAGES);
+		tasksize = 0;
+		if (mm->reclaim_idle_gen)
+			tasksize = reclaim_score(mm, anon);
+		/*
+		 * Never sampled, or nothing was cold last time: resample.
+		 * With an idle estimate of 0 such a task only takes a free
+		 * slot and gives way to any task known to have cold pages.
+		 */
+		sample = !tasksize;
 		task_unlock(p);
 
-		if (tasksize <= 0)
+		if (!anon)
 			continue;
 
 		if (si == MAX_SWAP_TASKS) {
 			sort(&selected[0], MAX_SWAP_TASKS,
 					sizeof(struct selected_task),
 					&selected_cmp, NULL);
-			if (tasksize < selected[0].tasksize)
+			if (tasksize <= selected[0].tasksize)
 				continue;
 			selected[0].p = p;
 			selected[0].oom_score_adj = oom_score_adj;
 			selected[0].tasksize = tasksize;
+			selected[0].sample = sample;
 		} else {
 			selected[si].p = p;
 			selected[si].oom_score_adj = oom_score_adj;
 			selected[si].tasksize = tasksize;
+			selected[si].sample = sample;
 			si++;
 		}
 	}
 
-	for (i = 0; i < si; i++)
-		total_sz += selected[i].tasksize;
+	for (i = 0; i < si; i++) {
+		if (selected[i].sample)
+			nr_sample++;
+		else
+			total_sz += selected[i].tasksize;
+	}
 
 	/* Skip reclaim if total size is too less */
-	if (total_sz < SWAP_CLUSTER_MAX) {
+	if (total_sz < SWAP_CLUSTER_MAX && !nr_sample) {
 		rcu_read_unlock();
 		return;
 	}
@@ -182,22 +290,40 @@ static void swap_fn(struct work_struct *work)
 	rcu_read_unlock();
 
 	while (si--) {
-		nr_to_reclaim =
-			(selected[si].tasksize * per_swap_size) / total_sz;
-		/* scan atleast a page */
-		if (!nr_to_reclaim)
-			nr_to_reclaim = 1;
+		if (selected[si].sample || total_sz < SWAP_CLUSTER_MAX) {
+			nr_to_reclaim = 0;
+		} else {
+			nr_to_reclaim = (selected[si].tasksize *
+					per_swap_size) / total_sz;
+			/* scan atleast a page */
+			if (!nr_to_reclaim)
+				nr_to_reclaim = 1;
+		}
 
-		rp = reclaim_task_anon(selected[si].p, nr_to_reclaim);
+		rp = reclaim_task_idle_anon(selected[si].p, nr_to_reclaim);
+		swapins = reclaim_update_mm(selected[si].p, &rp);
 
-		trace_process_reclaim(selected[si].tasksize,
+		trace_process_reclaim_idle(selected[si].tasksize,
 				selected[si].oom_score_adj, rp.nr_scanned,
-				rp.nr_reclaimed, per_swap_size, total_sz,
-				nr_to_reclaim);
-		total_scan += rp.nr_scanned;
-		total_reclaimed += rp.nr_reclaimed;
+				rp.nr_idle, rp.nr_reclaimed, swapins);
+		if (nr_to_reclaim) {
+			trace_process_reclaim(selected[si].tasksize,
+					selected[si].oom_score_adj,
+					rp.nr_scanned, rp.nr_reclaimed,
+					per_swap_size, total_sz,
+					nr_to_reclaim);
+			total_scan += rp.nr_scanned;
+			total_reclaimed += rp.nr_reclaimed;
+		}
 		put_task_struct(selected[si].p);
 	}
+	reclaim_gen++;
+
+	if (total_reclaimed) {
+		total_victim_reclaimed += total_reclaimed;
+		reclaim_swapins_per_mb = div64_u64(total_victim_swapins *
+				(SZ_1M >> PAGE_SHIFT), total_victim_reclaimed);
+	}
 
 	if (total_scan) {
 		efficiency = (total_reclaimed * 100) / total_scan;
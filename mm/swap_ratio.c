@@ -14,6 +14,9 @@
 #include <linux/mm_types.h>
 #include <linux/swapfile.h>
 #include <linux/swap.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/math64.h>
 
 #define SWAP_RATIO_GROUP_START (SWAP_FLAG_PRIO_MASK - 9) /* 32758 */
 #define SWAP_RATIO_GROUP_END (SWAP_FLAG_PRIO_MASK) /* 32767 */
@@ -30,6 +33,82 @@ int sysctl_swap_ratio = 100;
 /* Enable the swap ratio feature */
 int sysctl_swap_ratio_enable;
 
+/*
+ * Derive the fast/slow split from the measured cost of each device
+ * instead of using swap_ratio. The cost of a page on a device is its
+ * write latency plus its read latency weighted by how often pages
+ * written there are read back. Each device gets a share of the writes
+ * inversely proportional to its cost.
+ */
+int sysctl_swap_ratio_adaptive;
+
+/* Latency averages move by 1/8th of the difference per sample */
+#define SWAP_LAT_SHIFT 3
+
+void swap_ratio_account(struct swap_info_struct *si, bool write, u64 lat_ns)
+{
+	unsigned long *avg;
+	unsigned long old;
+
+	if (write) {
+		atomic_long_inc(&si->tier_writes);
+		atomic_long_inc(&si->tier_win_writes);
+		avg = &si->write_lat_ns;
+	} else {
+		atomic_long_inc(&si->tier_reads);
+		atomic_long_inc(&si->tier_win_reads);
+		avg = &si->read_lat_ns;
+	}
+
+	/* racy, but a lost sample doesn't matter for an average */
+	old = READ_ONCE(*avg);
+	if (old)
+		WRITE_ONCE(*avg, old - (old >> SWAP_LAT_SHIFT) +
+				((unsigned long)lat_ns >> SWAP_LAT_SHIFT));
+	else
+		WRITE_ONCE(*avg, lat_ns);
+}
+
+/* Fold the reads and writes since the last call into refault_permille */
+static void swap_ratio_update_refaults(struct swap_info_struct *si)
+{
+	long writes = atomic_long_xchg(&si->tier_win_writes, 0);
+	long reads = atomic_long_xchg(&si->tier_win_reads, 0);
+	unsigned int rate;
+
+	if (!writes && !reads)
+		return;
+
+	rate = min_t(long, reads * 1000 / max(writes, 1L), 10000);
+	si->refault_permille = (si->refault_permille * 3 + rate) / 4;
+}
+
+static u64 swap_tier_cost(struct swap_info_struct *si)
+{
+	return si->write_lat_ns +
+		div_u64((u64)si->read_lat_ns * si->refault_permille, 1000);
+}
+
+/* Share of writes in percent that should go to the @fast device */
+static int swap_ratio_measured(struct swap_info_struct *fast,
+			struct swap_info_struct *slow)
+{
+	u64 fast_cost, slow_cost;
+
+	swap_ratio_update_refaults(fast);
+	swap_ratio_update_refaults(slow);
+
+	/* nothing measured yet on one side, keep the static split */
+	if (!fast->write_lat_ns || !slow->write_lat_ns)
+		return sysctl_swap_ratio;
+
+	fast_cost = swap_tier_cost(fast);
+	slow_cost = swap_tier_cost(slow);
+
+	return clamp_t(int, div64_u64(slow_cost * 100, fast_cost + slow_cost),
+			1, 99);
+}
+
 static bool is_same_group(struct swap_info_struct *a,
 		struct swap_info_struct *b)
 {
@@ -60,6 +139,9 @@ static int calculate_write_pending(struct swap_info_struct *si,
 	if ((n->flags & SWP_FAST) || !is_same_group(si, n))
 		return -ENODEV;
 
+	if (sysctl_swap_ratio_adaptive)
+		ratio = swap_ratio_measured(si, n);
+
 	si->max_writes = ratio ? SWAP_FAST_WRITES : 0;
 	n->max_writes  = ratio ? (SWAP_FAST_WRITES * 100) /
 			ratio - SWAP_FAST_WRITES : SWAP_SLOW_WRITES;
@@ -166,6 +248,34 @@ skip:
 	return ret;
 }
 
+/*
+ * Cold pages skip the write accounting and go to the slow device of the
+ * group if there is one, falling back to the regular split otherwise.
+ */
+static int swap_ratio_cold(struct swap_info_struct **si)
+{
+	struct swap_info_struct *n;
+
+	if (!((*si)->flags & SWP_FAST))
+		return 0;
+
+	spin_lock(&swap_avail_lock);
+	if (&(*si)->avail_list == plist_last(&swap_avail_head)) {
+		spin_unlock(&swap_avail_lock);
+		return swap_ratio_slow(si);
+	}
+	n = plist_next_entry(&(*si)->avail_list,
+			struct swap_info_struct,
+			avail_list);
+	spin_unlock(&swap_avail_lock);
+
+	if (n == *si || (n->flags & SWP_FAST) || !is_same_group(*si, n))
+		return swap_ratio_slow(si);
+
+	*si = n;
+	return 0;
+}
+
 bool is_swap_ratio_group(int prio)
 {
 	return ((prio >= SWAP_RATIO_GROUP_START) &&
@@ -182,15 +292,81 @@ void setup_swap_ratio(struct swap_info_struct *p, int prio)
 			p->write_pending = SWAP_SLOW_WRITES;
 		p->max_writes =  p->write_pending;
 	}
+
+	atomic_long_set(&p->tier_writes, 0);
+	atomic_long_set(&p->tier_reads, 0);
+	atomic_long_set(&p->tier_win_writes, 0);
+	atomic_long_set(&p->tier_win_reads, 0);
+	p->write_lat_ns = 0;
+	p->read_lat_ns = 0;
+	p->refault_permille = 0;
 }
 
-int swap_ratio(struct swap_info_struct **si)
+int swap_ratio(struct swap_info_struct **si, bool cold)
 {
 	if (!sysctl_swap_ratio_enable)
 		return -ENODEV;
 
-	if (is_swap_ratio_group((*si)->prio))
-		return swap_ratio_slow(si);
-	else
+	if (!is_swap_ratio_group((*si)->prio))
 		return -ENODEV;
+
+	if (cold)
+		return swap_ratio_cold(si);
+
+	return swap_ratio_slow(si);
+}
+
+/* /sys/kernel/mm/swap_ratio/tiers: one line per active swap device */
+static ssize_t tiers_show(struct kobject *kobj,
+			  struct kobj_attribute *attr, char *buf)
+{
+	struct swap_info_struct *si;
+	ssize_t len;
+	int type;
+
+	len = scnprintf(buf, PAGE_SIZE,
+			"type  prio fast      writes       reads write_lat_us read_lat_us refault_permille max_writes\n");
+
+	spin_lock(&swap_lock);
+	for (type = 0; type < MAX_SWAPFILES; type++) {
+		si = swap_info[type];
+		if (!si || !(si->flags & SWP_WRITEOK))
+			continue;
+
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				"%4d %5d %4d %11ld %11ld %12lu %11lu %16u %10u\n",
+				type, si->prio, !!(si->flags & SWP_FAST),
+				atomic_long_read(&si->tier_writes),
+				atomic_long_read(&si->tier_reads),
+				si->write_lat_ns / NSEC_PER_USEC,
+				si->read_lat_ns / NSEC_PER_USEC,
+				si->refault_permille, si->max_writes);
+	}
+	spin_unlock(&swap_lock);
+
+	return len;
+}
+
+static struct kobj_attribute tiers_attr = __ATTR_RO(tiers);
+
+static struct attribute *swap_ratio_attrs[] = {
+	&tiers_attr.attr,
+	NULL,
+};
+
+static struct attribute_group swap_ratio_attr_group = {
+	.attrs = swap_ratio_attrs,
+	.name = "swap_ratio",
+};
+
+static int __init swap_ratio_init(void)
+{
+	int err;
+
+	err = sysfs_create_group(mm_kobj, &swap_ratio_attr_group);
+	if (err)
+		pr_err("swap_ratio: register sysfs failed\n");
+
+	return err;
 }
+subsys_initcall(swap_ratio_init);
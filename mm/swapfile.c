@@ -657,7 +657,11 @@ no_page:
 	return 0;
 }
 
-swp_entry_t get_swap_page(void)
+/*
+ * @cold pages are known not to have been touched for a while; in a
+ * swap_ratio group they go straight to the slow device.
+ */
+static swp_entry_t __get_swap_page(bool cold)
 {
 	struct swap_info_struct *si, *next;
 	pgoff_t offset;
@@ -677,7 +681,7 @@ start_over:
 			int ret;
 
 			spin_unlock(&swap_avail_lock);
-			ret = swap_ratio(&si);
+			ret = swap_ratio(&si, cold);
 			if (0 > ret) {
 				/*
 				 * Error. Start again with swap
@@ -742,6 +746,16 @@ noswap:
 	return (swp_entry_t) {0};
 }
 
+swp_entry_t get_swap_page(void)
+{
+	return __get_swap_page(false);
+}
+
+swp_entry_t get_cold_swap_page(void)
+{
+	return __get_swap_page(true);
+}
+
 /* The only caller of this function is now suspend routine */
 swp_entry_t get_swap_page_of_type(int type)
 {
@@ -2622,8 +2636,9 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 	if (swap_flags & SWAP_FLAG_PREFER) {
 		prio =
 		  (swap_flags & SWAP_FLAG_PRIO_MASK) >> SWAP_FLAG_PRIO_SHIFT;
-		setup_swap_ratio(p, prio);
 	}
+	/* also resets the tier statistics of a reused swap_info */
+	setup_swap_ratio(p, prio);
 	enable_swap_info(p, prio, swap_map, cluster_info, frontswap_map);
 
 	pr_info("Adding %uk swap on %s.  Priority:%d extents:%d across:%lluk %s%s%s%s%s\n",
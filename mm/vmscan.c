@@ -1108,7 +1108,12 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		if (PageAnon(page) && !PageSwapCache(page)) {
 			if (!(sc->gfp_mask & __GFP_IO))
 				goto keep_locked;
-			if (!add_to_swap(page, page_list))
+			/*
+			 * Pages picked out of a particular process by
+			 * per-process reclaim are idle ones, not the LRU
+			 * tail, and can go to the slow swap tier.
+			 */
+			if (!add_to_swap(page, page_list, !!sc->target_vma))
 				goto activate_locked;
 			may_enter_fs = 1;
 
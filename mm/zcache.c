@@ -36,6 +36,9 @@
 #include <linux/spinlock.h>
 #include <linux/radix-tree.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
+#include <linux/seqlock.h>
+#include <linux/hash.h>
 #include <linux/types.h>
 #include <linux/zbud.h>
 
@@ -109,14 +112,28 @@ static atomic_t zcache_stored_zero_pages = ATOMIC_INIT(0);
  * search key. Each red-black tree node has a radix tree which use
  * page->index(ra_index) as the index. Each radix tree slot points to the zbud
  * address combining with some extra information(zcache_ra_handle).
+ *
+ * The red-black tree of a pool is split into ZCACHE_NR_SHARDS trees by a
+ * hash of the inode number, so that different files rarely share a lock.
+ * Trees are searched without taking rb_lock: rb_seq tells a lockless walk
+ * that may have been misled by a concurrent rotation to retry, and
+ * rbnodes are only freed after an RCU grace period.
  */
 #define MAX_ZCACHE_POOLS 32
+#define ZCACHE_SHARD_SHIFT	4
+#define ZCACHE_NR_SHARDS	(1 << ZCACHE_SHARD_SHIFT)
+
+struct zcache_shard {
+	struct rb_root rbtree;
+	spinlock_t rb_lock;		/* Serializes rbtree updates */
+	seqcount_t rb_seq;		/* Bumped around rbtree updates */
+} ____cacheline_aligned_in_smp;
+
 /*
  * One zcache_pool per (cleancache aware) filesystem mount instance
  */
 struct zcache_pool {
-	struct rb_root rbtree;
-	rwlock_t rb_lock;		/* Protects rbtree */
+	struct zcache_shard shards[ZCACHE_NR_SHARDS];
 	u64 size;
 	struct zbud_pool *pool;         /* Zbud pool used */
 };
@@ -133,7 +150,8 @@ struct _zcache zcache;
 
 /*
  * Redblack tree node, each node has a page index radix-tree.
- * Indexed by inode nubmer.
+ * Indexed by inode nubmer. Once removed from its tree, RB_EMPTY_NODE()
+ * is true and nothing may be added to ratree anymore.
  */
 struct zcache_rbnode {
 	struct rb_node rb_node;
@@ -141,6 +159,7 @@ struct zcache_rbnode {
 	struct radix_tree_root ratree; /* Page radix tree per inode rbtree */
 	spinlock_t ra_lock;		/* Protects radix tree */
 	struct kref refcount;
+	struct rcu_head rcu;
 };
 
 /*
@@ -407,8 +426,14 @@ static bool zcache_is_full(void)
 			file));
 }
 
+static inline struct zcache_shard *zcache_shard(struct zcache_pool *zpool,
+					int rb_index)
+{
+	return &zpool->shards[hash_32((u32)rb_index, ZCACHE_SHARD_SHIFT)];
+}
+
 /*
- * The caller must hold zpool->rb_lock at least
+ * The caller must hold shard->rb_lock
  */
 static struct zcache_rbnode *zcache_find_rbnode(struct rb_root *rbtree,
 	int index, struct rb_node **rb_parent, struct rb_node ***rb_link)
@@ -438,24 +463,63 @@ static struct zcache_rbnode *zcache_find_rbnode(struct rb_root *rbtree,
 	return NULL;
 }
 
-static struct zcache_rbnode *zcache_find_get_rbnode(struct zcache_pool *zpool,
+/*
+ * Lockless version of zcache_find_rbnode(), called under rcu_read_lock().
+ * May miss an entry while the tree is being rebalanced.
+ */
+static struct zcache_rbnode *zcache_find_rbnode_rcu(struct rb_root *rbtree,
+					int index)
+{
+	struct rb_node *node = rcu_dereference_raw(rbtree->rb_node);
+	struct zcache_rbnode *entry;
+
+	while (node) {
+		entry = rb_entry(node, struct zcache_rbnode, rb_node);
+		if (entry->rb_index > index)
+			node = rcu_dereference_raw(node->rb_left);
+		else if (entry->rb_index < index)
+			node = rcu_dereference_raw(node->rb_right);
+		else
+			return entry;
+	}
+	return NULL;
+}
+
+static struct zcache_rbnode *zcache_find_get_rbnode(struct zcache_shard *shard,
 					int rb_index)
 {
-	unsigned long flags;
 	struct zcache_rbnode *rbnode;
+	unsigned int seq;
+
+	rcu_read_lock();
+	do {
+		seq = read_seqcount_begin(&shard->rb_seq);
+		rbnode = zcache_find_rbnode_rcu(&shard->rbtree, rb_index);
+		if (rbnode) {
+			/* a zero count means it is already off the tree */
+			if (!kref_get_unless_zero(&rbnode->refcount))
+				rbnode = NULL;
+			break;
+		}
+	} while (read_seqcount_retry(&shard->rb_seq, seq));
+	rcu_read_unlock();
 
-	read_lock_irqsave(&zpool->rb_lock, flags);
-	rbnode = zcache_find_rbnode(&zpool->rbtree, rb_index, 0, 0);
-	if (rbnode)
-		kref_get(&rbnode->refcount);
-	read_unlock_irqrestore(&zpool->rb_lock, flags);
 	return rbnode;
 }
 
+static void zcache_rbnode_free_rcu(struct rcu_head *head)
+{
+	struct zcache_rbnode *rbnode;
+
+	rbnode = container_of(head, struct zcache_rbnode, rcu);
+	kmem_cache_free(zcache_rbnode_cache, rbnode);
+}
+
 /*
  * kref_put callback for zcache_rbnode.
  *
- * The rbnode must have been isolated from rbtree already.
+ * The rbnode must have been isolated from rbtree already. Lockless
+ * lookups may still be looking at it, so defer the free.
  */
 static void zcache_rbnode_release(struct kref *kref)
 {
@@ -463,13 +527,13 @@ static void zcache_rbnode_release(struct kref *kref)
 
 	rbnode = container_of(kref, struct zcache_rbnode, refcount);
 	BUG_ON(rbnode->ratree.rnode);
-	kmem_cache_free(zcache_rbnode_cache, rbnode);
+	call_rcu(&rbnode->rcu, zcache_rbnode_free_rcu);
 }
 
 /*
  * Check whether the radix-tree of this rbnode is empty.
  * If that's true, then we can delete this zcache_rbnode from
- * zcache_pool->rbtree
+ * its shard
  *
  * Caller must hold zcache_rbnode->ra_lock
  */
@@ -479,32 +543,25 @@ static int zcache_rbnode_empty(struct zcache_rbnode *rbnode)
 }
 
 /*
- * Remove zcache_rbnode from zpool->rbtree
+ * Remove an rbnode whose radix tree has become empty from its shard and
+ * drop the tree's reference. The caller holds shard->rb_lock, the
+ * rbnode's ra_lock and a reference of its own.
  *
- * holded_rblock - whether the caller has holded zpool->rb_lock
+ * Others may still hold references; zcache_store_zaddr() checks for
+ * RB_EMPTY_NODE() under ra_lock so a racing put does not add a page to an
+ * isolated node and thereby lose that memory.
  */
-static void zcache_rbnode_isolate(struct zcache_pool *zpool,
-		struct zcache_rbnode *rbnode, bool holded_rblock)
+static void zcache_rbnode_isolate(struct zcache_shard *shard,
+		struct zcache_rbnode *rbnode)
 {
-	unsigned long flags;
+	if (!zcache_rbnode_empty(rbnode) || RB_EMPTY_NODE(&rbnode->rb_node))
+		return;
 
-	if (!holded_rblock)
-		write_lock_irqsave(&zpool->rb_lock, flags);
-	/*
-	 * Someone can get reference on this rbnode before we could
-	 * acquire write lock above.
-	 * We want to remove it from zpool->rbtree when only the caller and
-	 * corresponding ratree holds a reference to this rbnode.
-	 * Below check ensures that a racing zcache put will not end up adding
-	 * a page to an isolated node and thereby losing that memory.
-	 */
-	if (atomic_read(&rbnode->refcount.refcount) == 2) {
-		rb_erase(&rbnode->rb_node, &zpool->rbtree);
-		RB_CLEAR_NODE(&rbnode->rb_node);
-		kref_put(&rbnode->refcount, zcache_rbnode_release);
-	}
-	if (!holded_rblock)
-		write_unlock_irqrestore(&zpool->rb_lock, flags);
+	write_seqcount_begin(&shard->rb_seq);
+	rb_erase(&rbnode->rb_node, &shard->rbtree);
+	write_seqcount_end(&shard->rb_seq);
+	RB_CLEAR_NODE(&rbnode->rb_node);
+	kref_put(&rbnode->refcount, zcache_rbnode_release);
 }
 
 /*
@@ -513,13 +570,15 @@ static void zcache_rbnode_isolate(struct zcache_pool *zpool,
 static int zcache_store_zaddr(struct zcache_pool *zpool,
 		int ra_index, int rb_index, unsigned long zaddr)
 {
+	struct zcache_shard *shard = zcache_shard(zpool, rb_index);
 	unsigned long flags;
 	struct zcache_rbnode *rbnode, *tmp;
 	struct rb_node **link = NULL, *parent = NULL;
 	int ret;
 	void *dup_zaddr;
 
-	rbnode = zcache_find_get_rbnode(zpool, rb_index);
+retry:
+	rbnode = zcache_find_get_rbnode(shard, rb_index);
 	if (!rbnode) {
 		/* alloc and init a new rbnode */
 		rbnode = kmem_cache_alloc(zcache_rbnode_cache,
@@ -534,25 +593,34 @@ static int zcache_store_zaddr(struct zcache_pool *zpool,
 		RB_CLEAR_NODE(&rbnode->rb_node);
 
 		/* add that rbnode to rbtree */
-		write_lock_irqsave(&zpool->rb_lock, flags);
-		tmp = zcache_find_rbnode(&zpool->rbtree, rb_index,
+		spin_lock_irqsave(&shard->rb_lock, flags);
+		tmp = zcache_find_rbnode(&shard->rbtree, rb_index,
 				&parent, &link);
 		if (tmp) {
 			/* somebody else allocated new rbnode */
 			kmem_cache_free(zcache_rbnode_cache, rbnode);
 			rbnode = tmp;
 		} else {
-			rb_link_node(&rbnode->rb_node, parent, link);
-			rb_insert_color(&rbnode->rb_node, &zpool->rbtree);
+			write_seqcount_begin(&shard->rb_seq);
+			rb_link_node_rcu(&rbnode->rb_node, parent, link);
+			rb_insert_color(&rbnode->rb_node, &shard->rbtree);
+			write_seqcount_end(&shard->rb_seq);
 		}
 
 		/* Inc the reference of this zcache_rbnode */
 		kref_get(&rbnode->refcount);
-		write_unlock_irqrestore(&zpool->rb_lock, flags);
+		spin_unlock_irqrestore(&shard->rb_lock, flags);
 	}
 
 	/* Succfully got a zcache_rbnode when arriving here */
 	spin_lock_irqsave(&rbnode->ra_lock, flags);
+	if (unlikely(RB_EMPTY_NODE(&rbnode->rb_node))) {
+		/* emptied and isolated since we looked it up */
+		spin_unlock_irqrestore(&rbnode->ra_lock, flags);
+		kref_put(&rbnode->refcount, zcache_rbnode_release);
+		goto retry;
+	}
+
 	dup_zaddr = radix_tree_delete(&rbnode->ratree, ra_index);
 	if (unlikely(dup_zaddr)) {
 		WARN_ON("duplicated, will be replaced!\n");
@@ -571,14 +639,11 @@ static int zcache_store_zaddr(struct zcache_pool *zpool,
 				(void *)zaddr);
 	spin_unlock_irqrestore(&rbnode->ra_lock, flags);
 	if (unlikely(ret)) {
-		write_lock_irqsave(&zpool->rb_lock, flags);
+		spin_lock_irqsave(&shard->rb_lock, flags);
 		spin_lock(&rbnode->ra_lock);
-
-		if (zcache_rbnode_empty(rbnode))
-			zcache_rbnode_isolate(zpool, rbnode, 1);
-
+		zcache_rbnode_isolate(shard, rbnode);
 		spin_unlock(&rbnode->ra_lock);
-		write_unlock_irqrestore(&zpool->rb_lock, flags);
+		spin_unlock_irqrestore(&shard->rb_lock, flags);
 	}
 
 	kref_put(&rbnode->refcount, zcache_rbnode_release);
@@ -588,16 +653,18 @@ static int zcache_store_zaddr(struct zcache_pool *zpool,
 /*
  * Load zaddr and delete it from radix tree.
  * If the radix tree of the corresponding rbnode is empty, delete the rbnode
- * from zpool->rbtree also.
+ * from its shard also. Only that case takes the shard lock.
  */
 static void *zcache_load_delete_zaddr(struct zcache_pool *zpool,
 				int rb_index, int ra_index)
 {
+	struct zcache_shard *shard = zcache_shard(zpool, rb_index);
 	struct zcache_rbnode *rbnode;
 	void *zaddr = NULL;
 	unsigned long flags;
+	bool empty;
 
-	rbnode = zcache_find_get_rbnode(zpool, rb_index);
+	rbnode = zcache_find_get_rbnode(shard, rb_index);
 	if (!rbnode)
 		goto out;
 
@@ -605,15 +672,17 @@ static void *zcache_load_delete_zaddr(struct zcache_pool *zpool,
 
 	spin_lock_irqsave(&rbnode->ra_lock, flags);
 	zaddr = radix_tree_delete(&rbnode->ratree, ra_index);
+	empty = zcache_rbnode_empty(rbnode);
 	spin_unlock_irqrestore(&rbnode->ra_lock, flags);
 
-	/* rb_lock and ra_lock must be taken again in the given sequence */
-	write_lock_irqsave(&zpool->rb_lock, flags);
-	spin_lock(&rbnode->ra_lock);
-	if (zcache_rbnode_empty(rbnode))
-		zcache_rbnode_isolate(zpool, rbnode, 1);
-	spin_unlock(&rbnode->ra_lock);
-	write_unlock_irqrestore(&zpool->rb_lock, flags);
+	if (empty) {
+		/* rb_lock and ra_lock must be taken again in the given sequence */
+		spin_lock_irqsave(&shard->rb_lock, flags);
+		spin_lock(&rbnode->ra_lock);
+		zcache_rbnode_isolate(shard, rbnode);
+		spin_unlock(&rbnode->ra_lock);
+		spin_unlock_irqrestore(&shard->rb_lock, flags);
+	}
 
 	kref_put(&rbnode->refcount, zcache_rbnode_release);
 out:
@@ -848,15 +917,16 @@ static void zcache_flush_inode(int pool_id, struct cleancache_filekey key)
 	struct zcache_rbnode *rbnode;
 	unsigned long flags1, flags2;
 	struct zcache_pool *zpool = zcache.pools[pool_id];
+	struct zcache_shard *shard = zcache_shard(zpool, key.u.ino);
 
 	/*
 	 * Refuse new pages added in to the same rbinode, so get rb_lock at
 	 * first.
 	 */
-	write_lock_irqsave(&zpool->rb_lock, flags1);
-	rbnode = zcache_find_rbnode(&zpool->rbtree, key.u.ino, 0, 0);
+	spin_lock_irqsave(&shard->rb_lock, flags1);
+	rbnode = zcache_find_rbnode(&shard->rbtree, key.u.ino, 0, 0);
 	if (!rbnode) {
-		write_unlock_irqrestore(&zpool->rb_lock, flags1);
+		spin_unlock_irqrestore(&shard->rb_lock, flags1);
 		return;
 	}
 
@@ -864,12 +934,11 @@ static void zcache_flush_inode(int pool_id, struct cleancache_filekey key)
 	spin_lock_irqsave(&rbnode->ra_lock, flags2);
 
 	zcache_flush_ratree(zpool, rbnode);
-	if (zcache_rbnode_empty(rbnode))
-		/* When arrvied here, we already hold rb_lock */
-		zcache_rbnode_isolate(zpool, rbnode, 1);
+	/* When arrvied here, we already hold rb_lock */
+	zcache_rbnode_isolate(shard, rbnode);
 
 	spin_unlock_irqrestore(&rbnode->ra_lock, flags2);
-	write_unlock_irqrestore(&zpool->rb_lock, flags1);
+	spin_unlock_irqrestore(&shard->rb_lock, flags1);
 	kref_put(&rbnode->refcount, zcache_rbnode_release);
 }
 
@@ -877,9 +946,11 @@ static void zcache_destroy_pool(struct zcache_pool *zpool);
 static void zcache_flush_fs(int pool_id)
 {
 	struct zcache_rbnode *z_rbnode = NULL;
+	struct zcache_shard *shard;
 	struct rb_node *rbnode;
 	unsigned long flags1, flags2;
 	struct zcache_pool *zpool;
+	int i;
 
 	if (pool_id < 0)
 		return;
@@ -888,27 +959,29 @@ static void zcache_flush_fs(int pool_id)
 	if (!zpool)
 		return;
 
-	/*
-	 * Refuse new pages added in, so get rb_lock at first.
-	 */
-	write_lock_irqsave(&zpool->rb_lock, flags1);
+	for (i = 0; i < ZCACHE_NR_SHARDS; i++) {
+		shard = &zpool->shards[i];
+
+		/*
+		 * Refuse new pages added in, so get rb_lock at first.
+		 */
+		spin_lock_irqsave(&shard->rb_lock, flags1);
 
-	rbnode = rb_first(&zpool->rbtree);
-	while (rbnode) {
-		z_rbnode = rb_entry(rbnode, struct zcache_rbnode, rb_node);
-		rbnode = rb_next(rbnode);
-		if (z_rbnode) {
+		rbnode = rb_first(&shard->rbtree);
+		while (rbnode) {
+			z_rbnode = rb_entry(rbnode, struct zcache_rbnode,
+					rb_node);
+			rbnode = rb_next(rbnode);
 			kref_get(&z_rbnode->refcount);
 			spin_lock_irqsave(&z_rbnode->ra_lock, flags2);
 			zcache_flush_ratree(zpool, z_rbnode);
-			if (zcache_rbnode_empty(z_rbnode))
-				zcache_rbnode_isolate(zpool, z_rbnode, 1);
+			zcache_rbnode_isolate(shard, z_rbnode);
 			spin_unlock_irqrestore(&z_rbnode->ra_lock, flags2);
 			kref_put(&z_rbnode->refcount, zcache_rbnode_release);
 		}
-	}
 
-	write_unlock_irqrestore(&zpool->rb_lock, flags1);
+		spin_unlock_irqrestore(&shard->rb_lock, flags1);
+	}
 	zcache_destroy_pool(zpool);
 }
 
@@ -953,7 +1026,7 @@ static struct zbud_ops zcache_zbud_ops = {
 /* Return pool id */
 static int zcache_create_pool(void)
 {
-	int ret;
+	int ret, i;
 	struct zcache_pool *zpool;
 
 	zpool = kzalloc(sizeof(*zpool), GFP_KERNEL);
@@ -962,6 +1035,12 @@ static int zcache_create_pool(void)
 		goto out;
 	}
 
+	for (i = 0; i < ZCACHE_NR_SHARDS; i++) {
+		zpool->shards[i].rbtree = RB_ROOT;
+		spin_lock_init(&zpool->shards[i].rb_lock);
+		seqcount_init(&zpool->shards[i].rb_seq);
+	}
+
 	zpool->pool = zbud_create_pool(GFP_KERNEL, &zcache_zbud_ops);
 	if (!zpool->pool) {
 		kfree(zpool);
@@ -978,8 +1057,6 @@ static int zcache_create_pool(void)
 		goto out_unlock;
 	}
 
-	rwlock_init(&zpool->rb_lock);
-	zpool->rbtree = RB_ROOT;
 	/* Add to pool list */
 	for (ret = 0; ret < MAX_ZCACHE_POOLS; ret++)
 		if (!zcache.pools[ret])
@@ -1009,8 +1086,9 @@ static void zcache_destroy_pool(struct zcache_pool *zpool)
 	zcache.pools[i] = NULL;
 	spin_unlock(&zcache.pool_lock);
 
-	if (!RB_EMPTY_ROOT(&zpool->rbtree))
-		WARN_ON("Memory leak detected. Freeing non-empty pool!\n");
+	for (i = 0; i < ZCACHE_NR_SHARDS; i++)
+		if (!RB_EMPTY_ROOT(&zpool->shards[i].rbtree))
+			WARN_ON("Memory leak detected. Freeing non-empty pool!\n");
 
 	zbud_destroy_pool(zpool->pool);
 	kfree(zpool);
@@ -1057,6 +1135,10 @@ static struct cleancache_ops zcache_ops = {
  */
 #ifdef CONFIG_DEBUG_FS
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
 
 static int pool_pages_get(void *_data, u64 *val)
 {
@@ -1066,6 +1148,159 @@ static int pool_pages_get(void *_data, u64 *val)
 
 DEFINE_SIMPLE_ATTRIBUTE(pool_page_fops, pool_pages_get, NULL, "%llu\n");
 
+/*
+ * Microbenchmark: writing N to the "bench" file puts N pages into a
+ * private pool from a thread bound to every online CPU at once, then gets
+ * them back. Reading the file reports the per-CPU rates of the last run.
+ */
+struct zcache_bench {
+	struct completion done;
+	int pool_id;
+	int cpu;
+	unsigned long nr_pages;
+	unsigned long hits;
+	u64 put_ns;
+	u64 get_ns;
+};
+
+static DEFINE_MUTEX(zcache_bench_mutex);
+static struct zcache_bench *zcache_bench_results;
+
+static int zcache_bench_thread(void *data)
+{
+	struct zcache_bench *b = data;
+	struct cleancache_filekey key = { };
+	struct page *page;
+	unsigned long i;
+	u64 start;
+	u8 *mem;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		goto out;
+
+	/* compressible, but not a zero page */
+	mem = kmap(page);
+	for (i = 0; i < PAGE_SIZE / 2; i++)
+		mem[i] = (u8)(i * 7 + b->cpu);
+	memset(mem + PAGE_SIZE / 2, 0, PAGE_SIZE / 2);
+	kunmap(page);
+
+	/* 64 pages per inode, every CPU on its own inodes */
+	start = ktime_get_ns();
+	for (i = 0; i < b->nr_pages; i++) {
+		key.u.ino = ((unsigned long)b->cpu << 20) | (i >> 6);
+		SetPageWasActive(page);
+		zcache_store_page(b->pool_id, key, i & 63, page);
+	}
+	b->put_ns = ktime_get_ns() - start;
+
+	start = ktime_get_ns();
+	for (i = 0; i < b->nr_pages; i++) {
+		key.u.ino = ((unsigned long)b->cpu << 20) | (i >> 6);
+		if (!zcache_load_page(b->pool_id, key, i & 63, page))
+			b->hits++;
+	}
+	b->get_ns = ktime_get_ns() - start;
+
+	__free_page(page);
+out:
+	complete(&b->done);
+	return 0;
+}
+
+static ssize_t zcache_bench_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct zcache_bench *b;
+	struct task_struct *tsk;
+	unsigned long nr_pages;
+	int cpu, pool_id, ret;
+
+	ret = kstrtoul_from_user(buf, count, 0, &nr_pages);
+	if (ret)
+		return ret;
+	if (!nr_pages)
+		return -EINVAL;
+
+	mutex_lock(&zcache_bench_mutex);
+	pool_id = zcache_create_pool();
+	if (pool_id < 0) {
+		ret = pool_id;
+		goto out;
+	}
+
+	memset(zcache_bench_results, 0,
+		nr_cpu_ids * sizeof(*zcache_bench_results));
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		b = &zcache_bench_results[cpu];
+		init_completion(&b->done);
+		b->pool_id = pool_id;
+		b->cpu = cpu;
+		b->nr_pages = nr_pages;
+
+		tsk = kthread_create_on_node(zcache_bench_thread, b,
+				cpu_to_node(cpu), "zcache_bench/%d", cpu);
+		if (IS_ERR(tsk)) {
+			b->nr_pages = 0;
+			complete(&b->done);
+			continue;
+		}
+		kthread_bind(tsk, cpu);
+		wake_up_process(tsk);
+	}
+	for_each_online_cpu(cpu)
+		wait_for_completion(&zcache_bench_results[cpu].done);
+	put_online_cpus();
+
+	zcache_flush_fs(pool_id);
+	ret = count;
+out:
+	mutex_unlock(&zcache_bench_mutex);
+	return ret;
+}
+
+static int zcache_bench_show(struct seq_file *s, void *unused)
+{
+	struct zcache_bench *b;
+	int cpu;
+
+	seq_printf(s, "%-4s %10s %12s %12s %10s\n",
+		"cpu", "pages", "put/s", "get/s", "hits");
+
+	mutex_lock(&zcache_bench_mutex);
+	for_each_possible_cpu(cpu) {
+		b = &zcache_bench_results[cpu];
+		if (!b->nr_pages)
+			continue;
+		seq_printf(s, "%-4d %10lu %12llu %12llu %10lu\n", cpu,
+			b->nr_pages,
+			div64_u64((u64)b->nr_pages * NSEC_PER_SEC,
+				max_t(u64, b->put_ns, 1)),
+			div64_u64((u64)b->nr_pages * NSEC_PER_SEC,
+				max_t(u64, b->get_ns, 1)),
+			b->hits);
+	}
+	mutex_unlock(&zcache_bench_mutex);
+
+	return 0;
+}
+
+static int zcache_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zcache_bench_show, NULL);
+}
+
+static const struct file_operations zcache_bench_fops = {
+	.open		= zcache_bench_open,
+	.read		= seq_read,
+	.write		= zcache_bench_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct dentry *zcache_debugfs_root;
 
 static int __init zcache_debugfs_init(void)
@@ -1105,6 +1340,12 @@ static int __init zcache_debugfs_init(void)
 			zcache_debugfs_root, &zcache_pool_shrink_pages);
 	debugfs_create_u64("store_fail", S_IRUGO,
 			zcache_debugfs_root, &zcache_store_failed);
+
+	zcache_bench_results = kcalloc(nr_cpu_ids,
+				sizeof(*zcache_bench_results), GFP_KERNEL);
+	if (zcache_bench_results)
+		debugfs_create_file("bench", S_IRUSR | S_IWUSR,
+				zcache_debugfs_root, NULL, &zcache_bench_fops);
 	return 0;
 }
 
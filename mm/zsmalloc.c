@@ -50,6 +50,7 @@
 #include <linux/mount.h>
 #include <linux/migrate.h>
 #include <linux/pagemap.h>
+#include <linux/workqueue.h>
 
 #define ZSPAGE_MAGIC	0x58
 
@@ -190,6 +191,29 @@ static int zs_size_classes;
 static const int fullness_threshold_frac = 4;
 static size_t huge_class_size;
 
+/*
+ * Background compaction: every compact_interval_ms each pool looks for
+ * classes where at least compact_frag_percent of the pages in use could
+ * be freed by compaction, and compacts them for at most
+ * compact_budget_us of CPU time per pass. An interval of 0 pauses it;
+ * the work then stays idle until the interval is set again.
+ */
+static unsigned int compact_interval_ms = 10000;
+
+static unsigned int compact_frag_percent = 25;
+module_param(compact_frag_percent, uint, 0644);
+MODULE_PARM_DESC(compact_frag_percent,
+	"Freeable/used page ratio that makes a class a compaction target");
+
+static unsigned int compact_budget_us = 2000;
+module_param(compact_budget_us, uint, 0644);
+MODULE_PARM_DESC(compact_budget_us,
+	"CPU time budget of one background compaction pass in us");
+
+/* Pools with background compaction, for kicking them on interval changes */
+static LIST_HEAD(zs_pool_list);
+static DEFINE_MUTEX(zs_pool_list_lock);
+
 struct size_class {
 	spinlock_t lock;
 	struct list_head fullness_list[NR_ZS_FULLNESS];
@@ -204,6 +228,8 @@ struct size_class {
 
 	unsigned int index;
 	struct zs_size_stat stats;
+	/* pages freed by compacting this class */
+	unsigned long pages_compacted;
 };
 
 /* huge object: pages_per_zspage == 1 && maxobj_per_zspage == 1 */
@@ -260,6 +286,12 @@ struct zs_pool {
 	 * and unregister_shrinker() will not Oops.
 	 */
 	bool shrinker_enabled;
+
+	/* Background compaction of fragmented classes */
+	struct list_head pool_list;
+	struct delayed_work compact_work;
+	unsigned long bg_compact_passes;
+	unsigned long bg_compact_pages;	/* pages freed */
 #ifdef CONFIG_ZSMALLOC_STAT
 	struct dentry *stat_dentry;
 #endif
@@ -677,6 +709,67 @@ static const struct file_operations zs_stat_size_ops = {
 	.release        = single_release,
 };
 
+static int zs_stats_compact_show(struct seq_file *s, void *v)
+{
+	int i;
+	struct zs_pool *pool = s->private;
+	struct size_class *class;
+	unsigned long obj_allocated, pages_used, freeable, compacted;
+	unsigned long total_pages = 0, total_freeable = 0;
+	unsigned long total_compacted = 0;
+
+	seq_printf(s, " %5s %5s %10s %8s %6s %15s\n",
+			"class", "size", "pages_used", "freeable",
+			"frag%", "pages_compacted");
+
+	for (i = 0; i < zs_size_classes; i++) {
+		class = pool->size_class[i];
+
+		if (class->index != i)
+			continue;
+
+		spin_lock(&class->lock);
+		obj_allocated = zs_stat_get(class, OBJ_ALLOCATED);
+		freeable = zs_can_compact(class);
+		compacted = class->pages_compacted;
+		spin_unlock(&class->lock);
+
+		pages_used = obj_allocated / class->objs_per_zspage *
+				class->pages_per_zspage;
+
+		seq_printf(s, " %5u %5u %10lu %8lu %6lu %15lu\n",
+			i, class->size, pages_used, freeable,
+			pages_used ? freeable * 100 / pages_used : 0,
+			compacted);
+
+		total_pages += pages_used;
+		total_freeable += freeable;
+		total_compacted += compacted;
+	}
+
+	seq_puts(s, "\n");
+	seq_printf(s, " %5s %5s %10lu %8lu %6lu %15lu\n",
+			"Total", "", total_pages, total_freeable,
+			total_pages ? total_freeable * 100 / total_pages : 0,
+			total_compacted);
+	seq_printf(s, "\n background passes: %lu, compacted: %lu pages\n",
+			pool->bg_compact_passes, pool->bg_compact_pages);
+
+	return 0;
+}
+
+static int zs_stats_compact_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zs_stats_compact_show, inode->i_private);
+}
+
+static const struct file_operations zs_stat_compact_ops = {
+	.open           = zs_stats_compact_open,
+	.read           = seq_read,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
 static int zs_pool_stat_create(struct zs_pool *pool, const char *name)
 {
 	struct dentry *entry;
@@ -699,6 +792,14 @@ static int zs_pool_stat_create(struct zs_pool *pool, const char *name)
 		return -ENOMEM;
 	}
 
+	entry = debugfs_create_file("compaction", S_IFREG | S_IRUGO,
+			pool->stat_dentry, pool, &zs_stat_compact_ops);
+	if (!entry) {
+		pr_warn("%s: debugfs file entry <%s> creation failed\n",
+				name, "compaction");
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
@@ -2284,13 +2385,25 @@ static unsigned long zs_can_compact(struct size_class *class)
 	return obj_wasted * class->pages_per_zspage;
 }
 
-static void __zs_compact(struct zs_pool *pool, struct size_class *class)
+/*
+ * Compact @class. If @budget is non-NULL, it holds the CPU time in ns
+ * this compaction may still use. Only the time spent under class->lock
+ * is charged: preemption is off there, so it is all CPU time of this
+ * task, while the cond_resched() gaps in between are not. Compaction
+ * stops between source zspages once the budget runs out. Returns the
+ * number of pages freed.
+ */
+static unsigned long __zs_compact(struct zs_pool *pool,
+				struct size_class *class, u64 *budget)
 {
 	struct zs_compact_control cc;
 	struct zspage *src_zspage;
 	struct zspage *dst_zspage = NULL;
+	unsigned long pages_freed = 0;
+	u64 start, now, spent = 0;
 
 	spin_lock(&class->lock);
+	start = local_clock();
 	while ((src_zspage = isolate_zspage(class, true))) {
 
 		if (!zs_can_compact(class))
@@ -2319,16 +2432,32 @@ static void __zs_compact(struct zs_pool *pool, struct size_class *class)
 		if (putback_zspage(class, src_zspage) == ZS_EMPTY) {
 			free_zspage(pool, class, src_zspage);
 			pool->stats.pages_compacted += class->pages_per_zspage;
+			class->pages_compacted += class->pages_per_zspage;
+			pages_freed += class->pages_per_zspage;
+		}
+
+		now = local_clock();
+		spent += now - start;
+		start = now;
+		if (budget && spent >= *budget) {
+			src_zspage = NULL;
+			break;
 		}
 		spin_unlock(&class->lock);
 		cond_resched();
 		spin_lock(&class->lock);
+		start = local_clock();
 	}
 
 	if (src_zspage)
 		putback_zspage(class, src_zspage);
 
+	spent += local_clock() - start;
 	spin_unlock(&class->lock);
+
+	if (budget)
+		*budget -= min(spent, *budget);
+	return pages_freed;
 }
 
 unsigned long zs_compact(struct zs_pool *pool)
@@ -2342,13 +2471,97 @@ unsigned long zs_compact(struct zs_pool *pool)
 			continue;
 		if (class->index != i)
 			continue;
-		__zs_compact(pool, class);
+		__zs_compact(pool, class, NULL);
 	}
 
 	return pool->stats.pages_compacted;
 }
 EXPORT_SYMBOL_GPL(zs_compact);
 
+static bool zs_class_fragmented(struct size_class *class)
+{
+	unsigned long obj_allocated, pages_used, freeable;
+
+	spin_lock(&class->lock);
+	obj_allocated = zs_stat_get(class, OBJ_ALLOCATED);
+	freeable = zs_can_compact(class);
+	spin_unlock(&class->lock);
+
+	pages_used = obj_allocated / class->objs_per_zspage *
+			class->pages_per_zspage;
+	if (!freeable || !pages_used)
+		return false;
+
+	return freeable * 100 >= pages_used * compact_frag_percent;
+}
+
+/*
+ * Incrementally compact the classes whose fragmentation crossed the
+ * threshold, largest classes first like zs_compact(), until the CPU
+ * budget of this pass is used up. While paused the work is not rearmed;
+ * compact_interval_ms_set() kicks it again.
+ */
+static void zs_compact_work(struct work_struct *work)
+{
+	struct zs_pool *pool = container_of(to_delayed_work(work),
+					struct zs_pool, compact_work);
+	struct size_class *class;
+	u64 budget;
+	unsigned int interval;
+	int i;
+
+	if (!READ_ONCE(compact_interval_ms))
+		return;
+
+	budget = (u64)READ_ONCE(compact_budget_us) * NSEC_PER_USEC;
+
+	for (i = zs_size_classes - 1; i >= 0 && budget; i--) {
+		class = pool->size_class[i];
+		if (!class)
+			continue;
+		if (class->index != i)
+			continue;
+		if (!zs_class_fragmented(class))
+			continue;
+
+		pool->bg_compact_pages += __zs_compact(pool, class, &budget);
+	}
+
+	pool->bg_compact_passes++;
+
+	interval = READ_ONCE(compact_interval_ms);
+	if (interval)
+		schedule_delayed_work(&pool->compact_work,
+				msecs_to_jiffies(interval));
+}
+
+static int compact_interval_ms_set(const char *val,
+				const struct kernel_param *kp)
+{
+	struct zs_pool *pool;
+	int ret;
+
+	mutex_lock(&zs_pool_list_lock);
+	ret = param_set_uint(val, kp);
+	if (!ret && compact_interval_ms) {
+		list_for_each_entry(pool, &zs_pool_list, pool_list)
+			mod_delayed_work(system_wq, &pool->compact_work,
+				msecs_to_jiffies(compact_interval_ms));
+	}
+	mutex_unlock(&zs_pool_list_lock);
+
+	return ret;
+}
+
+static const struct kernel_param_ops compact_interval_ms_ops = {
+	.set = compact_interval_ms_set,
+	.get = param_get_uint,
+};
+module_param_cb(compact_interval_ms, &compact_interval_ms_ops,
+		&compact_interval_ms, 0644);
+MODULE_PARM_DESC(compact_interval_ms,
+	"Background compaction period in ms (0 = paused)");
+
 void zs_pool_stats(struct zs_pool *pool, struct zs_pool_stats *stats)
 {
 	memcpy(stats, &pool->stats, sizeof(struct zs_pool_stats));
@@ -2434,6 +2647,7 @@ struct zs_pool *zs_create_pool(const char *name)
 		return NULL;
 
 	init_deferred_free(pool);
+	INIT_DEFERRABLE_WORK(&pool->compact_work, zs_compact_work);
 	pool->size_class = kcalloc(zs_size_classes, sizeof(struct size_class *),
 			GFP_KERNEL);
 	if (!pool->size_class) {
@@ -2532,6 +2746,13 @@ struct zs_pool *zs_create_pool(const char *name)
 	 */
 	if (zs_register_shrinker(pool) == 0)
 		pool->shrinker_enabled = true;
+
+	mutex_lock(&zs_pool_list_lock);
+	list_add(&pool->pool_list, &zs_pool_list);
+	if (compact_interval_ms)
+		schedule_delayed_work(&pool->compact_work,
+				msecs_to_jiffies(compact_interval_ms));
+	mutex_unlock(&zs_pool_list_lock);
 	return pool;
 
 err:
@@ -2544,6 +2765,10 @@ void zs_destroy_pool(struct zs_pool *pool)
 {
 	int i;
 
+	mutex_lock(&zs_pool_list_lock);
+	list_del(&pool->pool_list);
+	mutex_unlock(&zs_pool_list_lock);
+	cancel_delayed_work_sync(&pool->compact_work);
 	zs_unregister_shrinker(pool);
 	zs_unregister_migration(pool);
 	zs_pool_stat_destroy(pool);
@@ -0,0 +1,176 @@
+/*
+ * Check that entries and attributes which a FUSE filesystem marks as valid
+ * forever (FUSE_VALID_FOREVER) are really kept: looking up the same name
+ * again must neither repeat the LOOKUP nor send a GETATTR to the daemon.
+ *
+ * The test runs its own minimal daemon on /dev/fuse and needs root.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <linux/fuse.h>
+
+#define FILE_NAME	"file"
+#define FILE_NODEID	2
+#define NR_STATS	3
+
+static int fuse_fd;
+static int nr_lookups;
+static int nr_getattrs;
+
+static void fill_attr(struct fuse_attr *attr, uint64_t nodeid)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->ino = nodeid;
+	attr->nlink = 1;
+	attr->blksize = 4096;
+	if (nodeid == FUSE_ROOT_ID)
+		attr->mode = S_IFDIR | 0755;
+	else
+		attr->mode = S_IFREG | 0644;
+}
+
+static void reply(uint64_t unique, int error, const void *arg, size_t len)
+{
+	struct {
+		struct fuse_out_header hdr;
+		char arg[sizeof(struct fuse_init_out) +
+			 sizeof(struct fuse_entry_out)];
+	} out;
+
+	out.hdr.len = sizeof(out.hdr) + len;
+	out.hdr.error = error;
+	out.hdr.unique = unique;
+	memcpy(out.arg, arg, len);
+	if (write(fuse_fd, &out, out.hdr.len) < 0 && errno != ENOENT)
+		perror("write /dev/fuse");
+}
+
+static void *serve(void *unused)
+{
+	static char buf[FUSE_MIN_READ_BUFFER + 65536];
+
+	for (;;) {
+		struct fuse_in_header *in = (struct fuse_in_header *)buf;
+		void *arg = buf + sizeof(*in);
+		ssize_t n = read(fuse_fd, buf, sizeof(buf));
+
+		if (n < 0) {
+			if (errno == EINTR || errno == ENOENT)
+				continue;
+			break;
+		}
+
+		switch (in->opcode) {
+		case FUSE_INIT: {
+			struct fuse_init_out init = {
+				.major = FUSE_KERNEL_VERSION,
+				.minor = FUSE_KERNEL_MINOR_VERSION,
+				.max_write = 4096,
+			};
+
+			reply(in->unique, 0, &init, sizeof(init));
+			break;
+		}
+		case FUSE_LOOKUP: {
+			struct fuse_entry_out entry;
+
+			if (in->nodeid != FUSE_ROOT_ID ||
+			    strcmp(arg, FILE_NAME)) {
+				reply(in->unique, -ENOENT, NULL, 0);
+				break;
+			}
+			nr_lookups++;
+			memset(&entry, 0, sizeof(entry));
+			entry.nodeid = FILE_NODEID;
+			entry.entry_valid = FUSE_VALID_FOREVER;
+			entry.attr_valid = FUSE_VALID_FOREVER;
+			fill_attr(&entry.attr, FILE_NODEID);
+			reply(in->unique, 0, &entry, sizeof(entry));
+			break;
+		}
+		case FUSE_GETATTR: {
+			struct fuse_attr_out attr;
+
+			if (in->nodeid == FILE_NODEID)
+				nr_getattrs++;
+			memset(&attr, 0, sizeof(attr));
+			attr.attr_valid = FUSE_VALID_FOREVER;
+			fill_attr(&attr.attr, in->nodeid);
+			reply(in->unique, 0, &attr, sizeof(attr));
+			break;
+		}
+		case FUSE_FORGET:
+		case FUSE_BATCH_FORGET:
+			break;
+		default:
+			reply(in->unique, -ENOSYS, NULL, 0);
+			break;
+		}
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	char mnt[] = "/tmp/fuse_forever.XXXXXX";
+	char path[sizeof(mnt) + sizeof(FILE_NAME)];
+	char opts[128];
+	pthread_t thread;
+	struct stat st;
+	int i, ret = 0;
+
+	if (getuid()) {
+		printf("fuse_forever_test: must be run as root [SKIP]\n");
+		return 0;
+	}
+
+	fuse_fd = open("/dev/fuse", O_RDWR);
+	if (fuse_fd < 0) {
+		printf("fuse_forever_test: no /dev/fuse [SKIP]\n");
+		return 0;
+	}
+
+	if (!mkdtemp(mnt)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	snprintf(opts, sizeof(opts),
+		 "fd=%d,rootmode=40000,user_id=0,group_id=0", fuse_fd);
+	if (mount("fuse_forever", mnt, "fuse", MS_NOSUID | MS_NODEV, opts)) {
+		perror("mount");
+		rmdir(mnt);
+		return 1;
+	}
+	pthread_create(&thread, NULL, serve, NULL);
+
+	snprintf(path, sizeof(path), "%s/%s", mnt, FILE_NAME);
+	for (i = 0; i < NR_STATS; i++) {
+		if (stat(path, &st)) {
+			perror("stat");
+			ret = 1;
+			break;
+		}
+		usleep(100 * 1000);
+	}
+
+	if (!ret && (nr_lookups != 1 || nr_getattrs != 0)) {
+		printf("fuse_forever_test: %d lookups, %d getattrs for %d stats, expected 1 and 0 [FAIL]\n",
+		       nr_lookups, nr_getattrs, NR_STATS);
+		ret = 1;
+	} else if (!ret) {
+		printf("fuse_forever_test: [PASS]\n");
+	}
+
+	umount2(mnt, MNT_DETACH);
+	close(fuse_fd);
+	rmdir(mnt);
+	return ret;
+}
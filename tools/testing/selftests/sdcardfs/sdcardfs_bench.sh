@@ -0,0 +1,118 @@
+#!/bin/bash
+#
+# Sequential read, write and mmap read throughput of a file accessed
+# through sdcardfs compared with the same file on the lower filesystem,
+# along with how much page cache each pass instantiates.
+#
+# Usage: sdcardfs_bench.sh [<sdcardfs_dir> <lower_dir> [size_mb]]
+#
+# <sdcardfs_dir> must be the sdcardfs view of <lower_dir>. Without
+# arguments the first sdcardfs mount in /proc/mounts and its source are
+# used. Since sdcardfs maps the lower page cache, both columns should
+# match and the sdcardfs read should not cache the file twice.
+
+UPPER=$1
+LOWER=$2
+SIZE_MB=${3:-256}
+NAME=sdcardfs_bench.$$
+
+ksft_skip=4
+
+if [ "$(id -u)" != 0 ]; then
+	echo "sdcardfs_bench: must be run as root"
+	exit $ksft_skip
+fi
+
+if [ -z "$UPPER" ]; then
+	set -- $(awk '$3 == "sdcardfs" { print $2, $1; exit }' /proc/mounts)
+	UPPER=$1
+	LOWER=$2
+fi
+
+if [ -z "$UPPER" ] || [ ! -d "$LOWER" ]; then
+	echo "sdcardfs_bench: no sdcardfs mount to test"
+	exit $ksft_skip
+fi
+
+cleanup()
+{
+	rm -f $LOWER/$NAME
+}
+trap cleanup EXIT
+
+drop_caches()
+{
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+}
+
+cached_kb()
+{
+	awk '/^Cached:/ { print $2 }' /proc/meminfo
+}
+
+# Run a command and print "<MB/s> <page cache growth in MB>".
+measure()
+{
+	local start end before after
+
+	drop_caches
+	before=$(cached_kb)
+	start=$(date +%s%N)
+	"$@" > /dev/null 2>&1
+	end=$(date +%s%N)
+	after=$(cached_kb)
+	echo $((SIZE_MB * 1000000000 / ((end - start) ? (end - start) : 1))) \
+		$(((after - before) / 1024))
+}
+
+PYTHON=$(command -v python3 || command -v python)
+
+# Touch every page of a file through a shared mapping.
+mmap_read()
+{
+	$PYTHON - "$1" <<'PY'
+import mmap, sys
+with open(sys.argv[1], "rb") as f:
+    m = mmap.mmap(f.fileno(), 0, prot=mmap.PROT_READ)
+    for off in range(0, len(m), mmap.PAGESIZE):
+        m[off]
+    m.close()
+PY
+}
+
+printf "%-8s %12s %10s %12s %10s\n" "pass" "lower MB/s" "cache MB" \
+	"sdcardfs MB/s" "cache MB"
+
+report()
+{
+	local pass=$1 lower upper
+
+	shift
+	lower=$("$@" $LOWER/$NAME)
+	upper=$("$@" $UPPER/$NAME)
+	printf "%-8s %12d %10d %12d %10d\n" $pass $lower $upper
+}
+
+write_file()
+{
+	measure dd if=/dev/zero of=$1 bs=1M count=$SIZE_MB conv=fsync
+}
+
+read_file()
+{
+	measure dd if=$1 of=/dev/null bs=1M
+}
+
+map_file()
+{
+	measure mmap_read $1
+}
+
+report write write_file
+report read read_file
+if [ -n "$PYTHON" ]; then
+	report mmap map_file
+fi
+
+exit 0
@@ -0,0 +1,88 @@
+#!/bin/bash
+#
+# Write/read throughput of a zram device for every compression
+# algorithm the kernel offers, reported in pages per second.
+#
+# Usage: zram_bench.sh [size_mb] [block_size]
+#
+# Large block sizes produce multi-page O_DIRECT bios, which exercise the
+# parallel write path (see the zram parallel_write_pages parameter).
+# Swap-out goes through rw_page one page at a time and is not covered.
+
+SIZE_MB=${1:-256}
+BS=${2:-1M}
+DEV_ID=""
+DATA=""
+
+ksft_skip=4
+
+cleanup()
+{
+	if [ -n "$DEV_ID" ]; then
+		echo 1 > /sys/block/zram$DEV_ID/reset 2>/dev/null
+		echo $DEV_ID > /sys/class/zram-control/hot_remove 2>/dev/null
+	fi
+	[ -n "$DATA" ] && rm -f $DATA
+}
+trap cleanup EXIT
+
+if [ "$(id -u)" != 0 ]; then
+	echo "zram_bench: must be run as root"
+	exit $ksft_skip
+fi
+
+if [ ! -d /sys/class/zram-control ]; then
+	modprobe zram num_devices=0 2>/dev/null
+	if [ ! -d /sys/class/zram-control ]; then
+		echo "zram_bench: zram is not available"
+		exit $ksft_skip
+	fi
+fi
+
+DEV_ID=$(cat /sys/class/zram-control/hot_add)
+SYS=/sys/block/zram$DEV_ID
+DEV=/dev/zram$DEV_ID
+PAGES=$((SIZE_MB * 1024 * 1024 / $(getconf PAGESIZE)))
+
+# Fill a file once so every algorithm compresses the same data. Half
+# random and half zeroes approximates swapped out anonymous memory.
+DATA=$(mktemp)
+dd if=/dev/urandom of=$DATA bs=1M count=$((SIZE_MB / 2)) 2>/dev/null
+dd if=/dev/zero bs=1M count=$((SIZE_MB - SIZE_MB / 2)) 2>/dev/null >> $DATA
+
+# Time a dd command in nanoseconds.
+time_dd()
+{
+	local start end
+
+	start=$(date +%s%N)
+	dd "$@" 2>/dev/null
+	end=$(date +%s%N)
+	echo $((end - start))
+}
+
+printf "%-8s %14s %14s %12s\n" "algo" "write pages/s" "read pages/s" "ratio"
+
+for algo in $(sed -e 's/[][]//g' $SYS/comp_algorithm); do
+	echo 1 > $SYS/reset
+	echo $algo > $SYS/comp_algorithm || continue
+	echo $((SIZE_MB * 2))M > $SYS/disksize || continue
+
+	# drop the data file from being a bottleneck
+	cat $DATA > /dev/null
+
+	wr_ns=$(time_dd if=$DATA of=$DEV bs=$BS oflag=direct)
+	rd_ns=$(time_dd if=$DEV of=/dev/null bs=$BS \
+			count=$((SIZE_MB * 1024 * 1024)) iflag=direct,count_bytes)
+
+	set -- $(cat $SYS/mm_stat)
+	orig=$1
+	compr=$2
+
+	printf "%-8s %14d %14d %12s\n" $algo \
+		$((PAGES * 1000000000 / (wr_ns ? wr_ns : 1))) \
+		$((PAGES * 1000000000 / (rd_ns ? rd_ns : 1))) \
+		$(awk "BEGIN { printf \"%.2f\", $orig / ($compr ? $compr : 1) }")
+done
+
+exit 0